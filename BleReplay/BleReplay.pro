@@ -0,0 +1,72 @@
+# BLE replay, feeds a --ble-capture file through ServoController on the
+# virtual GPIO backend. Needs Qt for ServoController; no adapter is used.
+QT += core bluetooth
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = BleReplay
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../blecapture.cpp \
+    ../clock.cpp \
+    ../dshot.cpp \
+    ../dshottelemetry.cpp \
+    ../esccontrol.cpp \
+    ../esccontrolthread.cpp \
+    ../escprotocol.cpp \
+    ../flightrecorder.cpp \
+    ../gattserver.cpp \
+    ../gpiohal.cpp \
+    ../hardwarepwm.cpp \
+    ../logger.cpp \
+    ../message.cpp \
+    ../pwmscheduler.cpp \
+    ../servocontroller.cpp \
+    ../sleepestimator.cpp \
+    ../timinghistogram.cpp \
+    ../trajectorybuffer.cpp \
+    ../virtualclock.cpp \
+    ../virtualgpio.cpp
+
+HEADERS += \
+    ../blecapture.h \
+    ../clock.h \
+    ../esccontrolthread.h \
+    ../gattserver.h \
+    ../gpiohal.h \
+    ../logger.h \
+    ../message.h \
+    ../servocontroller.h \
+    ../virtualclock.h \
+    ../virtualgpio.h
+
+LIBS += -lpthread
+
+# `make check` replays the checked-in capture (connect, arm, a 2s sweep of
+# all four ESCs, disarm) and fails when the output trace changes. Update the
+# expected values only for an intended change of the output timing.
+check.commands = ./$$TARGET $$PWD/testdata/arm-sweep-disarm.ble \
+    --expect-hash=6f2d4657b09c156c --expect-pulses=127,127,127,127
+check.depends = $$TARGET
+QMAKE_EXTRA_TARGETS += check
+
+exists(/usr/include/wiringPi.h)|exists(/usr/local/include/wiringPi.h) {
+    DEFINES += HAVE_WIRINGPI
+    SOURCES += ../wiringpigpio.cpp
+    HEADERS += ../wiringpigpio.h
+    LIBS += -lwiringPi
+}
+
+system(pkg-config --atleast-version=2.0 libgpiod) {
+    DEFINES += HAVE_LIBGPIOD
+    SOURCES += ../gpiodgpio.cpp
+    HEADERS += ../gpiodgpio.h
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libgpiod
+}
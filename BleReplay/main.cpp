@@ -0,0 +1,269 @@
+// BLE replay: feeds a --ble-capture file into ServoController::onBleDataReceived
+// without a Bluetooth adapter, with the virtual GPIO backend recording the
+// outputs. Exercises the whole receive -> parse -> command -> PWM pipeline.
+//
+//   BleReplay <capture> [--speed=fast|realtime] [--protocol=<name>] [--dshot-3d] [--slew=<us/s>]
+//             [--command-timeout=<ms>] [--failsafe=<jump|ramp>] [--trajectory-depth=<ms>]
+//             [--edges=<csv>] [--log-level=<level>]
+//             [--expect-hash=<hex>] [--expect-pulses=<esc1,esc2,esc3,esc4>]
+//
+// fast (default) runs on a VirtualClock: packets arrive at their captured
+// offsets in simulated time, so the run takes only the CPU time it needs and
+// the output trace is the same on every run. The trace hash in the result
+// is the quick regression check; --edges writes the trace itself
+// (time_ns since the first packet, pin, level). realtime replays on the
+// system clock at the captured pace. With --expect-* the exit code is 2
+// when the result differs, `make check` uses it on testdata/.
+
+#include "servocontroller.h"
+#include "blecapture.h"
+#include "virtualgpio.h"
+#include "virtualclock.h"
+#include "logger.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <time.h>
+
+struct ReplayStats {
+    uint64_t edges = 0;
+    uint64_t pulses[4] = {};
+    uint64_t traceHash = 14695981039346656037ULL;   // FNV-1a over (time, pin, level)
+};
+
+static const int REPLAY_PINS[4] = {
+    ESCControlThread::PIN_ESC_1, ESCControlThread::PIN_ESC_2,
+    ESCControlThread::PIN_ESC_3, ESCControlThread::PIN_ESC_4
+};
+
+// Time after the last packet that is still replayed, lets ramps and timeouts play out
+static constexpr int64_t REPLAY_TAIL_NS = 500000000LL;
+
+static void hashBytes(uint64_t* hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        *hash = (*hash ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+static void collectEdges(VirtualGpio* gpio, int64_t baseNs, ReplayStats* stats, std::ofstream* trace)
+{
+    for (const GpioEdge& edge : gpio->takeEdges()) {
+        const int64_t timeNs = edge.timeNs - baseNs;
+        const uint8_t level = edge.level ? 1 : 0;
+        hashBytes(&stats->traceHash, &timeNs, sizeof(timeNs));
+        hashBytes(&stats->traceHash, &edge.pin, sizeof(edge.pin));
+        hashBytes(&stats->traceHash, &level, sizeof(level));
+        ++stats->edges;
+        for (int i = 0; i < 4; ++i) {
+            if (edge.pin == REPLAY_PINS[i] && edge.level) {
+                ++stats->pulses[i];
+            }
+        }
+        if (trace && trace->is_open()) {
+            *trace << timeNs << ',' << edge.pin << ',' << int(level) << '\n';
+        }
+    }
+}
+
+static int64_t wallNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* capturePath = nullptr;
+    const char* edgesPath = nullptr;
+    bool realtime = false;
+
+    // Engine log goes to stderr, stdout carries only the result
+    Logger::getInstance()->setOutput(stderr);
+
+    ServoController controller;
+    controller.setBleEnabled(false);
+
+    int commandTimeoutMs = 0;
+    FailsafeMode failsafeMode = FailsafeMode::Jump;
+    const char* expectedHash = nullptr;
+    unsigned long long expectedPulses[4] = {};
+    bool expectPulses = false;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--speed=realtime") == 0) {
+            realtime = true;
+        } else if (strcmp(arg, "--speed=fast") == 0) {
+            realtime = false;
+        } else if (strncmp(arg, "--protocol=", 11) == 0) {
+            EscProtocol protocol;
+            if (!escProtocolFromName(arg + 11, &protocol)) {
+                std::cerr << "Unknown ESC protocol: " << arg + 11 << std::endl;
+                return 1;
+            }
+            controller.setEscProtocol(protocol);
+        } else if (strcmp(arg, "--dshot-3d") == 0) {
+            controller.setDShot3DMode(true);
+        } else if (strncmp(arg, "--slew=", 7) == 0) {
+            controller.setSlewRate(atoi(arg + 7));
+        } else if (strncmp(arg, "--command-timeout=", 18) == 0) {
+            commandTimeoutMs = atoi(arg + 18);
+        } else if (strncmp(arg, "--trajectory-depth=", 19) == 0) {
+            controller.setTrajectoryDepth(atoi(arg + 19));
+        } else if (strcmp(arg, "--failsafe=ramp") == 0) {
+            failsafeMode = FailsafeMode::Ramp;
+        } else if (strcmp(arg, "--failsafe=jump") == 0) {
+            failsafeMode = FailsafeMode::Jump;
+        } else if (strncmp(arg, "--edges=", 8) == 0) {
+            edgesPath = arg + 8;
+        } else if (strncmp(arg, "--expect-hash=", 14) == 0) {
+            expectedHash = arg + 14;
+        } else if (strncmp(arg, "--expect-pulses=", 16) == 0) {
+            if (sscanf(arg + 16, "%llu,%llu,%llu,%llu", &expectedPulses[0], &expectedPulses[1],
+                       &expectedPulses[2], &expectedPulses[3]) != 4) {
+                std::cerr << "--expect-pulses needs four comma separated counts: " << arg + 16 << std::endl;
+                return 1;
+            }
+            expectPulses = true;
+        } else if (strncmp(arg, "--log-level=", 12) == 0) {
+            LogLevel level;
+            if (!Logger::levelFromName(arg + 12, &level)) {
+                std::cerr << "Unknown log level: " << arg + 12 << std::endl;
+                return 1;
+            }
+            Logger::getInstance()->setLevel(level);
+        } else if (arg[0] != '-' && !capturePath) {
+            capturePath = arg;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (!capturePath) {
+        std::cerr << "Usage: " << argv[0] << " <capture> [--speed=fast|realtime] [--edges=<csv>] ..." << std::endl;
+        return 1;
+    }
+    controller.setCommandTimeout(commandTimeoutMs, failsafeMode);
+
+    std::vector<BleEvent> events;
+    if (!loadBleCapture(capturePath, &events)) {
+        return 1;
+    }
+
+    GpioHal::select(GpioBackendType::Virtual);
+    VirtualGpio* gpio = static_cast<VirtualGpio*>(GpioHal::getInstance());
+
+    VirtualClock virtualClock;
+    if (!realtime) {
+        Clock::setInstance(&virtualClock);
+    }
+    Clock* clock = Clock::getInstance();
+
+    ReplayStats stats;
+    std::ofstream trace;
+    if (edgesPath) {
+        trace.open(edgesPath);
+        trace << "time_ns,pin,level\n";
+    }
+
+    int64_t simulatedNs = 0;
+    int64_t replayWallNs = 0;
+    uint64_t droppedEdges = 0;
+    TrajectoryStats trajectory;
+    {
+        // The replay thread takes part in virtual time like the engine threads
+        ClockThread clockThread;
+
+        if (!controller.initialize()) {
+            std::cerr << "Failed to initialize the servo controller" << std::endl;
+            // The controller outlives virtualClock, its destructor must not
+            // find it installed
+            Clock::setInstance(nullptr);
+            return 1;
+        }
+        gpio->takeEdges();
+
+        const int64_t baseNs = clock->nowNs();
+        const int64_t wallStartNs = wallNowNs();
+        for (const BleEvent& event : events) {
+            clock->sleepUntilNs(baseNs + event.timeNs);
+            switch (event.type) {
+            case BleEventType::Data:
+                controller.onBleDataReceived(QByteArray(reinterpret_cast<const char*>(event.data.data()),
+                                                        int(event.data.size())));
+                break;
+            case BleEventType::Connected:
+                controller.onConnectionStateChanged(true);
+                break;
+            case BleEventType::Disconnected:
+                controller.onConnectionStateChanged(false);
+                break;
+            }
+            collectEdges(gpio, baseNs, &stats, &trace);
+        }
+
+        const int64_t endNs = baseNs + (events.empty() ? 0 : events.back().timeNs) + REPLAY_TAIL_NS;
+        clock->sleepUntilNs(endNs);
+        collectEdges(gpio, baseNs, &stats, &trace);
+
+        simulatedNs = clock->nowNs() - baseNs;
+        replayWallNs = wallNowNs() - wallStartNs;
+        droppedEdges = gpio->getDroppedEdgeCount();
+        trajectory = controller.getTrajectoryStats();
+    }
+
+    // Virtual time runs free from here, the engine is only shut down
+
+    controller.stop();
+    Clock::setInstance(nullptr);
+
+    uint64_t packets = 0;
+    for (const BleEvent& event : events) {
+        packets += event.type == BleEventType::Data;
+    }
+
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)stats.traceHash);
+
+    std::ostringstream json;
+    json << "{\"capture\":\"" << capturePath << "\""
+         << ",\"speed\":\"" << (realtime ? "realtime" : "fast") << "\""
+         << ",\"events\":" << events.size()
+         << ",\"packets\":" << packets
+         << ",\"replayed_s\":" << simulatedNs / 1e9
+         << ",\"wall_s\":" << replayWallNs / 1e9
+         << ",\"packets_per_wall_s\":" << (replayWallNs > 0 ? packets * 1e9 / replayWallNs : 0.0)
+         << ",\"edges\":" << stats.edges
+         << ",\"dropped_edges\":" << droppedEdges
+         << ",\"pulses\":[" << stats.pulses[0] << "," << stats.pulses[1] << ","
+         << stats.pulses[2] << "," << stats.pulses[3] << "]";
+    if (trajectory.batches > 0) {
+        json << ",\"trajectory\":{\"batches\":" << trajectory.batches
+             << ",\"points\":" << trajectory.points
+             << ",\"played\":" << trajectory.played
+             << ",\"late\":" << trajectory.late
+             << ",\"overruns\":" << trajectory.overruns
+             << ",\"underruns\":" << trajectory.underruns << "}";
+    }
+    json << ",\"trace_hash\":\"" << hash << "\"}";
+    std::cout << json.str() << std::endl;
+
+    int result = 0;
+    if (expectedHash && strcmp(expectedHash, hash) != 0) {
+        std::cerr << "Trace hash " << hash << ", expected " << expectedHash << std::endl;
+        result = 2;
+    }
+    for (int i = 0; expectPulses && i < 4; ++i) {
+        if (stats.pulses[i] != expectedPulses[i]) {
+            std::cerr << "ESC" << i + 1 << " pulses " << stats.pulses[i] << ", expected " << expectedPulses[i] << std::endl;
+            result = 2;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,24 @@
+# Command handoff benchmark, mutex + condition variable vs the seqlock slot.
+# No Qt or GPIO needed.
+QT -= core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = CommandBenchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../clock.cpp \
+    ../timinghistogram.cpp
+
+HEADERS += \
+    ../clock.h \
+    ../pulsewidth.h \
+    ../seqlock.h \
+    ../timinghistogram.h
+
+LIBS += -lpthread
@@ -0,0 +1,333 @@
+// Command handoff benchmark: the original ESCControlThread handoff (setter
+// takes a mutex and notifies a condition variable, the control thread copies
+// the command and sleeps 10ms between passes, the PWM loop picks the value
+// up at its next 20ms frame) against the SeqLock slot the PWM frame latches
+// directly. Prints one JSON object.
+//
+//   CommandBenchmark [--iterations=<n>] [--commands=<n>] [--packets=<n>] [--label=<text>]
+//
+// setter_ns is one setter call with the consumer side running, averaged over
+// --iterations calls. frame_latency_ns is the time from a setter call to the
+// start of the first 20ms frame that outputs the command, over --commands
+// commands sent at random points of the frame (default 100, ~3s per design).
+//
+// The contention pass has 1, 2, 4 and 8 producer threads publish --packets
+// servo packets each (default 200000): the old way as four per-ESC setter
+// calls, the new way as one submitCommand()-style batch with compare-and-skip,
+// once with changing and once with repeated commands. packet_ns is the wall
+// time per packet over all producers.
+
+#include "seqlock.h"
+#include "pulsewidth.h"
+#include "timinghistogram.h"
+#include "clock.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+static constexpr int64_t FRAME_PERIOD_NS = 20000000;   // 50Hz PWM
+static constexpr int64_t LEGACY_POLL_NS = 10000000;    // control thread sleep between passes
+
+// Same layout as ESCControlThread's command slot
+struct BenchCommand {
+    PulseWidth pulseWidth[4];
+    bool emergencyStop = false;
+    int64_t timestampNs = 0;
+};
+
+// The handoff before the seqlock: setCommand() under m_commandMutex plus a
+// condition variable, a control thread that copies the command to the ESC
+// outputs and sleeps 10ms after every pass
+class LegacyHandoff
+{
+public:
+    void set(const BenchCommand& command)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_current = command;
+        m_hasNewCommand = true;
+        m_condition.notify_one();
+    }
+
+    void controlLoop(const std::atomic<bool>* running)
+    {
+        while (running->load()) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait_for(lock, std::chrono::milliseconds(50),
+                                 [&] { return m_hasNewCommand || !running->load(); });
+            if (m_hasNewCommand) {
+                BenchCommand command = m_current;
+                m_hasNewCommand = false;
+                lock.unlock();
+                m_outputTimestampNs.store(command.timestampNs, std::memory_order_release);
+            } else {
+                lock.unlock();
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(LEGACY_POLL_NS));
+        }
+    }
+
+    // Old setESCnPulseWidth(): one setCommand() per ESC, the other channels
+    // read from the current command
+    void setChannel(int esc, PulseWidth pulseWidth, int64_t timestampNs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_current.pulseWidth[esc] = pulseWidth;
+        m_current.timestampNs = timestampNs;
+        m_hasNewCommand = true;
+        m_condition.notify_one();
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_condition.notify_one();
+    }
+
+    // What the PWM loop sees at a frame start
+    int64_t outputTimestampNs() const { return m_outputTimestampNs.load(std::memory_order_acquire); }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    BenchCommand m_current;
+    bool m_hasNewCommand = false;
+    std::atomic<int64_t> m_outputTimestampNs{0};
+};
+
+// The seqlock slot, read by the PWM frame itself
+class SeqLockHandoff
+{
+public:
+    void set(const BenchCommand& command) { m_command.store(command); }
+
+    // submitCommand(): skip a repeat with one read, publish anything else
+    bool submit(const BenchCommand& command)
+    {
+        BenchCommand current;
+        m_command.load(&current);
+        if (memcmp(current.pulseWidth, command.pulseWidth, sizeof(command.pulseWidth)) == 0 &&
+            current.emergencyStop == command.emergencyStop) {
+            return false;
+        }
+        m_command.store(command);
+        return true;
+    }
+
+    int64_t outputTimestampNs()
+    {
+        BenchCommand command;
+        if (m_command.tryLoad(&command)) {
+            m_lastTimestampNs = command.timestampNs;
+        }
+        return m_lastTimestampNs;
+    }
+
+private:
+    SeqLock<BenchCommand> m_command;
+    int64_t m_lastTimestampNs = 0;
+};
+
+struct HandoffResult {
+    double setterNs = 0;
+    TimingSummary frameLatency;
+};
+
+// Frame loop on absolute 20ms boundaries: a new timestamp at a frame start
+// is a command reaching the pins
+template <typename Handoff>
+static void frameLoop(Handoff* handoff, const std::atomic<bool>* running, TimingHistogram* latency)
+{
+    Clock* clock = Clock::getInstance();
+    int64_t frameNs = clock->nowNs();
+    int64_t seenNs = handoff->outputTimestampNs();
+    while (running->load()) {
+        frameNs += FRAME_PERIOD_NS;
+        clock->sleepUntilNs(frameNs);
+        const int64_t timestampNs = handoff->outputTimestampNs();
+        if (timestampNs != seenNs) {
+            latency->record(frameNs - timestampNs);
+            seenNs = timestampNs;
+        }
+    }
+}
+
+template <typename Handoff>
+static HandoffResult runHandoff(Handoff* handoff, std::atomic<bool>* running, uint64_t iterations, int commands)
+{
+    Clock* clock = Clock::getInstance();
+    HandoffResult result;
+    TimingHistogram latency(FRAME_PERIOD_NS / 128);
+    std::thread frames(frameLoop<Handoff>, handoff, running, &latency);
+
+    // Setter cost while the consumer side runs; the timestamp stays 0 so
+    // these calls are not counted as commands
+    BenchCommand command;
+    const int64_t startNs = clock->nowNs();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        command.pulseWidth[i & 3] = PulseWidth::fromUs(1000 + int(i % 1000));
+        handoff->set(command);
+    }
+    result.setterNs = double(clock->nowNs() - startNs) / iterations;
+
+    // Commands at random points of the frame, each one frame plus a bit apart
+    std::mt19937 random(1);
+    std::uniform_int_distribution<int64_t> phase(0, FRAME_PERIOD_NS);
+    int64_t nextNs = clock->nowNs() + FRAME_PERIOD_NS;
+    for (int i = 0; i < commands; ++i) {
+        nextNs += FRAME_PERIOD_NS + phase(random);
+        clock->sleepUntilNs(nextNs);
+        command.pulseWidth[0] = PulseWidth::fromUs(1000 + i % 1000);
+        command.timestampNs = clock->nowNs();
+        handoff->set(command);
+    }
+
+    // Let the last command reach a frame
+    clock->sleepForNs(3 * FRAME_PERIOD_NS);
+    running->store(false);
+    frames.join();
+    result.frameLatency = latency.summary();
+    return result;
+}
+
+// Producers publishing whole packets at full speed, returns ns per packet
+template <typename Publish>
+static double runProducers(int producers, uint64_t packets, Publish publish)
+{
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            ready.fetch_add(1);
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (uint64_t i = 0; i < packets; ++i) {
+                publish(p, i);
+            }
+        });
+    }
+    while (ready.load() < producers) {
+        std::this_thread::yield();
+    }
+
+    Clock* clock = Clock::getInstance();
+    const int64_t startNs = clock->nowNs();
+    go = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return double(clock->nowNs() - startNs) / (double(packets) * producers);
+}
+
+static void runContention(uint64_t packets, std::ostringstream* json)
+{
+    static const int PRODUCERS[] = { 1, 2, 4, 8 };
+    std::ostringstream legacyJson, batchJson, repeatJson;
+
+    for (size_t n = 0; n < sizeof(PRODUCERS) / sizeof(PRODUCERS[0]); ++n) {
+        const int producers = PRODUCERS[n];
+        const char* separator = n ? "," : "";
+
+        // The control thread takes the mutex after every notification as before
+        std::atomic<bool> running(true);
+        LegacyHandoff legacy;
+        std::thread control(&LegacyHandoff::controlLoop, &legacy, &running);
+        const double legacyNs = runProducers(producers, packets, [&](int p, uint64_t i) {
+            for (int esc = 0; esc < 4; ++esc) {
+                legacy.setChannel(esc, PulseWidth::fromUs(1000 + int((i + p) % 1000)), int64_t(i));
+            }
+        });
+        running = false;
+        legacy.stop();
+        control.join();
+
+        SeqLockHandoff batch;
+        const double batchNs = runProducers(producers, packets, [&](int p, uint64_t i) {
+            BenchCommand command;
+            for (int esc = 0; esc < 4; ++esc) {
+                command.pulseWidth[esc] = PulseWidth::fromUs(1000 + int((i + p) % 1000));
+            }
+            command.timestampNs = int64_t(i);
+            batch.submit(command);
+        });
+
+        SeqLockHandoff repeat;
+        const double repeatNs = runProducers(producers, packets, [&](int, uint64_t i) {
+            BenchCommand command;
+            command.timestampNs = int64_t(i);
+            repeat.submit(command);
+        });
+
+        legacyJson << separator << "{\"producers\":" << producers << ",\"packet_ns\":" << legacyNs << "}";
+        batchJson << separator << "{\"producers\":" << producers << ",\"packet_ns\":" << batchNs << "}";
+        repeatJson << separator << "{\"producers\":" << producers << ",\"packet_ns\":" << repeatNs << "}";
+    }
+
+    *json << "{\"packets\":" << packets
+          << ",\"four_setters_mutex_condvar\":[" << legacyJson.str() << "]"
+          << ",\"batch_seqlock\":[" << batchJson.str() << "]"
+          << ",\"batch_seqlock_repeated\":[" << repeatJson.str() << "]}";
+}
+
+static std::string resultJson(const HandoffResult& result)
+{
+    std::ostringstream out;
+    out << "{\"setter_ns\":" << result.setterNs
+        << ",\"frame_latency_ns\":{\"samples\":" << result.frameLatency.samples
+        << ",\"p50\":" << result.frameLatency.p50Ns << ",\"p99\":" << result.frameLatency.p99Ns
+        << ",\"max\":" << result.frameLatency.maxNs << "}}";
+    return out.str();
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t iterations = 1000000;
+    int commands = 100;
+    uint64_t packets = 200000;
+    std::string label;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = std::max<uint64_t>(1, strtoull(argv[i] + 13, nullptr, 10));
+        } else if (strncmp(argv[i], "--commands=", 11) == 0) {
+            commands = atoi(argv[i] + 11);
+        } else if (strncmp(argv[i], "--packets=", 10) == 0) {
+            packets = std::max<uint64_t>(1, strtoull(argv[i] + 10, nullptr, 10));
+        } else if (strncmp(argv[i], "--label=", 8) == 0) {
+            label = argv[i] + 8;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::atomic<bool> legacyRunning(true);
+    LegacyHandoff legacy;
+    std::thread control(&LegacyHandoff::controlLoop, &legacy, &legacyRunning);
+    HandoffResult legacyResult = runHandoff(&legacy, &legacyRunning, iterations, commands);
+    legacy.stop();
+    control.join();
+
+    std::atomic<bool> seqLockRunning(true);
+    SeqLockHandoff seqLock;
+    HandoffResult seqLockResult = runHandoff(&seqLock, &seqLockRunning, iterations, commands);
+
+    std::ostringstream contention;
+    runContention(packets, &contention);
+
+    std::cout << "{\"label\":\"" << label << "\",\"iterations\":" << iterations
+              << ",\"handoff\":{\"mutex_condvar\":" << resultJson(legacyResult)
+              << ",\"seqlock\":" << resultJson(seqLockResult) << "}"
+              << ",\"contention\":" << contention.str() << "}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,55 @@
+# PWM timing benchmark, runs the ESC engine under synthetic load.
+# Builds without Qt libraries; GPIO backends as in EscController.pro.
+QT -= core gui
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = EscBenchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../clock.cpp \
+    ../dshot.cpp \
+    ../dshottelemetry.cpp \
+    ../esccontrol.cpp \
+    ../esccontrolthread.cpp \
+    ../escprotocol.cpp \
+    ../flightrecorder.cpp \
+    ../gpiohal.cpp \
+    ../logger.cpp \
+    ../hardwarepwm.cpp \
+    ../pwmscheduler.cpp \
+    ../sleepestimator.cpp \
+    ../timinghistogram.cpp \
+    ../trajectorybuffer.cpp \
+    ../virtualclock.cpp \
+    ../virtualgpio.cpp
+
+HEADERS += \
+    ../clock.h \
+    ../esccontrolthread.h \
+    ../flightrecorder.h \
+    ../gpiohal.h \
+    ../logger.h \
+    ../timinghistogram.h \
+    ../virtualgpio.h
+
+LIBS += -lpthread
+
+exists(/usr/include/wiringPi.h)|exists(/usr/local/include/wiringPi.h) {
+    DEFINES += HAVE_WIRINGPI
+    SOURCES += ../wiringpigpio.cpp
+    HEADERS += ../wiringpigpio.h
+    LIBS += -lwiringPi
+}
+
+system(pkg-config --atleast-version=2.0 libgpiod) {
+    DEFINES += HAVE_LIBGPIOD
+    SOURCES += ../gpiodgpio.cpp
+    HEADERS += ../gpiodgpio.h
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libgpiod
+}
@@ -0,0 +1,660 @@
+// PWM timing benchmark: runs the 4-ESC engine while background threads load
+// the CPU, memory bandwidth and filesystem, then prints one JSON object with
+// the timing percentiles and CPU use so runs can be compared across commits.
+//
+//   EscBenchmark [--duration=<s>] [--gpio=<virtual|wiringpi|gpiod>] [--protocol=<name>]
+//                [--cpu-load=<threads>] [--mem-load=<threads>] [--io-load=<threads>]
+//                [--io-dir=<path>] [--command-rate=<hz>] [--label=<text>] [--output=<file>]
+//                [--flight-recorder=<file>] [--engine=<scheduler|per-thread>] [--latency]
+//
+// --output appends the JSON line to a file (one run per line). With
+// --flight-recorder the run records every frame and command like the
+// controller does, and the cost of one record is measured afterwards.
+// --engine=per-thread runs the original generator instead of the scheduler
+// (one SCHED_FIFO thread per ESC sleeping and spinning through its own
+// 20ms period, standard PWM only) so CPU use and edge accuracy of the two
+// designs can be compared on the same machine and load.
+// DShot runs also report the cost of decoding one bidirectional telemetry
+// response from a synthesized SPI capture.
+// --latency steps ESC1 between two setpoints with every command and reports
+// how long each step takes to reach the pin, to compare the protocols'
+// command-to-output latency (analog protocols on the virtual GPIO backend).
+
+#include "esccontrolthread.h"
+#include "virtualgpio.h"
+#include "clock.h"
+#include "logger.h"
+#include "flightrecorder.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <sched.h>
+
+struct BenchmarkOptions {
+    double durationS = 10.0;
+    const char* gpioName = "virtual";
+    EscProtocol protocol = EscProtocol::StandardPwm;
+    int cpuLoadThreads = 0;
+    int memLoadThreads = 0;
+    int ioLoadThreads = 0;
+    std::string ioDir = "/tmp";
+    int commandRateHz = 50;
+    std::string label;
+    std::string output;
+    std::string flightRecorder;
+    bool perThread = false;
+    bool latency = false;
+};
+
+// Constant per-ESC setpoints so every measured pulse has a known expected width
+static const int BENCH_PULSE_US[4] = { 1200, 1400, 1600, 1800 };
+static const int BENCH_PINS[4] = {
+    ESCControlThread::PIN_ESC_1, ESCControlThread::PIN_ESC_2,
+    ESCControlThread::PIN_ESC_3, ESCControlThread::PIN_ESC_4
+};
+
+static constexpr size_t MEM_LOAD_BYTES = 64 * 1024 * 1024;
+static constexpr size_t IO_CHUNK_BYTES = 1024 * 1024;
+static constexpr int IO_CHUNKS_PER_FILE = 16;
+
+static std::atomic<bool> g_loadRunning(true);
+
+static int64_t threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+static int64_t processCpuNs()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (int64_t(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000000LL
+           + (int64_t(usage.ru_utime.tv_usec) + usage.ru_stime.tv_usec) * 1000LL;
+}
+
+// Load threads, each reports the CPU time it consumed
+
+static void cpuLoad(std::atomic<int64_t>* cpuNs)
+{
+    volatile double acc = 1.0;
+    uint64_t x = 88172645463325252ULL;
+    while (g_loadRunning.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 10000; ++i) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            acc = acc * 1.0000001 + double(x & 0xff) * 1e-9;
+        }
+    }
+    cpuNs->fetch_add(threadCpuNs());
+}
+
+static void memLoad(std::atomic<int64_t>* cpuNs)
+{
+    std::vector<uint8_t> source(MEM_LOAD_BYTES / 2, 0x5a);
+    std::vector<uint8_t> target(MEM_LOAD_BYTES / 2);
+    while (g_loadRunning.load(std::memory_order_relaxed)) {
+        memcpy(target.data(), source.data(), source.size());
+        source[target[source.size() / 2] % source.size()]++;
+    }
+    cpuNs->fetch_add(threadCpuNs());
+}
+
+static void ioLoad(const std::string& dir, int index, std::atomic<int64_t>* cpuNs)
+{
+    const std::string path = dir + "/escbenchmark-io-" + std::to_string(getpid()) + "-" + std::to_string(index);
+    std::vector<char> chunk(IO_CHUNK_BYTES, char('a' + index));
+
+    while (g_loadRunning.load(std::memory_order_relaxed)) {
+        int fd = open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0600);
+        if (fd < 0) {
+            std::cerr << "I/O load: cannot open " << path << ": " << strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < IO_CHUNKS_PER_FILE && g_loadRunning.load(std::memory_order_relaxed); ++i) {
+            if (write(fd, chunk.data(), chunk.size()) < 0) {
+                break;
+            }
+        }
+        fsync(fd);
+        lseek(fd, 0, SEEK_SET);
+        while (read(fd, chunk.data(), chunk.size()) > 0) {
+        }
+        close(fd);
+    }
+    unlink(path.c_str());
+    cpuNs->fetch_add(threadCpuNs());
+}
+
+// The pre-scheduler PWM generator, one per ESC: raise the pin, sleep and spin
+// through the pulse, lower it, then sleep and spin to the end of the period
+static constexpr int PER_THREAD_PERIOD_US = 20000;
+
+static void perThreadGenerator(int pin, int pulseWidthUs, std::atomic<bool>* running)
+{
+    struct sched_param params;
+    params.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &params);
+
+    Clock* clock = Clock::getInstance();
+    GpioHal* gpio = GpioHal::getInstance();
+
+    int64_t startNs = clock->nowNs();
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+    const int64_t overheadUs = std::max<int64_t>(0, (clock->nowNs() - startNs) / 1000 - 100);
+
+    while (running->load()) {
+        const int64_t cycleStartNs = clock->nowNs();
+
+        gpio->write(pin, true);
+        if (pulseWidthUs > overheadUs) {
+            std::this_thread::sleep_for(std::chrono::microseconds(pulseWidthUs - overheadUs));
+        }
+        while (clock->nowNs() - cycleStartNs < pulseWidthUs * 1000LL) {
+        }
+        gpio->write(pin, false);
+
+        const int64_t remainingUs = PER_THREAD_PERIOD_US - (clock->nowNs() - cycleStartNs) / 1000;
+        if (remainingUs > overheadUs) {
+            std::this_thread::sleep_for(std::chrono::microseconds(remainingUs - overheadUs));
+        }
+        while (clock->nowNs() - cycleStartNs < PER_THREAD_PERIOD_US * 1000LL) {
+        }
+    }
+}
+
+// Setpoint steps of --latency: ESC1 alternates between the two widths
+static const int LATENCY_STEP_US[2] = { 1200, 1800 };
+
+struct PendingStep {
+    int64_t submitNs;
+    int64_t widthNs;                    // expected width of the new pulse
+    int64_t previousWidthNs;
+};
+
+// Time from each ESC1 step to the rising edge of the first pulse that carries
+// it. A pulse belongs to the latest step submitted before it rose when its
+// width is closer to that step than to the previous setpoint; steps overtaken
+// by a later one before reaching the pin count as superseded.
+struct LatencyStats {
+    // 256 buckets span two frame periods
+    explicit LatencyStats(int64_t framePeriodNs) : outputLatency(std::max<int64_t>(1, framePeriodNs / 128)) {}
+
+    TimingHistogram outputLatency;
+    std::vector<PendingStep> pending;
+    int64_t lastRiseNs = 0;
+    uint64_t superseded = 0;
+};
+
+static void analyzeLatency(const std::vector<GpioEdge>& edges, LatencyStats* stats)
+{
+    for (const GpioEdge& edge : edges) {
+        if (edge.pin != BENCH_PINS[0]) {
+            continue;
+        }
+        if (edge.level) {
+            stats->lastRiseNs = edge.timeNs;
+            continue;
+        }
+        if (stats->lastRiseNs == 0) {
+            continue;
+        }
+
+        // Latest step submitted before the pulse started
+        const int64_t riseNs = stats->lastRiseNs;
+        size_t latest = 0;
+        while (latest < stats->pending.size() && stats->pending[latest].submitNs <= riseNs) {
+            ++latest;
+        }
+        if (latest == 0) {
+            continue;
+        }
+
+        const PendingStep& step = stats->pending[latest - 1];
+        const int64_t widthNs = edge.timeNs - riseNs;
+        if (std::llabs(widthNs - step.widthNs) < std::llabs(widthNs - step.previousWidthNs)) {
+            stats->outputLatency.record(riseNs - step.submitNs);
+            stats->superseded += latest - 1;
+            stats->pending.erase(stats->pending.begin(), stats->pending.begin() + latest);
+        }
+    }
+}
+
+// Per-channel statistics computed from the virtual GPIO edge trace
+
+struct EdgeStats {
+    TimingHistogram widthError;
+    TimingHistogram periodError;
+    int64_t lastRiseNs = 0;
+    uint64_t pulses = 0;
+};
+
+static void analyzeEdges(const std::vector<GpioEdge>& edges, EdgeStats stats[4],
+                         const int64_t expectedWidthNs[4], int64_t periodNs)
+{
+    for (const GpioEdge& edge : edges) {
+        int channel = -1;
+        for (int i = 0; i < 4; ++i) {
+            if (BENCH_PINS[i] == edge.pin) {
+                channel = i;
+            }
+        }
+        if (channel < 0 || expectedWidthNs[channel] == 0) {
+            continue;
+        }
+
+        EdgeStats& s = stats[channel];
+        if (edge.level) {
+            if (s.lastRiseNs != 0) {
+                s.periodError.record(edge.timeNs - s.lastRiseNs - periodNs);
+            }
+            s.lastRiseNs = edge.timeNs;
+        } else if (s.lastRiseNs != 0) {
+            s.widthError.record(edge.timeNs - s.lastRiseNs - expectedWidthNs[channel]);
+            ++s.pulses;
+        }
+    }
+}
+
+// Cost of one frame record, averaged over batches (1ns buckets)
+static TimingSummary measureRecordCost(FlightRecorder* recorder, const PulseWidth outputs[4])
+{
+    static constexpr int BATCHES = 1000;
+    static constexpr int BATCH_SIZE = 64;
+
+    Clock* clock = Clock::getInstance();
+    TimingHistogram cost(1);
+    for (int batch = 0; batch < BATCHES; ++batch) {
+        const int64_t startNs = clock->nowNs();
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            recorder->recordFrame(startNs, i, outputs);
+        }
+        cost.record((clock->nowNs() - startNs) / BATCH_SIZE);
+    }
+    return cost.summary();
+}
+
+// Cost of single frame records for a second while another thread writes the
+// recorder file back every millisecond; the load threads are still running.
+// Page faults and writeback waits show in p99/max (100ns buckets).
+static TimingSummary measureRecordWritebackCost(FlightRecorder* recorder, const std::string& path,
+                                                const PulseWidth outputs[4])
+{
+    static constexpr int64_t DURATION_NS = 1000000000LL;
+    static constexpr int64_t WRITEBACK_INTERVAL_NS = 1000000;
+
+    std::atomic<bool> measuring(true);
+    std::thread writeback([&path, &measuring] {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Flight recorder writeback: cannot open " << path << ": " << strerror(errno) << std::endl;
+            return;
+        }
+        while (measuring.load(std::memory_order_relaxed)) {
+            fdatasync(fd);
+            std::this_thread::sleep_for(std::chrono::nanoseconds(WRITEBACK_INTERVAL_NS));
+        }
+        close(fd);
+    });
+
+    Clock* clock = Clock::getInstance();
+    TimingHistogram cost(100);
+    const int64_t endNs = clock->nowNs() + DURATION_NS;
+    for (int64_t startNs = clock->nowNs(); startNs < endNs; startNs = clock->nowNs()) {
+        recorder->recordFrame(startNs, 0, outputs);
+        cost.record(clock->nowNs() - startNs);
+    }
+
+    measuring = false;
+    writeback.join();
+    return cost.summary();
+}
+
+// Cost of decoding one bidirectional DShot response from an SPI capture like
+// DShotSpiSink's, averaged over batches of varying eRPM values (10ns buckets)
+static TimingSummary measureTelemetryDecodeCost(int bitRate, uint64_t* decodeErrors)
+{
+    static constexpr int BATCHES = 1000;
+    static constexpr int BATCH_SIZE = 64;
+    static constexpr int CAPTURE_BYTES = 128;
+
+    // 8 samples per DShot bit, ~30μs turnaround before the response
+    const int64_t bitPeriodNs = 1000000000LL / bitRate;
+    const uint32_t samplesPerBitQ8 = DShotSpiSink::SPI_BITS_PER_BIT * 256 * 4 / 5;
+    const size_t startSample = size_t(30000 * DShotSpiSink::SPI_BITS_PER_BIT / bitPeriodNs);
+
+    uint8_t captures[BATCH_SIZE][CAPTURE_BYTES];
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        const uint16_t value = uint16_t((i * 61 + 100) & 0x0FFF);
+        const uint32_t levels = DShotTelemetryDecoder::encodeLevels(
+            DShotTelemetryDecoder::encodeGcr(DShotTelemetryDecoder::encodeWord(value)));
+        DShotTelemetryDecoder::synthesizePacked(levels, samplesPerBitQ8, startSample,
+                                                captures[i], CAPTURE_BYTES * 8);
+    }
+
+    Clock* clock = Clock::getInstance();
+    TimingHistogram cost(10);
+    *decodeErrors = 0;
+    for (int batch = 0; batch < BATCHES; ++batch) {
+        const int64_t startNs = clock->nowNs();
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            DShotTelemetry telemetry;
+            if (!DShotTelemetryDecoder::decodePacked(captures[i], CAPTURE_BYTES * 8, samplesPerBitQ8, &telemetry)) {
+                ++*decodeErrors;
+            }
+        }
+        cost.record((clock->nowNs() - startNs) / BATCH_SIZE);
+    }
+    return cost.summary();
+}
+
+static std::string summaryJson(const TimingSummary& summary)
+{
+    std::ostringstream out;
+    out << "{\"samples\":" << summary.samples << ",\"p50\":" << summary.p50Ns
+        << ",\"p99\":" << summary.p99Ns << ",\"max\":" << summary.maxNs << "}";
+    return out.str();
+}
+
+static std::string jsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+static bool parseOptions(int argc, char* argv[], BenchmarkOptions* options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--duration=", 11) == 0) {
+            options->durationS = atof(arg + 11);
+        } else if (strncmp(arg, "--gpio=", 7) == 0) {
+            options->gpioName = arg + 7;
+        } else if (strncmp(arg, "--protocol=", 11) == 0) {
+            if (!escProtocolFromName(arg + 11, &options->protocol)) {
+                std::cerr << "Unknown ESC protocol: " << arg + 11 << std::endl;
+                return false;
+            }
+        } else if (strncmp(arg, "--cpu-load=", 11) == 0) {
+            options->cpuLoadThreads = atoi(arg + 11);
+        } else if (strncmp(arg, "--mem-load=", 11) == 0) {
+            options->memLoadThreads = atoi(arg + 11);
+        } else if (strncmp(arg, "--io-load=", 10) == 0) {
+            options->ioLoadThreads = atoi(arg + 10);
+        } else if (strncmp(arg, "--io-dir=", 9) == 0) {
+            options->ioDir = arg + 9;
+        } else if (strncmp(arg, "--command-rate=", 15) == 0) {
+            options->commandRateHz = std::max(1, atoi(arg + 15));
+        } else if (strncmp(arg, "--label=", 8) == 0) {
+            options->label = arg + 8;
+        } else if (strncmp(arg, "--output=", 9) == 0) {
+            options->output = arg + 9;
+        } else if (strncmp(arg, "--flight-recorder=", 18) == 0) {
+            options->flightRecorder = arg + 18;
+        } else if (strcmp(arg, "--latency") == 0) {
+            options->latency = true;
+        } else if (strncmp(arg, "--engine=", 9) == 0) {
+            if (strcmp(arg + 9, "per-thread") == 0) {
+                options->perThread = true;
+            } else if (strcmp(arg + 9, "scheduler") != 0) {
+                std::cerr << "Unknown engine: " << arg + 9 << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+    }
+    if (options->perThread && options->protocol != EscProtocol::StandardPwm) {
+        std::cerr << "--engine=per-thread only generates standard PWM" << std::endl;
+        return false;
+    }
+    if (options->perThread && options->latency) {
+        std::cerr << "--latency needs the scheduler engine" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        return 1;
+    }
+
+    GpioBackendType gpioType;
+    if (!GpioHal::typeFromName(options.gpioName, &gpioType) || !GpioHal::select(gpioType)) {
+        std::cerr << "GPIO backend not available: " << options.gpioName << std::endl;
+        return 1;
+    }
+    VirtualGpio* virtualGpio = gpioType == GpioBackendType::Virtual
+                               ? static_cast<VirtualGpio*>(GpioHal::getInstance()) : nullptr;
+    const bool digital = escProtocolIsDigital(options.protocol);
+
+    // Engine log goes to stderr, stdout carries only the result
+    Logger::getInstance()->setOutput(stderr);
+
+    FlightRecorder* recorder = FlightRecorder::getInstance();
+    if (!options.flightRecorder.empty() && !recorder->open(options.flightRecorder)) {
+        return 1;
+    }
+
+    ESCCommandBatch command;
+    int64_t expectedWidthNs[4];
+    for (int i = 0; i < 4; ++i) {
+        command.pulseWidth[i] = PulseWidth::fromUs(BENCH_PULSE_US[i]);
+        expectedWidthNs[i] = escProtocolPulseNs(options.protocol, command.pulseWidth[i]);
+    }
+
+    ESCControlThread escControl;
+    std::atomic<bool> generatorsRunning(true);
+    std::vector<std::thread> generators;
+    int64_t framePeriodNs = PER_THREAD_PERIOD_US * 1000LL;
+    if (options.perThread) {
+        GpioHal* gpio = GpioHal::getInstance();
+        if (!gpio->setup()) {
+            std::cerr << "Failed to set up GPIO" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < 4; ++i) {
+            if (!gpio->configureOutput(BENCH_PINS[i])) {
+                std::cerr << "Failed to configure GPIO " << BENCH_PINS[i] << std::endl;
+                return 1;
+            }
+            generators.emplace_back(perThreadGenerator, BENCH_PINS[i], BENCH_PULSE_US[i], &generatorsRunning);
+        }
+    } else {
+        escControl.setProtocol(options.protocol);
+        if (!escControl.initialize()) {
+            std::cerr << "Failed to initialize the ESC engine" << std::endl;
+            return 1;
+        }
+        escControl.submitCommand(command);
+        framePeriodNs = PwmScheduler::getInstance()->getFramePeriodNs();
+    }
+
+    // Let the new command settle before measuring
+    Clock* clock = Clock::getInstance();
+    clock->sleepForNs(200000000LL);
+    escControl.resetTimingStats();
+    if (virtualGpio) {
+        virtualGpio->takeEdges();
+    }
+
+    std::atomic<int64_t> loadCpuNs(0);
+    std::vector<std::thread> loadThreads;
+    for (int i = 0; i < options.cpuLoadThreads; ++i) {
+        loadThreads.emplace_back(cpuLoad, &loadCpuNs);
+    }
+    for (int i = 0; i < options.memLoadThreads; ++i) {
+        loadThreads.emplace_back(memLoad, &loadCpuNs);
+    }
+    for (int i = 0; i < options.ioLoadThreads; ++i) {
+        loadThreads.emplace_back(ioLoad, options.ioDir, i, &loadCpuNs);
+    }
+
+    // ESC1 steps with every command, its widths are measured as latency
+    LatencyStats latencyStats(framePeriodNs);
+    int64_t latencyWidthNs[2] = { 0, 0 };
+    if (options.latency) {
+        for (int i = 0; i < 2; ++i) {
+            latencyWidthNs[i] = escProtocolPulseNs(options.protocol, PulseWidth::fromUs(LATENCY_STEP_US[i]));
+        }
+        expectedWidthNs[0] = 0;
+    }
+    int step = 0;
+
+    // Repeat the command at the BLE rate (exercises compare-and-skip) and
+    // drain the edge log often enough that it never overflows
+    EdgeStats edgeStats[4];
+    const int64_t commandIntervalNs = 1000000000LL / options.commandRateHz;
+    const int64_t startNs = clock->nowNs();
+    const int64_t startCpuNs = processCpuNs();
+    const int64_t endNs = startNs + int64_t(options.durationS * 1e9);
+
+    for (int64_t nextNs = startNs; nextNs < endNs; nextNs += commandIntervalNs) {
+        clock->sleepUntilNs(nextNs);
+        if (options.latency) {
+            step ^= 1;
+            command.pulseWidth[0] = PulseWidth::fromUs(LATENCY_STEP_US[step]);
+            latencyStats.pending.push_back({ clock->nowNs(), latencyWidthNs[step], latencyWidthNs[step ^ 1] });
+        }
+        if (!options.perThread) {
+            escControl.submitCommand(command);
+        }
+        recorder->recordCommand(clock->nowNs(), reinterpret_cast<const uint8_t*>(command.pulseWidth),
+                                sizeof(command.pulseWidth), command.pulseWidth);
+        if (virtualGpio && !digital) {
+            std::vector<GpioEdge> edges = virtualGpio->takeEdges();
+            analyzeEdges(edges, edgeStats, expectedWidthNs, framePeriodNs);
+            if (options.latency) {
+                analyzeLatency(edges, &latencyStats);
+            }
+        }
+    }
+
+    const int64_t wallNs = clock->nowNs() - startNs;
+    uint64_t recordedCount = 0;
+    TimingSummary recordWritebackCost;
+    if (recorder->isOpen()) {
+        recordedCount = recorder->getRecordCount();
+        recordWritebackCost = measureRecordWritebackCost(recorder, options.flightRecorder, command.pulseWidth);
+    }
+    g_loadRunning = false;
+    for (std::thread& thread : loadThreads) {
+        thread.join();
+    }
+    generatorsRunning = false;
+    for (std::thread& thread : generators) {
+        thread.join();
+    }
+    const int64_t totalCpuNs = processCpuNs() - startCpuNs;
+    const int64_t engineCpuNs = std::max<int64_t>(0, totalCpuNs - loadCpuNs.load());
+
+    if (virtualGpio && !digital) {
+        std::vector<GpioEdge> edges = virtualGpio->takeEdges();
+        analyzeEdges(edges, edgeStats, expectedWidthNs, framePeriodNs);
+        if (options.latency) {
+            analyzeLatency(edges, &latencyStats);
+        }
+    }
+    PwmTimingReport report = escControl.getTimingReport();
+    escControl.stop();
+
+    TimingSummary recordCost;
+    if (recorder->isOpen()) {
+        recordCost = measureRecordCost(recorder, command.pulseWidth);
+        recorder->close();
+    }
+
+    // Telemetry decode runs on the PWM thread after every bidirectional frame
+    uint64_t decodeErrors = 0;
+    TimingSummary decodeCost;
+    if (digital) {
+        decodeCost = measureTelemetryDecodeCost(escProtocolTiming(options.protocol).bitRate, &decodeErrors);
+    }
+
+    std::ostringstream json;
+    json << "{\"label\":" << jsonString(options.label)
+         << ",\"gpio\":" << jsonString(GpioHal::typeName(gpioType))
+         << ",\"engine\":" << jsonString(options.perThread ? "per-thread" : "scheduler")
+         << ",\"protocol\":" << jsonString(escProtocolTiming(options.protocol).name)
+         << ",\"duration_s\":" << wallNs / 1e9
+         << ",\"load\":{\"cpu\":" << options.cpuLoadThreads << ",\"memory\":" << options.memLoadThreads
+         << ",\"io\":" << options.ioLoadThreads << "}"
+         << ",\"cpu\":{\"engine_s\":" << engineCpuNs / 1e9
+         << ",\"engine_pct\":" << std::round(1000.0 * engineCpuNs / wallNs) / 10.0
+         << ",\"load_s\":" << loadCpuNs.load() / 1e9 << "}";
+    if (!options.perThread) {
+        json << ",\"frames\":" << report.frames
+             << ",\"overruns\":" << report.overruns
+             << ",\"skipped_frames\":" << report.skippedFrames
+             << ",\"late_wakeups\":" << report.lateWakeups
+             << ",\"spin_margin_ns\":" << report.spinMarginNs
+             << ",\"spin_time_s\":" << report.spinTimeNs / 1e9
+             << ",\"period_error_ns\":" << summaryJson(report.periodError)
+             << ",\"command_latency_ns\":" << summaryJson(report.commandLatency);
+    }
+    json << ",\"channels\":[";
+    for (int i = 0; i < 4; ++i) {
+        json << (i ? "," : "") << "{\"pin\":" << BENCH_PINS[i]
+             << ",\"pulse_us\":" << BENCH_PULSE_US[i];
+        if (!options.perThread) {
+            json << ",\"pulse_error_ns\":" << summaryJson(report.pulseError[i])
+                 << ",\"missed_deadlines\":" << report.missedDeadlines[i];
+        }
+        if (virtualGpio && !digital) {
+            json << ",\"edge_width_error_ns\":" << summaryJson(edgeStats[i].widthError.summary())
+                 << ",\"edge_period_error_ns\":" << summaryJson(edgeStats[i].periodError.summary());
+        }
+        json << "}";
+    }
+    json << "]";
+    if (options.latency) {
+        json << ",\"latency\":{\"frame_period_ns\":" << framePeriodNs;
+        if (virtualGpio && !digital) {
+            json << ",\"output_latency_ns\":" << summaryJson(latencyStats.outputLatency.summary())
+                 << ",\"superseded\":" << latencyStats.superseded;
+        }
+        json << "}";
+    }
+    if (digital) {
+        json << ",\"telemetry_decode\":{\"cost_ns\":" << summaryJson(decodeCost)
+             << ",\"errors\":" << decodeErrors << "}";
+    }
+    if (!options.flightRecorder.empty()) {
+        json << ",\"flight_recorder\":{\"records\":" << recordedCount
+             << ",\"record_cost_ns\":" << summaryJson(recordCost)
+             << ",\"record_writeback_ns\":" << summaryJson(recordWritebackCost) << "}";
+    }
+    json << "}";
+
+    std::cout << json.str() << std::endl;
+    if (!options.output.empty()) {
+        std::ofstream file(options.output, std::ios::app);
+        file << json.str() << "\n";
+    }
+    return 0;
+}
@@ -8,21 +8,70 @@ TARGET = esccontrol
 TEMPLATE = app
 
 SOURCES += \
+    blecapture.cpp \
+    clock.cpp \
+    dshot.cpp \
+    dshottelemetry.cpp \
     esccontrolthread.cpp \
     gattserver.cpp \
+    hardwarepwm.cpp \
     main.cpp \
     esccontrol.cpp \
+    escprotocol.cpp \
+    flightrecorder.cpp \
+    gpiohal.cpp \
+    logger.cpp \
     message.cpp \
-    servocontroller.cpp
+    pwmscheduler.cpp \
+    servocontroller.cpp \
+    sleepestimator.cpp \
+    timinghistogram.cpp \
+    trajectorybuffer.cpp \
+    virtualclock.cpp \
+    virtualgpio.cpp
 
 HEADERS += \
+    blecapture.h \
+    clock.h \
+    dshot.h \
+    dshottelemetry.h \
     esccontrol.h \
     esccontrolthread.h \
+    escprotocol.h \
+    flightrecorder.h \
     gattserver.h \
+    gpiohal.h \
+    hardwarepwm.h \
+    logger.h \
     message.h \
-    servocontroller.h
+    pulsewidth.h \
+    pwmscheduler.h \
+    seqlock.h \
+    servocontroller.h \
+    sleepestimator.h \
+    timinghistogram.h \
+    trajectorybuffer.h \
+    virtualclock.h \
+    virtualgpio.h
 
-LIBS += -lwiringPi -lpthread
+LIBS += -lpthread
+
+# GPIO backends are built when their library is installed, the virtual
+# backend is always available (select with --gpio=wiringpi|gpiod|virtual)
+exists(/usr/include/wiringPi.h)|exists(/usr/local/include/wiringPi.h) {
+    DEFINES += HAVE_WIRINGPI
+    SOURCES += wiringpigpio.cpp
+    HEADERS += wiringpigpio.h
+    LIBS += -lwiringPi
+}
+
+system(pkg-config --atleast-version=2.0 libgpiod) {
+    DEFINES += HAVE_LIBGPIOD
+    SOURCES += gpiodgpio.cpp
+    HEADERS += gpiodgpio.h
+    CONFIG += link_pkgconfig
+    PKGCONFIG += libgpiod
+}
 
 DISTFILES += \
     README.md
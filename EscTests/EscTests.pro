@@ -0,0 +1,59 @@
+# Unit tests for the ESC engine, `make check` runs them. Everything runs on
+# the virtual GPIO backend and a temporary directory, no hardware needed.
+QT += core
+QT -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = EscTests
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    dshottelemetrytest.cpp \
+    dshottest.cpp \
+    failsafetest.cpp \
+    framelatchtest.cpp \
+    hardwarepwmtest.cpp \
+    messagedecodertest.cpp \
+    messagepacktest.cpp \
+    sleepestimatortest.cpp \
+    slewtest.cpp \
+    trajectorytest.cpp \
+    virtualclocktest.cpp \
+    virtualengine.cpp \
+    ../clock.cpp \
+    ../dshot.cpp \
+    ../dshottelemetry.cpp \
+    ../esccontrol.cpp \
+    ../esccontrolthread.cpp \
+    ../escprotocol.cpp \
+    ../flightrecorder.cpp \
+    ../gpiohal.cpp \
+    ../hardwarepwm.cpp \
+    ../logger.cpp \
+    ../message.cpp \
+    ../pwmscheduler.cpp \
+    ../sleepestimator.cpp \
+    ../timinghistogram.cpp \
+    ../trajectorybuffer.cpp \
+    ../virtualclock.cpp \
+    ../virtualgpio.cpp
+
+HEADERS += \
+    esctest.h \
+    virtualengine.h \
+    ../clock.h \
+    ../dshot.h \
+    ../dshottelemetry.h \
+    ../esccontrol.h \
+    ../esccontrolthread.h \
+    ../hardwarepwm.h \
+    ../message.h \
+    ../virtualclock.h \
+    ../virtualgpio.h
+
+LIBS += -lpthread
@@ -0,0 +1,107 @@
+// Bidirectional DShot telemetry: synthesized ESC responses through the GCR
+// decoder, valid and corrupted
+
+#include "esctest.h"
+#include "dshottelemetry.h"
+
+// SPI capture of the response: 8 samples per DShot bit, the response runs at 5/4 the bit rate
+static constexpr uint32_t SPI_SAMPLES_PER_BIT_Q8 = 8 * 256 * 4 / 5;
+static constexpr size_t CAPTURE_SAMPLES = 512;
+static constexpr size_t RESPONSE_START = 100;
+
+static uint32_t levelsFor(uint16_t value)
+{
+    return DShotTelemetryDecoder::encodeLevels(
+        DShotTelemetryDecoder::encodeGcr(DShotTelemetryDecoder::encodeWord(value)));
+}
+
+TEST(telemetryRoundTripsEveryValue)
+{
+    int mismatches = 0;
+    for (uint16_t value = 0; value < 0x1000; ++value) {
+        const uint32_t levels = levelsFor(value);
+
+        DShotTelemetry fromLevels;
+        if (!DShotTelemetryDecoder::decodeLevels(levels, &fromLevels) || fromLevels.value != value) {
+            ++mismatches;
+        }
+
+        uint8_t capture[CAPTURE_SAMPLES / 8];
+        DShotTelemetryDecoder::synthesizePacked(levels, SPI_SAMPLES_PER_BIT_Q8, RESPONSE_START,
+                                                capture, CAPTURE_SAMPLES);
+        DShotTelemetry fromCapture;
+        if (!DShotTelemetryDecoder::decodePacked(capture, CAPTURE_SAMPLES, SPI_SAMPLES_PER_BIT_Q8, &fromCapture) ||
+            fromCapture.value != value) {
+            ++mismatches;
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+TEST(telemetryPeriodAndErpm)
+{
+    // Exponent 2, mantissa 250: 1000μs per electrical revolution
+    DShotTelemetry telemetry;
+    CHECK(DShotTelemetryDecoder::decodeLevels(levelsFor((2 << 9) | 250), &telemetry));
+    CHECK_EQ(telemetry.periodUs, 1000u);
+    CHECK_EQ(telemetry.eRpm, 60000u);
+
+    // 0xFFF: motor stopped
+    CHECK(DShotTelemetryDecoder::decodeLevels(levelsFor(0x0FFF), &telemetry));
+    CHECK_EQ(telemetry.periodUs, 0u);
+    CHECK_EQ(telemetry.eRpm, 0u);
+}
+
+TEST(telemetryRejectsBadChecksum)
+{
+    int accepted = 0;
+    for (uint16_t value = 0; value < 0x1000; value += 7) {
+        for (int bit = 0; bit < 4; ++bit) {
+            const uint16_t word = DShotTelemetryDecoder::encodeWord(value) ^ uint16_t(1 << bit);
+            DShotTelemetry telemetry;
+            if (DShotTelemetryDecoder::decodeLevels(
+                    DShotTelemetryDecoder::encodeLevels(DShotTelemetryDecoder::encodeGcr(word)), &telemetry)) {
+                ++accepted;
+            }
+        }
+    }
+    CHECK_EQ(accepted, 0);
+}
+
+TEST(telemetryRejectsBadSymbol)
+{
+    // Codes that are not in the GCR table, in every quintet position
+    static const uint8_t INVALID[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                                       0x08, 0x0C, 0x10, 0x11, 0x14, 0x18, 0x1C, 0x1F };
+    int accepted = 0;
+    const uint32_t gcr = DShotTelemetryDecoder::encodeGcr(DShotTelemetryDecoder::encodeWord(0x4FA));
+    for (int quintet = 0; quintet < 4; ++quintet) {
+        for (uint8_t code : INVALID) {
+            const uint32_t corrupted = (gcr & ~(0x1Fu << (quintet * 5))) | (uint32_t(code) << (quintet * 5));
+            DShotTelemetry telemetry;
+            if (DShotTelemetryDecoder::decodeLevels(DShotTelemetryDecoder::encodeLevels(corrupted), &telemetry)) {
+                ++accepted;
+            }
+
+            uint8_t capture[CAPTURE_SAMPLES / 8];
+            DShotTelemetryDecoder::synthesizePacked(DShotTelemetryDecoder::encodeLevels(corrupted),
+                                                    SPI_SAMPLES_PER_BIT_Q8, RESPONSE_START, capture, CAPTURE_SAMPLES);
+            if (DShotTelemetryDecoder::decodePacked(capture, CAPTURE_SAMPLES, SPI_SAMPLES_PER_BIT_Q8, &telemetry)) {
+                ++accepted;
+            }
+        }
+    }
+    CHECK_EQ(accepted, 0);
+}
+
+TEST(telemetryRejectsMissingResponse)
+{
+    // Line idle for the whole capture, and a response cut off by the capture end
+    uint8_t capture[CAPTURE_SAMPLES / 8];
+    DShotTelemetry telemetry;
+    DShotTelemetryDecoder::synthesizePacked(0x1FFFFF, SPI_SAMPLES_PER_BIT_Q8, RESPONSE_START, capture, CAPTURE_SAMPLES);
+    CHECK(!DShotTelemetryDecoder::decodePacked(capture, CAPTURE_SAMPLES, SPI_SAMPLES_PER_BIT_Q8, &telemetry));
+
+    DShotTelemetryDecoder::synthesizePacked(levelsFor(0x123), SPI_SAMPLES_PER_BIT_Q8, RESPONSE_START, capture, CAPTURE_SAMPLES);
+    CHECK(!DShotTelemetryDecoder::decodePacked(capture, RESPONSE_START + 40, SPI_SAMPLES_PER_BIT_Q8, &telemetry));
+}
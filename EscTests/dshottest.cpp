@@ -0,0 +1,105 @@
+// DShot frame encoding and the bit timing of the GPIO and SPI sinks
+
+#include "esctest.h"
+#include "dshot.h"
+#include "virtualgpio.h"
+#include "virtualclock.h"
+
+TEST(dshotFrameEncoding)
+{
+    // Value 1046, no telemetry: packet 0x82c, CRC 0xc ^ 0x2 ^ 0x8 = 0x6
+    CHECK_EQ(DShotEncoder::encodeFrame(1046, false), 0x82C6);
+    CHECK_EQ(DShotEncoder::encodeFrame(1046, true), 0x82D7);
+    CHECK_EQ(DShotEncoder::encodeFrame(1046, false, true), 0x82C9);
+    CHECK_EQ(DShotEncoder::encodeFrame(0, false), 0x0000);
+    CHECK_EQ(DShotEncoder::encodeFrame(2047, false), 0xFFEE);
+
+    // Only the 11 value bits are sent
+    CHECK_EQ(DShotEncoder::encodeFrame(1046 | 0x800, false), 0x82C6);
+}
+
+TEST(dshotCommandMapping)
+{
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1000), false), 0);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(2000), false), 2047);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1500), false), 1047);
+
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1500), true), 0);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(2000), true), 2047);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1000), true), 1047);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1501), true), DShotEncoder::THROTTLE_3D_FORWARD_MIN + 1);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(1499), true), DShotEncoder::THROTTLE_MIN + 1);
+
+    // Integer commands far outside the range saturate instead of wrapping
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(INT32_MAX), false), 2047);
+    CHECK_EQ(DShotEncoder::commandToValue(PulseWidth::fromUs(INT32_MIN), false), 0);
+    CHECK_EQ(PulseWidth::fromUs(INT32_MAX).ticks(), PulseWidth::MAX_US * PulseWidth::TICKS_PER_US);
+}
+
+TEST(dshotBitTiming)
+{
+    const DShotBitTiming dshot600 = DShotEncoder::bitTiming(600000);
+    CHECK_EQ(dshot600.bitPeriodNs, 1666);
+    CHECK_EQ(dshot600.zeroHighNs, 624);
+    CHECK_EQ(dshot600.oneHighNs, 1249);
+
+    const DShotBitTiming dshot150 = DShotEncoder::bitTiming(150000);
+    CHECK_EQ(dshot150.bitPeriodNs, 6666);
+    CHECK_EQ(dshot150.zeroHighNs, 2499);
+    CHECK_EQ(dshot150.oneHighNs, 4999);
+}
+
+TEST(dshotSpiBytePattern)
+{
+    // 8 SPI bits per DShot bit: 3 high for a 0, 6 high for a 1
+    const uint16_t frame = DShotEncoder::encodeFrame(1046, false);
+    uint8_t bytes[DShotEncoder::FRAME_BITS];
+    uint8_t inverted[DShotEncoder::FRAME_BITS];
+    DShotSpiSink::encodeBytes(frame, DShotEncoder::bitTiming(600000), false, bytes);
+    DShotSpiSink::encodeBytes(frame, DShotEncoder::bitTiming(600000), true, inverted);
+
+    for (int bit = 0; bit < DShotEncoder::FRAME_BITS; ++bit) {
+        const bool one = frame & (0x8000 >> bit);
+        CHECK_EQ(int(bytes[bit]), one ? 0xFC : 0xE0);
+        CHECK_EQ(int(inverted[bit]), one ? 0x03 : 0x1F);
+    }
+}
+
+TEST(dshotGpioSinkWaveform)
+{
+    static constexpr int PIN = 18;
+
+    GpioHal::select(GpioBackendType::Virtual);
+    VirtualGpio* gpio = static_cast<VirtualGpio*>(GpioHal::getInstance());
+
+    VirtualClock clock(true, 1000000);
+    Clock::setInstance(&clock);
+    {
+        ClockThread attach;
+
+        const DShotBitTiming timing = DShotEncoder::bitTiming(150000);
+        DShotGpioSink sink(PIN);
+        CHECK(sink.open(timing));
+        gpio->takeEdges();
+
+        const uint16_t frame = DShotEncoder::encodeFrame(1046, false);
+        const int64_t startNs = clock.nowNs();
+        CHECK(sink.transmit(frame));
+
+        // One rise on the bit grid and one fall after the bit's high time per bit
+        std::vector<GpioEdge> edges = gpio->takeEdges();
+        CHECK_EQ(edges.size(), size_t(2 * DShotEncoder::FRAME_BITS));
+        for (size_t i = 0; i + 1 < edges.size(); i += 2) {
+            const int bit = int(i / 2);
+            const int64_t bitStartNs = startNs + bit * timing.bitPeriodNs;
+            const int64_t highNs = (frame & (0x8000 >> bit)) ? timing.oneHighNs : timing.zeroHighNs;
+            CHECK_EQ(edges[i].pin, PIN);
+            CHECK(edges[i].level);
+            CHECK_EQ(edges[i].timeNs, bitStartNs);
+            CHECK(!edges[i + 1].level);
+            CHECK_EQ(edges[i + 1].timeNs, bitStartNs + highNs);
+        }
+        sink.close();
+    }
+    Clock::setInstance(nullptr);
+}
@@ -0,0 +1,58 @@
+#ifndef ESCTEST_H
+#define ESCTEST_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Minimal test registry: TEST(name) defines a test case that registers
+// itself, CHECK*() record a failure and carry on with the rest of the case.
+// main.cpp runs every case (or the ones whose name contains the filter
+// argument) and exits non-zero when any check failed.
+struct EscTestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<EscTestCase>& escTestCases();
+void escTestFail(const char* file, int line, const std::string& message);
+
+struct EscTestRegistrar {
+    EscTestRegistrar(const char* name, void (*run)()) { escTestCases().push_back({ name, run }); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static EscTestRegistrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            escTestFail(__FILE__, __LINE__, "CHECK(" #condition ")"); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    do { \
+        const auto actualValue_ = (actual); \
+        const auto expectedValue_ = (expected); \
+        if (!(actualValue_ == expectedValue_)) { \
+            escTestFail(__FILE__, __LINE__, "CHECK_EQ(" #actual ", " #expected "): " \
+                        + std::to_string(actualValue_) + " != " + std::to_string(expectedValue_)); \
+        } \
+    } while (0)
+
+// |actual - expected| <= tolerance
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        const int64_t actualValue_ = (actual); \
+        const int64_t expectedValue_ = (expected); \
+        if (actualValue_ < expectedValue_ - (tolerance) || actualValue_ > expectedValue_ + (tolerance)) { \
+            escTestFail(__FILE__, __LINE__, "CHECK_NEAR(" #actual ", " #expected "): " \
+                        + std::to_string(actualValue_) + " != " + std::to_string(expectedValue_)); \
+        } \
+    } while (0)
+
+#endif // ESCTEST_H
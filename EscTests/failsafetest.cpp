@@ -0,0 +1,129 @@
+// Command-timeout failsafe in simulated time: trip, recovery and a command
+// that arrives at the deadline
+
+#include "esctest.h"
+#include "virtualengine.h"
+
+static const int64_t FRAME_NS = 20000000;
+static const int64_t TIMEOUT_NS = 100000000;
+
+static ESCCommandBatch uniformCommand(int pulseWidthUs)
+{
+    ESCCommandBatch batch;
+    for (PulseWidth& pulseWidth : batch.pulseWidth) {
+        pulseWidth = PulseWidth::fromUs(pulseWidthUs);
+    }
+    return batch;
+}
+
+static uint64_t failsafeCount(VirtualEngine& engine)
+{
+    return engine.escControl().getTimingReport().failsafeCount;
+}
+
+TEST(failsafeTripsAtDeadlineAndRecovers)
+{
+    VirtualEngine engine;
+    engine.escControl().setCommandTimeout(int(TIMEOUT_NS / 1000000), FailsafeMode::Jump);
+    CHECK(engine.start());
+
+    engine.escControl().submitCommand(uniformCommand(1800));
+    const int64_t deadlineNs = engine.nowNs() + TIMEOUT_NS;
+    engine.runFor(TIMEOUT_NS + 3 * FRAME_NS);
+
+    // Frames that start before the deadline keep the command, the first one
+    // at or after it is already neutral
+    int commanded = 0;
+    int neutral = 0;
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        if (pulse.riseNs < deadlineNs) {
+            commanded += pulse.widthNs == 1800000;
+            CHECK(pulse.widthNs == 1800000 || pulse.widthNs == 1500000);
+        } else {
+            CHECK_EQ(pulse.widthNs, 1500000);
+            ++neutral;
+        }
+    }
+    CHECK(commanded >= 4 * 4);
+    CHECK(neutral >= 3 * 4);
+    CHECK(engine.escControl().isFailsafeActive());
+    CHECK_EQ(failsafeCount(engine), 1u);
+    CHECK(engine.escControl().getTimingReport().failsafeReaction.maxNs < FRAME_NS);
+
+    // A new command clears the failsafe from the next frame on
+    engine.escControl().submitCommand(uniformCommand(1700));
+    const int64_t commandNs = engine.nowNs();
+    engine.runFor(3 * FRAME_NS);
+    int recovered = 0;
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        if (pulse.riseNs > commandNs) {
+            CHECK_EQ(pulse.widthNs, 1700000);
+            ++recovered;
+        }
+    }
+    CHECK(recovered >= 2 * 4);
+    CHECK(!engine.escControl().isFailsafeActive());
+
+    // And the deadline runs again from that command
+    engine.runFor(TIMEOUT_NS);
+    CHECK(engine.escControl().isFailsafeActive());
+    CHECK_EQ(failsafeCount(engine), 2u);
+}
+
+TEST(failsafeYieldsToCommandAtDeadline)
+{
+    VirtualEngine engine;
+    engine.escControl().setCommandTimeout(int(TIMEOUT_NS / 1000000), FailsafeMode::Jump);
+    CHECK(engine.start());
+
+    // Frame phase from the first pulses
+    engine.runFor(2 * FRAME_NS);
+    std::vector<VirtualEngine::Pulse> pulses = engine.takePulses();
+    CHECK(!pulses.empty());
+    int64_t frameNs = pulses.empty() ? 0 : pulses.back().riseNs;
+
+    // Each round lands the next command on, just before or just after the
+    // frame that sees the deadline
+    const int64_t offsetsNs[] = { -1000, 0, 0, 0, 1000 };
+    uint64_t trips = failsafeCount(engine);
+    for (int round = 0; round < 20; ++round) {
+        while (frameNs - TIMEOUT_NS <= engine.nowNs()) {
+            frameNs += FRAME_NS;
+        }
+        engine.runUntil(frameNs - TIMEOUT_NS);
+        engine.escControl().submitCommand(uniformCommand(1800));
+        const int64_t refreshNs = engine.nowNs();
+
+        engine.runUntil(frameNs + offsetsNs[round % 5]);
+        engine.escControl().submitCommand(uniformCommand(1700));
+        const int64_t commandNs = engine.nowNs();
+        engine.runFor(2 * FRAME_NS);
+
+        // Of the frames after the refresh, at most the one that ran before
+        // the command is neutral, and nothing overrides the command once a
+        // frame has output it
+        bool applied = false;
+        int neutralFrames = 0;
+        for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+            if (pulse.riseNs <= refreshNs) {
+                continue;
+            }
+            if (pulse.widthNs == 1700000) {
+                applied = true;
+            } else if (pulse.widthNs == 1500000) {
+                CHECK(!applied);
+                CHECK(pulse.riseNs <= commandNs);
+                ++neutralFrames;
+            }
+        }
+        CHECK(applied);
+        CHECK(neutralFrames <= 4);
+        CHECK(!engine.escControl().isFailsafeActive());
+
+        const uint64_t count = failsafeCount(engine);
+        CHECK(count - trips <= 1);
+        CHECK_EQ(neutralFrames > 0, count - trips == 1);
+        trips = count;
+        frameNs += TIMEOUT_NS;
+    }
+}
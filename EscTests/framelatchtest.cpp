@@ -0,0 +1,88 @@
+// Frame latch: a 4-channel command switches all outputs in the same PWM frame
+
+#include "esctest.h"
+#include "virtualengine.h"
+#include <map>
+#include <random>
+
+// Command k drives ESC i at 1100 + (k % 8) * 100 + i * 10 μs, so every pulse
+// tells which command it came from
+static int commandWidthUs(int command, int esc)
+{
+    return 1100 + (command % 8) * 100 + esc * 10;
+}
+
+static int escIndex(int pin)
+{
+    const int pins[4] = { ESCControlThread::PIN_ESC_1, ESCControlThread::PIN_ESC_2,
+                          ESCControlThread::PIN_ESC_3, ESCControlThread::PIN_ESC_4 };
+    for (int i = 0; i < 4; ++i) {
+        if (pins[i] == pin) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TEST(frameNeverMixesCommands)
+{
+    VirtualEngine engine;
+    CHECK(engine.start());
+
+    // Commands at random points of the 20ms frame, sometimes several per frame
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int64_t> gap(0, 25000000);
+    std::map<int64_t, std::vector<VirtualEngine::Pulse>> frames;
+    for (int command = 0; command < 400; ++command) {
+        ESCCommandBatch batch;
+        for (int esc = 0; esc < 4; ++esc) {
+            batch.pulseWidth[esc] = PulseWidth::fromUs(commandWidthUs(command, esc));
+        }
+        engine.escControl().submitCommand(batch);
+        engine.runFor(gap(random));
+
+        for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+            frames[pulse.riseNs].push_back(pulse);
+        }
+    }
+    engine.runFor(40000000);
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        frames[pulse.riseNs].push_back(pulse);
+    }
+
+    // Every frame raises all four pins together, and all four widths belong
+    // to the same command
+    int mixedFrames = 0;
+    int incompleteFrames = 0;
+    int switches = 0;
+    int previousStep = -1;
+    for (const auto& frame : frames) {
+        if (frame.second.size() != 4) {
+            ++incompleteFrames;
+            continue;
+        }
+        int step = -1;
+        bool mixed = false;
+        for (const VirtualEngine::Pulse& pulse : frame.second) {
+            const int esc = escIndex(pulse.pin);
+            const int64_t baseUs = pulse.widthNs / 1000 - esc * 10;
+            const int pulseStep = int((baseUs - 1100) / 100);
+            if (esc < 0 || pulse.widthNs != (1100 + pulseStep * 100 + esc * 10) * 1000LL) {
+                mixed = true;
+            }
+            if (step < 0) {
+                step = pulseStep;
+            } else if (pulseStep != step) {
+                mixed = true;
+            }
+        }
+        mixedFrames += mixed;
+        switches += step != previousStep;
+        previousStep = step;
+    }
+
+    CHECK(frames.size() > 240);
+    CHECK(switches > 200);
+    CHECK_EQ(incompleteFrames, 0);
+    CHECK_EQ(mixedFrames, 0);
+}
@@ -0,0 +1,147 @@
+// HardwarePwm and the hardware ESC backend against a fake sysfs tree
+
+#include "esctest.h"
+#include "hardwarepwm.h"
+#include "esccontrol.h"
+#include "virtualclock.h"
+#include <atomic>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <sys/stat.h>
+
+// Temporary pwmchip0 directory with an export attribute, removed on scope exit
+class FakePwmChip
+{
+public:
+    FakePwmChip()
+    {
+        char pattern[] = "/tmp/esctests-pwm-XXXXXX";
+        m_root = mkdtemp(pattern);
+        mkdir(chipPath().c_str(), 0755);
+        touch(chipPath() + "/export");
+    }
+
+    ~FakePwmChip()
+    {
+        std::system(("rm -rf '" + m_root + "'").c_str());
+    }
+
+    const std::string& root() const { return m_root; }
+    std::string chipPath() const { return m_root + "/pwmchip0"; }
+    std::string channelPath(int channel) const { return chipPath() + "/pwm" + std::to_string(channel); }
+
+    // Create the channel directory with its attributes in one step, like
+    // udev does after an export
+    void createChannel(int channel) const
+    {
+        const std::string staging = chipPath() + "/.staging";
+        mkdir(staging.c_str(), 0755);
+        touch(staging + "/period");
+        touch(staging + "/duty_cycle");
+        touch(staging + "/enable");
+        rename(staging.c_str(), channelPath(channel).c_str());
+    }
+
+    // First line of an attribute, "" when it was never written
+    static std::string read(const std::string& path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+
+private:
+    static void touch(const std::string& path) { std::ofstream file(path); }
+
+    std::string m_root;
+};
+
+TEST(hardwarePwmExportsAndProgramsChannel)
+{
+    FakePwmChip chip;
+
+    // The kernel answers an export by creating the channel directory
+    std::atomic<bool> exported(false);
+    std::thread udev([&] {
+        for (int i = 0; i < 200 && FakePwmChip::read(chip.chipPath() + "/export").empty(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        exported = FakePwmChip::read(chip.chipPath() + "/export") == "2";
+        chip.createChannel(2);
+    });
+
+    HardwarePwm pwm(0, 2, chip.root());
+    const bool opened = pwm.open(20000000, 1500000);
+    udev.join();
+
+    CHECK(opened);
+    CHECK(exported.load());
+    CHECK(pwm.isOpen());
+    CHECK(pwm.channelPath() == chip.channelPath(2));
+    CHECK(FakePwmChip::read(chip.channelPath(2) + "/period") == "20000000");
+    CHECK(FakePwmChip::read(chip.channelPath(2) + "/duty_cycle") == "1500000");
+    CHECK(FakePwmChip::read(chip.channelPath(2) + "/enable") == "1");
+
+    CHECK(pwm.setDutyCycle(1250000));
+    CHECK(FakePwmChip::read(chip.channelPath(2) + "/duty_cycle") == "1250000");
+
+    pwm.close();
+    CHECK(!pwm.isOpen());
+    CHECK(FakePwmChip::read(chip.channelPath(2) + "/enable") == "0");
+    CHECK(!pwm.setDutyCycle(1000000));
+}
+
+TEST(hardwarePwmSkipsExportOfExistingChannel)
+{
+    FakePwmChip chip;
+    chip.createChannel(1);
+
+    HardwarePwm pwm(0, 1, chip.root());
+    CHECK(pwm.open(2000000, 187500));
+    CHECK(FakePwmChip::read(chip.chipPath() + "/export").empty());
+    CHECK(FakePwmChip::read(chip.channelPath(1) + "/period") == "2000000");
+    CHECK(FakePwmChip::read(chip.channelPath(1) + "/duty_cycle") == "187500");
+}
+
+TEST(hardwarePwmFailsWithoutChip)
+{
+    FakePwmChip chip;
+    HardwarePwm pwm(1, 0, chip.root());
+    CHECK(!pwm.open(20000000, 1500000));
+    CHECK(!pwm.isOpen());
+}
+
+TEST(escControlHardwareBackendUsesSysfsRoot)
+{
+    FakePwmChip chip;
+    chip.createChannel(HardwarePwm::channelForGpio(18));
+
+    // initialize() and stop() wait for the ESC on the clock
+    VirtualClock clock;
+    Clock::setInstance(&clock);
+    {
+        ClockThread attach;
+
+        ESCControl esc(18, PwmBackend::Hardware);
+        esc.setHardwarePwmRoot(chip.root());
+        CHECK(esc.initialize());
+        CHECK(esc.getBackend() == PwmBackend::Hardware);
+
+        const std::string channel = chip.channelPath(HardwarePwm::channelForGpio(18));
+        CHECK(FakePwmChip::read(channel + "/period") == "20000000");
+        CHECK(FakePwmChip::read(channel + "/duty_cycle") == "1500000");
+        CHECK(FakePwmChip::read(channel + "/enable") == "1");
+
+        esc.setPulseWidth(1800, true);
+        CHECK(FakePwmChip::read(channel + "/duty_cycle") == "1800000");
+
+        esc.stop();
+        CHECK(FakePwmChip::read(channel + "/duty_cycle") == "1500000");
+        CHECK(FakePwmChip::read(channel + "/enable") == "0");
+    }
+    Clock::setInstance(nullptr);
+}
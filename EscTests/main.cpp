@@ -0,0 +1,53 @@
+// Unit tests for the ESC engine, run with `make check` or directly:
+//
+//   EscTests [<name filter>]
+//
+// Prints one line per test case and exits with the number of failed cases.
+
+#include "esctest.h"
+#include "logger.h"
+#include <cstring>
+
+static int g_failures = 0;
+
+std::vector<EscTestCase>& escTestCases()
+{
+    static std::vector<EscTestCase> cases;
+    return cases;
+}
+
+void escTestFail(const char* file, int line, const std::string& message)
+{
+    fprintf(stderr, "  %s:%d: %s\n", file, line, message.c_str());
+    ++g_failures;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    // Engine log only for failures worth reading
+    Logger::getInstance()->setOutput(stderr);
+    Logger::getInstance()->setLevel(LogLevel::Error);
+
+    int run = 0;
+    int failed = 0;
+    for (const EscTestCase& test : escTestCases()) {
+        if (filter && !strstr(test.name, filter)) {
+            continue;
+        }
+        const int failuresBefore = g_failures;
+        test.run();
+        ++run;
+        if (g_failures != failuresBefore) {
+            ++failed;
+            printf("FAIL %s\n", test.name);
+        } else {
+            printf("PASS %s\n", test.name);
+        }
+        fflush(stdout);
+    }
+
+    printf("%d of %d test cases passed\n", run - failed, run);
+    return failed;
+}
@@ -0,0 +1,155 @@
+// MessageDecoder on randomly fragmented streams with noise and corrupt frames
+
+#include "esctest.h"
+#include "message.h"
+#include <random>
+
+typedef std::vector<uint8_t> Bytes;
+
+// Random frame: mostly 8-byte setpoint payloads, sometimes any length
+static Bytes randomFrame(std::mt19937& random)
+{
+    static Message message;
+    QByteArray data;
+    const int size = random() % 3 ? 8 : int(random() % (MaxLen + 1));
+    for (int i = 0; i < size; ++i) {
+        data.append(char(random()));
+    }
+    uint8_t buffer[MessageDecoder::MaxFrame];
+    const int frameSize = message.create_pack(random() % 2 ? mWrite : mRead, mSERVO1 + random() % 5, data, buffer);
+    return Bytes(buffer, buffer + frameSize);
+}
+
+TEST(messageDecoderRandomFragmentation)
+{
+    std::mt19937 random(1);
+    int corrupted = 0;
+    for (int trial = 0; trial < 2000; ++trial) {
+        // Good frames, and on odd trials noise without header bytes and
+        // frames with one flipped bit (header byte excluded)
+        const bool corrupt = trial % 2;
+        Bytes stream;
+        std::vector<Bytes> sent;
+        std::vector<size_t> sentEnd;
+        const int frames = 1 + random() % 50;
+        for (int i = 0; i < frames; ++i) {
+            if (corrupt && random() % 4 == 0) {
+                for (int noise = 1 + random() % 5; noise > 0; --noise) {
+                    const uint8_t byte = uint8_t(random());
+                    stream.push_back(byte == mHeader ? 0 : byte);
+                }
+            }
+            Bytes frame = randomFrame(random);
+            if (corrupt && random() % 6 == 0) {
+                frame[1 + random() % (frame.size() - 1)] ^= uint8_t(1u << (random() % 8));
+                ++corrupted;
+            } else {
+                sent.push_back(frame);
+                sentEnd.push_back(stream.size() + frame.size());
+            }
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+
+        // Chunks of 1-5 or 1-600 bytes; every good frame has to come out of
+        // the chunk that completes it, none waits for a later write
+        MessageDecoder decoder;
+        std::vector<Bytes> received;
+        size_t pos = 0;
+        bool late = false;
+        bool badView = false;
+        while (pos < stream.size()) {
+            const size_t chunk = std::min<size_t>(1 + random() % (random() % 2 ? 5 : 600), stream.size() - pos);
+            const Bytes bytes(stream.begin() + pos, stream.begin() + pos + chunk);
+            pos += chunk;
+
+            decoder.feed(bytes.data(), int(bytes.size()));
+            MessageView view;
+            const uint8_t *frame;
+            int frameSize;
+            while (decoder.next(&view, &frame, &frameSize)) {
+                received.push_back(Bytes(frame, frame + frameSize));
+                badView |= view.data != frame + 4 || view.len + 4 + CrcSize != frameSize;
+            }
+            late |= received.size() < sent.size() && sentEnd[received.size()] <= pos;
+        }
+
+        CHECK(received == sent);
+        CHECK(!late);
+        CHECK(!badView);
+        if (received != sent || late || badView) {
+            fprintf(stderr, "  trial %d: %zu frames sent, %zu received\n", trial, sent.size(), received.size());
+            return;
+        }
+    }
+    CHECK(corrupted > 1000);
+}
+
+TEST(messageDecoderCorruptLengthCostsOneFrame)
+{
+    // Eight setpoint frames; frame 3 gets every other length byte in turn
+    std::mt19937 random(7);
+    Message message;
+    std::vector<Bytes> frames;
+    for (int i = 0; i < 8; ++i) {
+        QByteArray data;
+        for (int k = 0; k < 8; ++k) {
+            data.append(char(random()));
+        }
+        uint8_t buffer[MessageDecoder::MaxFrame];
+        const int frameSize = message.create_pack(mWrite, mSERVO1, data, buffer);
+        frames.push_back(Bytes(buffer, buffer + frameSize));
+    }
+    const int damaged = 3;
+
+    const int chunkSizes[] = { 1, 7, int(frames[0].size()), 1000 };
+    int failures = 0;
+    for (int length = 0; length <= MaxLen; ++length) {
+        if (length == frames[damaged][1]) {
+            continue;
+        }
+        Bytes stream;
+        std::vector<size_t> frameEnd;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            stream.insert(stream.end(), frames[i].begin(), frames[i].end());
+            if (i == size_t(damaged)) {
+                stream[stream.size() - frames[i].size() + 1] = uint8_t(length);
+            }
+            frameEnd.push_back(stream.size());
+        }
+
+        // Every other frame comes out, each from the write that completes it
+        for (int chunkSize : chunkSizes) {
+            MessageDecoder decoder;
+            std::vector<Bytes> received;
+            bool late = false;
+            for (size_t pos = 0; pos < stream.size(); ) {
+                const size_t chunk = std::min<size_t>(chunkSize, stream.size() - pos);
+                decoder.feed(stream.data() + pos, int(chunk));
+                pos += chunk;
+
+                MessageView view;
+                const uint8_t *frame;
+                int frameSize;
+                while (decoder.next(&view, &frame, &frameSize)) {
+                    received.push_back(Bytes(frame, frame + frameSize));
+                }
+                size_t due = 0;
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    due += int(i) != damaged && frameEnd[i] <= pos;
+                }
+                late |= received.size() < due;
+            }
+
+            std::vector<Bytes> expected = frames;
+            expected.erase(expected.begin() + damaged);
+            if (received != expected || late || decoder.getCorruptFrames() == 0) {
+                if (++failures <= 3) {
+                    fprintf(stderr, "  length %d, %d byte writes: %zu frames, late %d, %llu corrupt\n", length,
+                            chunkSize, received.size(), int(late),
+                            (unsigned long long)decoder.getCorruptFrames());
+                }
+            }
+        }
+    }
+    CHECK_EQ(failures, 0);
+}
@@ -0,0 +1,83 @@
+// Packed and delta setpoint payloads: round trip, delta range and base check
+
+#include "esctest.h"
+#include "message.h"
+
+TEST(packedSetpointsRoundTrip)
+{
+    // Every value on every channel, the others at different values so a
+    // nibble ending up in the wrong channel shows
+    for (int value = 0; value <= PackedMax; ++value) {
+        const uint16_t setpoints[4] = { uint16_t(value), uint16_t(PackedMax - value),
+                                        uint16_t((value * 7) & PackedMax), uint16_t((value + 2048) & PackedMax) };
+        uint8_t packed[PackedSize];
+        Message::packSetpoints(setpoints, packed);
+        uint16_t unpacked[4] = {};
+        Message::unpackSetpoints(packed, unpacked);
+        for (int i = 0; i < 4; ++i) {
+            CHECK_EQ(unpacked[i], setpoints[i]);
+        }
+    }
+}
+
+TEST(deltaSetpointsRangeAndBase)
+{
+    const uint16_t base[4] = { 1000, 2000, 3000, 3900 };
+    uint8_t delta[DeltaSize];
+
+    // Steps of up to 127 either way on any channel round trip, one more is refused
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int step : { -127, -1, 0, 1, 127 }) {
+            uint16_t setpoints[4] = { base[0], base[1], base[2], base[3] };
+            setpoints[channel] = uint16_t(base[channel] + step);
+            CHECK(Message::packDelta(base, setpoints, delta));
+            uint16_t unpacked[4] = {};
+            CHECK(Message::unpackDelta(base, delta, unpacked));
+            for (int i = 0; i < 4; ++i) {
+                CHECK_EQ(unpacked[i], setpoints[i]);
+            }
+        }
+        for (int step : { -128, 128, -1000, 1000 }) {
+            uint16_t setpoints[4] = { base[0], base[1], base[2], base[3] };
+            setpoints[channel] = uint16_t(base[channel] + step);
+            CHECK(!Message::packDelta(base, setpoints, delta));
+        }
+    }
+
+    // A delta against other setpoints than the receiver's (a lost frame) is
+    // rejected and leaves the output alone
+    const uint16_t setpoints[4] = { 1010, 1990, 3000, 3901 };
+    CHECK(Message::packDelta(base, setpoints, delta));
+    for (int channel = 0; channel < 4; ++channel) {
+        for (int change : { -1, 1, 100 }) {
+            uint16_t otherBase[4] = { base[0], base[1], base[2], base[3] };
+            otherBase[channel] = uint16_t(base[channel] + change);
+            uint16_t unpacked[4] = { 1, 2, 3, 4 };
+            CHECK(!Message::unpackDelta(otherBase, delta, unpacked));
+            CHECK(unpacked[0] == 1 && unpacked[1] == 2 && unpacked[2] == 3 && unpacked[3] == 4);
+        }
+    }
+
+    // Results outside 0-PackedMax are rejected, with a valid check byte
+    const uint16_t edges[4] = { 0, PackedMax, 5, PackedMax - 5 };
+    const int8_t outOfRange[4][4] = { { -1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, -6, 0 }, { 0, 0, 0, 127 } };
+    for (const int8_t (&steps)[4] : outOfRange) {
+        CHECK(Message::packDelta(edges, edges, delta));
+        for (int i = 0; i < 4; ++i) {
+            delta[i] = uint8_t(steps[i]);
+        }
+        uint16_t unpacked[4] = { 1, 2, 3, 4 };
+        CHECK(!Message::unpackDelta(edges, delta, unpacked));
+        CHECK(unpacked[0] == 1 && unpacked[1] == 2 && unpacked[2] == 3 && unpacked[3] == 4);
+    }
+
+    // The same steps inside the range still apply
+    const int8_t inRange[4] = { 1, -1, -5, 5 };
+    CHECK(Message::packDelta(edges, edges, delta));
+    for (int i = 0; i < 4; ++i) {
+        delta[i] = uint8_t(inRange[i]);
+    }
+    uint16_t unpacked[4] = {};
+    CHECK(Message::unpackDelta(edges, delta, unpacked));
+    CHECK(unpacked[0] == 1 && unpacked[1] == PackedMax - 1 && unpacked[2] == 0 && unpacked[3] == PackedMax);
+}
@@ -0,0 +1,33 @@
+// SleepEstimator margin adaptation and its spin time accounting
+
+#include "esctest.h"
+#include "sleepestimator.h"
+
+TEST(sleepEstimatorCreditsOnlyWaitsThatSlept)
+{
+    // Calibrated at 50μs, steady 5μs wake-ups bring the margin down
+    SleepEstimator estimator(50000);
+    for (int i = 0; i < 200; ++i) {
+        estimator.addSample(5000);
+    }
+    const int64_t marginNs = estimator.spinMarginNs();
+    CHECK(marginNs < 50000);
+    estimator.resetMetrics();
+
+    // No sleep: the whole wait was spinning, nothing saved
+    estimator.addSpinTime(80000, 0);
+    CHECK_EQ(estimator.getSpinTimeNs(), 80000u);
+    CHECK_EQ(estimator.getSpinTimeSavedNs(), 0u);
+
+    // Slept with the adaptive margin and spun its remainder
+    estimator.addSpinTime(marginNs - 5000, marginNs);
+    CHECK_EQ(estimator.getSpinTimeSavedNs(), uint64_t(50000 - marginNs));
+
+    // Slept, but a late wake-up left more spinning: credit only the difference
+    // to the static margin, none once it spun longer than that
+    estimator.resetMetrics();
+    estimator.addSpinTime(45000, marginNs);
+    CHECK_EQ(estimator.getSpinTimeSavedNs(), 5000u);
+    estimator.addSpinTime(60000, marginNs);
+    CHECK_EQ(estimator.getSpinTimeSavedNs(), 5000u);
+}
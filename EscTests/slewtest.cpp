@@ -0,0 +1,89 @@
+// Slew-limited ramps in simulated time: per-frame step and emergency stop
+
+#include "esctest.h"
+#include "virtualengine.h"
+#include <map>
+
+static const int64_t FRAME_NS = 20000000;
+static const int SLEW_US_PER_S = 2000;
+static const int64_t STEP_NS = SLEW_US_PER_S * (FRAME_NS / 1000000);    // 40μs per frame
+static const int64_t TICK_NS = (1000 + PulseWidth::TICKS_PER_US - 1) / PulseWidth::TICKS_PER_US;
+
+static ESCCommandBatch uniformCommand(int pulseWidthUs)
+{
+    ESCCommandBatch batch;
+    for (PulseWidth& pulseWidth : batch.pulseWidth) {
+        pulseWidth = PulseWidth::fromUs(pulseWidthUs);
+    }
+    return batch;
+}
+
+// Pulse widths per pin in frame order
+static std::map<int, std::vector<int64_t>> widthsByPin(const std::vector<VirtualEngine::Pulse>& pulses)
+{
+    std::map<int, std::vector<int64_t>> widths;
+    for (const VirtualEngine::Pulse& pulse : pulses) {
+        widths[pulse.pin].push_back(pulse.widthNs);
+    }
+    return widths;
+}
+
+TEST(slewRampStepsAtRateAndEmergencyStopSkipsIt)
+{
+    VirtualEngine engine;
+    engine.escControl().setAllSlewRate(SLEW_US_PER_S);
+    CHECK(engine.start());
+
+    // Settle at 1000μs (the ramp down from neutral takes 250ms)
+    engine.escControl().submitCommand(uniformCommand(1000));
+    engine.runFor(25 * FRAME_NS);
+    std::map<int, std::vector<int64_t>> settled = widthsByPin(engine.takePulses());
+    CHECK_EQ(settled.size(), size_t(4));
+
+    // Step to 2000μs: every frame moves 40μs within one 1/16μs tick until
+    // the last one lands exactly on the target
+    engine.escControl().submitCommand(uniformCommand(2000));
+    engine.runFor(30 * FRAME_NS);
+    std::map<int, std::vector<int64_t>> ramp = widthsByPin(engine.takePulses());
+    for (auto& pin : settled) {
+        CHECK(!pin.second.empty());
+        int64_t previousNs = pin.second.empty() ? 0 : pin.second.back();
+        CHECK_EQ(previousNs, 1000000);
+
+        int steps = 0;
+        for (int64_t widthNs : ramp[pin.first]) {
+            if (previousNs == 2000000) {
+                CHECK_EQ(widthNs, 2000000);
+            } else if (widthNs == 2000000) {
+                CHECK(widthNs - previousNs <= STEP_NS + TICK_NS);
+                ++steps;
+            } else {
+                CHECK_NEAR(widthNs - previousNs, STEP_NS, TICK_NS);
+                ++steps;
+            }
+            previousNs = widthNs;
+        }
+        CHECK_EQ(previousNs, 2000000);
+        CHECK(steps >= 25 && steps <= 26);
+    }
+
+    // Emergency stop in the middle of the ramp back down: the next frame is
+    // exactly neutral on every pin, and stays there
+    engine.escControl().submitCommand(uniformCommand(1000));
+    engine.runFor(10 * FRAME_NS + 7000000);
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        CHECK(pulse.widthNs > 1000000 && pulse.widthNs <= 2000000);
+    }
+    engine.escControl().emergencyStop();
+    const int64_t stopNs = engine.nowNs();
+    engine.runFor(3 * FRAME_NS);
+
+    int neutral = 0;
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        if (pulse.riseNs > stopNs) {
+            CHECK_EQ(pulse.widthNs, 1500000);
+            ++neutral;
+        }
+    }
+    CHECK_EQ(neutral, 3 * 4);
+}
@@ -0,0 +1,70 @@
+// Trajectory playback against the command-timeout failsafe: only received
+// batches keep the link alive, not the points they queue
+
+#include "esctest.h"
+#include "virtualengine.h"
+
+static const int64_t FRAME_NS = 20000000;
+static const int64_t TIMEOUT_NS = 100000000;
+static const int64_t DEPTH_NS = 40000000;
+
+// count points from senderNowNs on, one per frame, all ESCs at pulseWidthUs
+static void sendBatch(VirtualEngine& engine, int64_t senderNowNs, int count, int pulseWidthUs)
+{
+    std::vector<TrajectoryPoint> points(count);
+    for (int i = 0; i < count; ++i) {
+        points[i].timeNs = senderNowNs + i * FRAME_NS;
+        for (PulseWidth& pulseWidth : points[i].pulseWidth) {
+            pulseWidth = PulseWidth::fromUs(pulseWidthUs);
+        }
+    }
+    CHECK_EQ(engine.escControl().submitTrajectory(senderNowNs, points.data(), count), count);
+}
+
+TEST(trajectoryPointsDoNotRefreshLinkLoss)
+{
+    VirtualEngine engine;
+    engine.escControl().setCommandTimeout(int(TIMEOUT_NS / 1000000), FailsafeMode::Jump);
+    engine.escControl().setTrajectoryDepth(int(DEPTH_NS / 1000000));
+    CHECK(engine.start());
+
+    // One batch covering a second, then silence: the points play until the
+    // deadline of the batch, after that the outputs stay neutral although
+    // points are still queued
+    const int64_t senderBaseNs = engine.nowNs();
+    sendBatch(engine, 0, 50, 1600);
+    const int64_t deadlineNs = engine.nowNs() + TIMEOUT_NS;
+    engine.runFor(5 * TIMEOUT_NS);
+
+    int played = 0;
+    int neutral = 0;
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        if (pulse.riseNs > senderBaseNs + DEPTH_NS && pulse.riseNs < deadlineNs) {
+            CHECK_EQ(pulse.widthNs, 1600000);
+            ++played;
+        } else if (pulse.riseNs >= deadlineNs) {
+            CHECK_EQ(pulse.widthNs, 1500000);
+            ++neutral;
+        }
+    }
+    CHECK(played >= 2 * 4);
+    CHECK(neutral >= 20 * 4);
+    CHECK(engine.escControl().isFailsafeActive());
+    CHECK_EQ(engine.escControl().getTimingReport().failsafeCount, 1u);
+    int64_t leadNs = 0;
+    CHECK(engine.escControl().getQueuedTrajectoryPoints(&leadNs) > 0);
+
+    // The next received batch takes the outputs back
+    const int64_t arrivalNs = engine.nowNs();
+    sendBatch(engine, arrivalNs - senderBaseNs, 10, 1700);
+    engine.runFor(DEPTH_NS + 3 * FRAME_NS);
+    int recovered = 0;
+    for (const VirtualEngine::Pulse& pulse : engine.takePulses()) {
+        if (pulse.riseNs > arrivalNs + DEPTH_NS) {
+            CHECK_EQ(pulse.widthNs, 1700000);
+            ++recovered;
+        }
+    }
+    CHECK(recovered >= 2 * 4);
+    CHECK(!engine.escControl().isFailsafeActive());
+}
@@ -0,0 +1,58 @@
+// Exact edge trace of the PWM engine in simulated time
+
+#include "esctest.h"
+#include "virtualengine.h"
+
+static const int64_t FRAME_NS = 20000000;
+
+TEST(virtualClockGivesExactEdges)
+{
+    VirtualEngine engine;
+    CHECK(engine.start());
+
+    // Frame phase from the first complete frame
+    engine.runFor(2 * FRAME_NS);
+    std::vector<VirtualEngine::Pulse> pulses = engine.takePulses();
+    CHECK(pulses.size() >= 4);
+    if (pulses.empty()) {
+        return;
+    }
+    const int64_t phaseNs = pulses.back().riseNs;
+
+    // Each command lands 7ms into a frame and holds for three frames; ESC i
+    // gets 1100 + step * 100 + i * 25 μs
+    const int steps = 6;
+    for (int step = 0; step < steps; ++step) {
+        engine.runUntil(phaseNs + (3 * step + 1) * FRAME_NS + 7000000);
+        ESCCommandBatch batch;
+        for (int i = 0; i < 4; ++i) {
+            batch.pulseWidth[i] = PulseWidth::fromUs(1100 + step * 100 + i * 25);
+        }
+        engine.escControl().submitCommand(batch);
+    }
+    engine.runUntil(phaseNs + (3 * steps + 1) * FRAME_NS + 7000000);
+
+    // Frame k rises exactly at phase + k * 20ms on all four pins and falls
+    // exactly one pulse width later; the command sent in frame 3 * step + 1
+    // shows from frame 3 * step + 2 on
+    const int pins[4] = { ESCControlThread::PIN_ESC_1, ESCControlThread::PIN_ESC_2,
+                          ESCControlThread::PIN_ESC_3, ESCControlThread::PIN_ESC_4 };
+    pulses = engine.takePulses();
+    CHECK_EQ(pulses.size(), size_t(4 * (3 * steps + 1)));
+    for (size_t n = 0; n < pulses.size(); ++n) {
+        const VirtualEngine::Pulse& pulse = pulses[n];
+        const int64_t frame = (pulse.riseNs - phaseNs) / FRAME_NS;
+        CHECK_EQ(pulse.riseNs, phaseNs + frame * FRAME_NS);
+
+        int esc = -1;
+        for (int i = 0; i < 4; ++i) {
+            esc = pins[i] == pulse.pin ? i : esc;
+        }
+        CHECK(esc >= 0);
+
+        const int step = frame < 2 ? -1 : int((frame - 2) / 3);
+        const int64_t expectedUs = step < 0 ? 1500 : 1100 + step * 100 + esc * 25;
+        CHECK_EQ(pulse.widthNs, expectedUs * 1000);
+        CHECK_EQ(pulse.riseNs + pulse.widthNs, phaseNs + frame * FRAME_NS + expectedUs * 1000);
+    }
+}
@@ -0,0 +1,55 @@
+#include "virtualengine.h"
+#include <algorithm>
+
+static VirtualGpio* selectVirtualGpio()
+{
+    GpioHal::select(GpioBackendType::Virtual);
+    return static_cast<VirtualGpio*>(GpioHal::getInstance());
+}
+
+VirtualEngine::VirtualEngine()
+    : m_clock(true, 1000000000LL)
+    , m_gpio(selectVirtualGpio())
+    , m_lastRiseNs{}
+{
+    Clock::setInstance(&m_clock);
+    m_attached = std::make_unique<ClockThread>();
+}
+
+VirtualEngine::~VirtualEngine()
+{
+    // Time runs free while the engine shuts down
+    m_attached.reset();
+    m_escControl.stop();
+    m_gpio->takeEdges();
+    Clock::setInstance(nullptr);
+}
+
+bool VirtualEngine::start()
+{
+    if (!m_escControl.initialize()) {
+        return false;
+    }
+    m_gpio->takeEdges();
+    std::fill(m_lastRiseNs, m_lastRiseNs + VirtualGpio::MAX_PINS, 0);
+    return true;
+}
+
+std::vector<VirtualEngine::Pulse> VirtualEngine::takePulses()
+{
+    std::vector<Pulse> pulses;
+    for (const GpioEdge& edge : m_gpio->takeEdges()) {
+        if (edge.pin < 0 || edge.pin >= VirtualGpio::MAX_PINS) {
+            continue;
+        }
+        if (edge.level) {
+            m_lastRiseNs[edge.pin] = edge.timeNs;
+        } else if (m_lastRiseNs[edge.pin] != 0) {
+            pulses.push_back({ edge.pin, m_lastRiseNs[edge.pin], edge.timeNs - m_lastRiseNs[edge.pin] });
+            m_lastRiseNs[edge.pin] = 0;
+        }
+    }
+    std::stable_sort(pulses.begin(), pulses.end(),
+                     [](const Pulse& a, const Pulse& b) { return a.riseNs < b.riseNs; });
+    return pulses;
+}
@@ -0,0 +1,48 @@
+#ifndef VIRTUALENGINE_H
+#define VIRTUALENGINE_H
+
+#include "esccontrolthread.h"
+#include "virtualgpio.h"
+#include "virtualclock.h"
+#include <memory>
+#include <vector>
+
+// ESCControlThread on the virtual GPIO backend in simulated time. The test
+// thread is attached to the VirtualClock, so time only moves while it sleeps
+// (runFor) and the edge trace is exact. Configure escControl() between
+// construction and start().
+class VirtualEngine
+{
+public:
+    // One output pulse: rising edge time and high time
+    struct Pulse {
+        int pin;
+        int64_t riseNs;
+        int64_t widthNs;
+    };
+
+    VirtualEngine();
+    ~VirtualEngine();
+
+    bool start();
+
+    ESCControlThread& escControl() { return m_escControl; }
+    VirtualClock& clock() { return m_clock; }
+    int64_t nowNs() { return m_clock.nowNs(); }
+
+    // Let simulated time pass, the engine runs meanwhile
+    void runFor(int64_t durationNs) { m_clock.sleepForNs(durationNs); }
+    void runUntil(int64_t timeNs) { m_clock.sleepUntilNs(timeNs); }
+
+    // Complete pulses since the last call, in rising edge order
+    std::vector<Pulse> takePulses();
+
+private:
+    VirtualClock m_clock;
+    VirtualGpio* m_gpio;
+    std::unique_ptr<ClockThread> m_attached;
+    ESCControlThread m_escControl;
+    int64_t m_lastRiseNs[VirtualGpio::MAX_PINS];
+};
+
+#endif // VIRTUALENGINE_H
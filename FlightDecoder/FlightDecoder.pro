@@ -0,0 +1,17 @@
+# Flight recorder decoder, turns a --flight-recorder file into CSV.
+# Builds without Qt libraries and without the ESC engine.
+QT -= core gui
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = FlightDecoder
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    ../flightrecorder.h \
+    ../pulsewidth.h
@@ -0,0 +1,165 @@
+// Flight recorder decoder: prints the records of a --flight-recorder file as
+// CSV, oldest first. The file may come from a process that crashed, torn or
+// half-written records are skipped.
+//
+//   FlightDecoder <file> [--output=<csv>] [--frames=0] [--commands=0]
+//
+// Columns: sequence, time_s (monotonic), type (session/command/frame),
+// armed, failsafe, parse_error, jitter_us, esc1_us..esc4_us (commanded
+// widths for commands, committed outputs for frames), packet (hex), info.
+
+#include "flightrecorder.h"
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char* typeName(FlightRecordType type)
+{
+    switch (type) {
+    case FlightRecordType::Session: return "session";
+    case FlightRecordType::Command: return "command";
+    case FlightRecordType::Frame: return "frame";
+    }
+    return "unknown";
+}
+
+static void writeRecord(std::ostream& out, const FlightRecord& record, uint64_t sequence)
+{
+    char line[256];
+    int n = snprintf(line, sizeof(line), "%llu,%.6f,%s,%d,%d,%d,%.3f",
+                     (unsigned long long)sequence, record.timeNs / 1e9, typeName(record.type),
+                     (record.flags & FlightRecord::Armed) ? 1 : 0,
+                     (record.flags & FlightRecord::Failsafe) ? 1 : 0,
+                     (record.flags & FlightRecord::ParseError) ? 1 : 0,
+                     record.jitterNs / 1000.0);
+    out.write(line, n);
+
+    for (int i = 0; i < 4; ++i) {
+        if (record.pulseTicks[i]) {
+            n = snprintf(line, sizeof(line), ",%.4f", double(record.pulseTicks[i]) / PulseWidth::TICKS_PER_US);
+            out.write(line, n);
+        } else {
+            out << ',';
+        }
+    }
+
+    out << ',';
+    const size_t packetSize = std::min<size_t>(record.packetSize, FlightRecord::PACKET_SIZE);
+    if (record.type != FlightRecordType::Session) {
+        for (size_t i = 0; i < packetSize; ++i) {
+            n = snprintf(line, sizeof(line), "%02x", record.packet[i]);
+            out.write(line, n);
+        }
+    }
+
+    out << ',';
+    if (record.type == FlightRecordType::Session && packetSize >= sizeof(int64_t)) {
+        int64_t wallNs;
+        memcpy(&wallNs, record.packet, sizeof(wallNs));
+        time_t seconds = time_t(wallNs / 1000000000LL);
+        struct tm utc;
+        gmtime_r(&seconds, &utc);
+        strftime(line, sizeof(line), "started %Y-%m-%dT%H:%M:%SZ", &utc);
+        out << line;
+    }
+    out << '\n';
+}
+
+int main(int argc, char* argv[])
+{
+    const char* path = nullptr;
+    std::string outputPath;
+    bool frames = true;
+    bool commands = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--output=", 9) == 0) {
+            outputPath = argv[i] + 9;
+        } else if (strcmp(argv[i], "--frames=0") == 0) {
+            frames = false;
+        } else if (strcmp(argv[i], "--commands=0") == 0) {
+            commands = false;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (!path) {
+        std::cerr << "Usage: " << argv[0] << " <file> [--output=<csv>] [--frames=0] [--commands=0]" << std::endl;
+        return 1;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(FlightRecorderHeader)) {
+        std::cerr << "Cannot read " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    void* mapping = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    const FlightRecorderHeader* header = static_cast<const FlightRecorderHeader*>(mapping);
+    if (memcmp(header->magic, FlightRecorderHeader::MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != FlightRecorderHeader::VERSION ||
+        header->recordSize != sizeof(FlightRecord) ||
+        sizeof(FlightRecorderHeader) + header->capacity * sizeof(FlightRecord) > size_t(st.st_size)) {
+        std::cerr << path << " is not a flight recorder file (version " << FlightRecorderHeader::VERSION << ")" << std::endl;
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty()) {
+        file.open(outputPath);
+        if (!file) {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = outputPath.empty() ? std::cout : file;
+
+    const FlightRecord* records = reinterpret_cast<const FlightRecord*>(header + 1);
+    const uint64_t capacity = header->capacity;
+    const uint64_t end = header->writeIndex.load(std::memory_order_acquire);
+    const uint64_t begin = end > capacity ? end - capacity : 0;
+
+    out << "sequence,time_s,type,armed,failsafe,parse_error,jitter_us,esc1_us,esc2_us,esc3_us,esc4_us,packet,info\n";
+    uint64_t written = 0;
+    uint64_t torn = 0;
+    for (uint64_t position = begin; position < end; ++position) {
+        const FlightRecord& slot = records[position % capacity];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+            ++torn;
+            continue;
+        }
+        FlightRecord record;
+        memcpy(static_cast<void*>(&record), &slot, sizeof(record));
+        if ((record.type == FlightRecordType::Frame && !frames) ||
+            (record.type == FlightRecordType::Command && !commands)) {
+            continue;
+        }
+        writeRecord(out, record, position + 1);
+        ++written;
+    }
+
+    std::cerr << written << " records";
+    if (torn) {
+        std::cerr << ", " << torn << " incomplete or overwritten skipped";
+    }
+    std::cerr << std::endl;
+
+    munmap(mapping, size_t(st.st_size));
+    return 0;
+}
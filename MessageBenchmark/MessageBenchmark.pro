@@ -0,0 +1,18 @@
+# BLE message parser benchmark, copying MessagePack parser vs MessageView.
+QT += core
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = MessageBenchmark
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../message.cpp
+
+HEADERS += \
+    ../message.h
@@ -0,0 +1,274 @@
+// Message parser benchmark: parses the same BLE packet in a loop with the
+// copying MessagePack parser (alone and with the old client-side copy into
+// a QByteArray) and with the zero-copy MessageView parser, then prints one
+// JSON object with messages/second per parser.
+//
+//   MessageBenchmark [--iterations=<n>] [--payload=<bytes>] [--chunk=<bytes>]
+//                    [--rate=<Hz>] [--label=<text>]
+//
+// bytes_touched is what one parse reads from the packet plus what it writes
+// to its result; result_size is the size of the result object. Every parser
+// includes the CRC check, crc reports the CRC-16 alone.
+//
+// The stream pass runs MessageDecoder over a stream of such packets cut
+// into random chunks of 1..--chunk bytes (default 20, fixed seed) with a
+// few noise bytes between packets and one bit flipped in every 16th packet,
+// and checks that exactly the intact packets come out.
+//
+// The setpoints pass times encoding and decoding a four channel command as
+// the legacy 4 x 16 bit payload, as a packed 12 bit frame and as a delta
+// frame, and lists the frame sizes and the write + ack bytes per second at
+// --rate commands per second (default 50) for each, with and without the
+// 7 bytes of ATT and L2CAP header per BLE write or notification.
+
+#include "message.h"
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <time.h>
+
+struct ParserResult {
+    const char* name;
+    double nsPerMessage;
+    uint64_t bytesTouched;
+    uint64_t resultSize;
+};
+
+static int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Keeps the compiler from dropping a result that is never read
+static inline void escape(const void* pointer)
+{
+    asm volatile("" : : "g"(pointer) : "memory");
+}
+
+template <typename ParseFn>
+static double measure(uint64_t iterations, ParseFn parse)
+{
+    // Warm up caches and branch predictors
+    for (uint64_t i = 0; i < iterations / 10; ++i) {
+        parse();
+    }
+    const int64_t startNs = monotonicNs();
+    for (uint64_t i = 0; i < iterations; ++i) {
+        parse();
+    }
+    return double(monotonicNs() - startNs) / iterations;
+}
+
+int main(int argc, char* argv[])
+{
+    uint64_t iterations = 10000000;
+    int payloadSize = 8;
+    int maxChunk = 20;
+    int rate = 50;
+    std::string label;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--iterations=", 13) == 0) {
+            iterations = strtoull(argv[i] + 13, nullptr, 10);
+        } else if (strncmp(argv[i], "--payload=", 10) == 0) {
+            payloadSize = atoi(argv[i] + 10);
+        } else if (strncmp(argv[i], "--chunk=", 8) == 0) {
+            maxChunk = atoi(argv[i] + 8);
+        } else if (strncmp(argv[i], "--rate=", 7) == 0) {
+            rate = atoi(argv[i] + 7);
+        } else if (strncmp(argv[i], "--label=", 8) == 0) {
+            label = argv[i] + 8;
+        } else {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (iterations == 0 || payloadSize < 0 || payloadSize > MaxLen || maxChunk < 1 || rate < 1) {
+        std::cerr << "--iterations, --chunk and --rate must be positive, --payload 0-" << MaxLen << std::endl;
+        return 1;
+    }
+
+    // A servo command by default: 4 little-endian pulse widths
+    Message message;
+    QByteArray payload;
+    for (int i = 0; i < payloadSize; ++i) {
+        payload.append(char(i % 2 ? 0x05 : 0xdc));
+    }
+    uint8_t packet[MessageDecoder::MaxFrame];
+    const int packetSize = message.create_pack(mWrite, mSERVO1, payload, packet);
+
+    ParserResult results[3];
+
+    results[0].name = "pack";
+    results[0].nsPerMessage = measure(iterations, [&]() {
+        MessagePack parsed;
+        message.parse(packet, packetSize, &parsed);
+        escape(&parsed);
+    });
+    results[0].bytesTouched = 2 * uint64_t(packetSize);
+    results[0].resultSize = sizeof(MessagePack);
+
+    // What RemoteControl did per notification before the view parser
+    results[1].name = "pack_qbytearray";
+    results[1].nsPerMessage = measure(iterations, [&]() {
+        MessagePack parsed;
+        QByteArray value;
+        if (message.parse(packet, packetSize, &parsed)) {
+            for (int i = 0; i < parsed.len; i++) {
+                value.append(static_cast<char>(parsed.data[i]));
+            }
+        }
+        escape(value.constData());
+    });
+    results[1].bytesTouched = 2 * uint64_t(packetSize) + 2 * uint64_t(payloadSize);
+    results[1].resultSize = sizeof(MessagePack) + payloadSize;
+
+    results[2].name = "view";
+    results[2].nsPerMessage = measure(iterations, [&]() {
+        MessageView parsed;
+        message.parse(packet, packetSize, &parsed);
+        escape(&parsed);
+    });
+    results[2].bytesTouched = packetSize + sizeof(MessageView);
+    results[2].resultSize = sizeof(MessageView);
+
+    uint16_t crc = 0;
+    const double crcNs = measure(iterations, [&]() {
+        crc ^= Message::crc16(packet, packetSize - CrcSize);
+        escape(&crc);
+    });
+
+    // Packets with noise between some of them and a few corrupted ones, cut
+    // at random boundaries
+    const int STREAM_PACKETS = 64;
+    const int CORRUPT_PACKETS = STREAM_PACKETS / 16;
+    std::mt19937 random(1);
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < STREAM_PACKETS; ++i) {
+        if (i % 8 == 7) {
+            stream.push_back(0x00);
+            stream.push_back(0xff);
+        }
+        stream.insert(stream.end(), packet, packet + packetSize);
+        if (i % 16 == 15) {
+            stream[stream.size() - packetSize + 4 + random() % (packetSize - 4)] ^= uint8_t(1 << (random() % 8));
+        }
+    }
+    std::vector<int> chunks;
+    for (size_t position = 0; position < stream.size(); ) {
+        const int chunk = int(std::min<size_t>(1 + random() % maxChunk, stream.size() - position));
+        chunks.push_back(chunk);
+        position += chunk;
+    }
+
+    MessageDecoder decoder;
+    uint64_t decodedFrames = 0;
+    const uint64_t passes = std::max<uint64_t>(1, iterations / STREAM_PACKETS);
+    const double nsPerPass = measure(passes, [&]() {
+        const uint8_t* position = stream.data();
+        MessageView parsed;
+        const uint8_t* frame;
+        int frameSize;
+        for (int chunk : chunks) {
+            decoder.feed(position, chunk);
+            while (decoder.next(&parsed, &frame, &frameSize)) {
+                escape(&parsed);
+                ++decodedFrames;
+            }
+            position += chunk;
+        }
+    });
+    const uint64_t expectedFrames = uint64_t(STREAM_PACKETS - CORRUPT_PACKETS) * (passes + passes / 10);
+
+    // Four channels around hover, moving a few steps per command
+    uint16_t base[4] = { 2000, 2010, 1990, 2005 };
+    uint16_t setpoints[4] = { 2004, 2007, 1995, 2001 };
+    const uint16_t pulseUs[4] = { 1500, 1502, 1497, 1501 };
+    uint8_t legacy[8];
+    uint8_t encoded[PackedSize];
+    const double legacyEncodeNs = measure(iterations, [&]() {
+        for (int i = 0; i < 4; ++i) {
+            legacy[i * 2] = uint8_t(pulseUs[i] & 0xFF);
+            legacy[i * 2 + 1] = uint8_t(pulseUs[i] >> 8);
+        }
+        escape(legacy);
+    });
+    uint16_t decodedUs[4];
+    const double legacyDecodeNs = measure(iterations, [&]() {
+        for (int i = 0; i < 4; ++i) {
+            decodedUs[i] = uint16_t(legacy[i * 2] | (legacy[i * 2 + 1] << 8));
+        }
+        escape(decodedUs);
+    });
+    const double packedEncodeNs = measure(iterations, [&]() {
+        Message::packSetpoints(setpoints, encoded);
+        escape(encoded);
+    });
+    const double packedDecodeNs = measure(iterations, [&]() {
+        Message::unpackSetpoints(encoded, setpoints);
+        escape(setpoints);
+    });
+    const double deltaEncodeNs = measure(iterations, [&]() {
+        Message::packDelta(base, setpoints, encoded);
+        escape(encoded);
+    });
+    const double deltaDecodeNs = measure(iterations, [&]() {
+        Message::unpackDelta(base, encoded, setpoints);
+        escape(setpoints);
+    });
+
+    // Write and its acknowledgment: the legacy ack carries 4 pulse widths in
+    // μs, the channel and 4 in 1/16μs (17 bytes), the packed ack the 6 byte
+    // packed setpoints
+    const int BLE_OVERHEAD = 7;
+    const int FRAMING = 4 + CrcSize;
+    struct WireResult { const char* name; int writeBytes; int ackBytes; double encodeNs; double decodeNs; };
+    const WireResult wire[3] = {
+        { "legacy", FRAMING + 8, FRAMING + 17, legacyEncodeNs, legacyDecodeNs },
+        { "packed", FRAMING + PackedSize, FRAMING + PackedSize, packedEncodeNs, packedDecodeNs },
+        { "delta", FRAMING + DeltaSize, FRAMING + PackedSize, deltaEncodeNs, deltaDecodeNs },
+    };
+
+    std::ostringstream json;
+    json << "{\"label\":\"" << label << "\""
+         << ",\"iterations\":" << iterations
+         << ",\"packet_bytes\":" << packetSize
+         << ",\"parsers\":{";
+    for (int i = 0; i < 3; ++i) {
+        json << (i ? "," : "") << "\"" << results[i].name << "\":{"
+             << "\"ns_per_message\":" << results[i].nsPerMessage
+             << ",\"messages_per_s\":" << uint64_t(1e9 / results[i].nsPerMessage)
+             << ",\"bytes_touched\":" << results[i].bytesTouched
+             << ",\"result_size\":" << results[i].resultSize << "}";
+    }
+    json << "},\"crc\":{"
+         << "\"ns_per_frame\":" << crcNs
+         << ",\"ns_per_byte\":" << crcNs / (packetSize - CrcSize) << "}"
+         << ",\"stream\":{"
+         << "\"ns_per_message\":" << nsPerPass / STREAM_PACKETS
+         << ",\"messages_per_s\":" << uint64_t(1e9 * STREAM_PACKETS / nsPerPass)
+         << ",\"chunks_per_pass\":" << chunks.size()
+         << ",\"frames_sent\":" << expectedFrames
+         << ",\"frames_decoded\":" << decodedFrames
+         << ",\"corrupt_frames\":" << decoder.getCorruptFrames()
+         << ",\"skipped_bytes\":" << decoder.getSkippedBytes() << "}"
+         << ",\"setpoints\":{\"rate_hz\":" << rate;
+    for (const WireResult& result : wire) {
+        json << ",\"" << result.name << "\":{"
+             << "\"write_bytes\":" << result.writeBytes
+             << ",\"ack_bytes\":" << result.ackBytes
+             << ",\"bytes_per_s\":" << (result.writeBytes + result.ackBytes) * rate
+             << ",\"ble_bytes_per_s\":" << (result.writeBytes + result.ackBytes + 2 * BLE_OVERHEAD) * rate
+             << ",\"encode_ns\":" << result.encodeNs
+             << ",\"decode_ns\":" << result.decodeNs << "}";
+    }
+    json << "}}";
+    std::cout << json.str() << std::endl;
+    return 0;
+}
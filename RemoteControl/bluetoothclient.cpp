@@ -284,6 +284,13 @@ void BluetoothClient::writeData(QByteArray data)
 {
     if(m_service && m_writeCharacteristic.isValid())
     {
+        // No response to wait for, the frame CRC catches corruption
+        if(m_writeMode == QLowEnergyService::WriteWithoutResponse)
+        {
+            m_service->writeCharacteristic(m_writeCharacteristic, data, m_writeMode);
+            return;
+        }
+
         // Add a small delay before writing to avoid GATT timeouts
         QTimer::singleShot(50, this, [this, data]() {
             m_service->writeCharacteristic(m_writeCharacteristic, data, m_writeMode);
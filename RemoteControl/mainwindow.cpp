@@ -127,6 +127,10 @@ MainWindow::MainWindow(QWidget *parent)
     , m_scaleFactor(1.0f)
     , m_bleConnection(nullptr)
     , m_isArmed(false)
+    , m_packedCommands(false)
+    , m_lastSetpoints{0, 0, 0, 0}
+    , m_framesSinceKeyframe(PACKED_KEYFRAME_INTERVAL)
+    , m_trajectoryCommands(false)
     , m_pendingMotorNumber(0)
     , m_hasPendingPWMCommand(false)
 {
@@ -290,6 +294,8 @@ void MainWindow::changedState(BluetoothClient::bluetoothleState state)
         m_connectButton->setText("Connect");
         m_isArmed = false;
         m_armedButton->setText("Arm");
+        m_packedCommands = false;
+        m_trajectoryCommands = false;
 
         // Reset all motors to neutral
         m_motor1PWM->setPWMValue(1500);
@@ -302,9 +308,16 @@ void MainWindow::changedState(BluetoothClient::bluetoothleState state)
         break;
 
     case BluetoothClient::AcquireData:
+    {
         // Request current armed state
         // requestData(mArmed); // Uncomment if you have this functionality
+
+        // Ask for packed servo command support, older servers do not answer
+        QByteArray message;
+        createMessage(mCAPS, mRead, QByteArray(), &message);
+        m_bleConnection->writeData(message);
         break;
+    }
 
     case BluetoothClient::Error:
         statusChanged("ERROR: Bluetooth operation failed.");
@@ -317,17 +330,20 @@ void MainWindow::changedState(BluetoothClient::bluetoothleState state)
 
 void MainWindow::DataHandler(QByteArray data)
 {
-    uint8_t parsedCommand;
-    uint8_t rw;
-    QByteArray parsedValue;
-    parseMessage(&data, parsedCommand, parsedValue, rw);
+    // The view points into data, nothing is copied
+    MessageView parsed;
+    if (!parseMessage(data, &parsed)) {
+        return;
+    }
+    const uint8_t parsedCommand = parsed.command;
+    const uint8_t *value = parsed.data;
 
-    if(rw == mWrite) {
+    if(parsed.rw == mWrite) {
         switch(parsedCommand) {
         case mArmed:
         {
-            if (parsedValue.size() >= 1) {
-                m_isArmed = (parsedValue.at(0) != 0);
+            if (parsed.len >= 1) {
+                m_isArmed = (value[0] != 0);
                 if(m_isArmed)
                     m_armedButton->setText("DisArm");
                 else
@@ -345,27 +361,70 @@ void MainWindow::DataHandler(QByteArray data)
             break;
         }
     }
-    else if(rw == mRead) {
+    else if(parsed.rw == mRead) {
         // Handle acknowledgment messages from device
         switch(parsedCommand) {
+        case mCAPS:
+        {
+            m_packedCommands = parsed.len >= 1 && (value[0] & mCapsPacked);
+            m_trajectoryCommands = parsed.len >= 1 && (value[0] & mCapsTrajectory);
+            m_framesSinceKeyframe = PACKED_KEYFRAME_INTERVAL;
+            m_trajectoryClock.start();
+            qDebug() << "Server capabilities: packed servo commands" << (m_packedCommands ? "yes" : "no")
+                     << "trajectories" << (m_trajectoryCommands ? "yes" : "no");
+            break;
+        }
+        case mSERVOTRAJ:
+        {
+            // Playback buffer state after a trajectory frame
+            if (parsed.len >= 3) {
+                statusChanged(QString("ACK: trajectory, %1 points buffered, %2 ms ahead")
+                                  .arg(value[0]).arg(value[1] | (value[2] << 8)));
+            }
+            break;
+        }
+        case mSERVOPACKED:
+        {
+            // Acknowledgment of a packed or delta command
+            if (parsed.len >= PackedSize) {
+                uint16_t setpoints[4];
+                Message::unpackSetpoints(value, setpoints);
+                double us[4];
+                for (int i = 0; i < 4; ++i) {
+                    us[i] = PackedBaseUs + double(setpoints[i]) / PackedStepsUs;
+                }
+                statusChanged(QString("ACK: M1:%1 M2:%2 M3:%3 M4:%4")
+                                  .arg(us[0]).arg(us[1]).arg(us[2]).arg(us[3]));
+            }
+            break;
+        }
         case mData:
         {
             // Parse PWM acknowledgment (9 bytes: 4 PWMs + channel info)
-            if (parsedValue.size() >= 9) {
+            if (parsed.len >= 9) {
                 // Extract PWM values (2 bytes each, little-endian)
-                uint16_t pwm1 = (static_cast<uint8_t>(parsedValue.at(1)) << 8) | static_cast<uint8_t>(parsedValue.at(0));
-                uint16_t pwm2 = (static_cast<uint8_t>(parsedValue.at(3)) << 8) | static_cast<uint8_t>(parsedValue.at(2));
-                uint16_t pwm3 = (static_cast<uint8_t>(parsedValue.at(5)) << 8) | static_cast<uint8_t>(parsedValue.at(4));
-                uint16_t pwm4 = (static_cast<uint8_t>(parsedValue.at(7)) << 8) | static_cast<uint8_t>(parsedValue.at(6));
-                uint8_t channel = static_cast<uint8_t>(parsedValue.at(8));
+                uint16_t pwm1 = (value[1] << 8) | value[0];
+                uint16_t pwm2 = (value[3] << 8) | value[2];
+                uint16_t pwm3 = (value[5] << 8) | value[4];
+                uint16_t pwm4 = (value[7] << 8) | value[6];
+                uint8_t channel = value[8];
+
+                // Newer servers append the same values in 1/16μs (bytes 9-16)
+                double fine[4] = { double(pwm1), double(pwm2), double(pwm3), double(pwm4) };
+                if (parsed.len >= 17) {
+                    for (int i = 0; i < 4; ++i) {
+                        uint16_t ticks = (value[10 + 2 * i] << 8) | value[9 + 2 * i];
+                        fine[i] = ticks / 16.0;
+                    }
+                }
 
                 qDebug() << "Received acknowledgment for channel" << channel
-                         << "with PWMs: Motor1=" << pwm1 << "μs, Motor2=" << pwm2
-                         << "μs, Motor3=" << pwm3 << "μs, Motor4=" << pwm4 << "μs";
+                         << "with PWMs: Motor1=" << fine[0] << "μs, Motor2=" << fine[1]
+                         << "μs, Motor3=" << fine[2] << "μs, Motor4=" << fine[3] << "μs";
 
                 // Update UI to reflect actual values (optional)
                 statusChanged(QString("ACK: Ch%1 - M1:%2 M2:%3 M3:%4 M4:%5")
-                                  .arg(channel).arg(pwm1).arg(pwm2).arg(pwm3).arg(pwm4));
+                                  .arg(channel).arg(fine[0]).arg(fine[1]).arg(fine[2]).arg(fine[3]));
             }
             break;
         }
@@ -434,20 +493,9 @@ void MainWindow::createMessage(uint8_t msgId, uint8_t rw, QByteArray payload, QB
     }
 }
 
-void MainWindow::parseMessage(QByteArray *data, uint8_t &command, QByteArray &value, uint8_t &rw)
+bool MainWindow::parseMessage(const QByteArray &data, MessageView *parsed)
 {
-    MessagePack parsedMessage;
-
-    uint8_t* dataToParse = reinterpret_cast<uint8_t*>(data->data());
-    if(message.parse(dataToParse, static_cast<uint8_t>(data->length()), &parsedMessage))
-    {
-        command = parsedMessage.command;
-        rw = parsedMessage.rw;
-        for(int i = 0; i < parsedMessage.len; i++)
-        {
-            value.append(static_cast<char>(parsedMessage.data[i]));
-        }
-    }
+    return message.parse(reinterpret_cast<const uint8_t*>(data.constData()), int(data.length()), parsed);
 }
 
 void MainWindow::sendMotorPWMCommand(int motorNumber, int pwmValue)
@@ -474,6 +522,71 @@ void MainWindow::sendMotorPWMCommand(int motorNumber, int pwmValue)
     case 4: pwm4 = pwmValue; break;
     }
 
+    if (m_trajectoryCommands) {
+        uint16_t setpoints[4];
+        const int pwm[4] = { pwm1, pwm2, pwm3, pwm4 };
+        for (int i = 0; i < 4; ++i) {
+            setpoints[i] = static_cast<uint16_t>(qBound(0, (pwm[i] - PackedBaseUs) * PackedStepsUs, PackedMax));
+        }
+
+        // Linear ramp from the last setpoints, timed by the sender clock so
+        // the server plays it at this spacing whatever the BLE delay
+        const uint16_t senderMs = static_cast<uint16_t>(m_trajectoryClock.elapsed());
+        QByteArray trajectory;
+        trajectory.append(static_cast<char>(senderMs & 0xFF));
+        trajectory.append(static_cast<char>(senderMs >> 8));
+        for (int point = 1; point <= TRAJECTORY_POINTS; ++point) {
+            uint16_t ramp[4];
+            for (int i = 0; i < 4; ++i) {
+                ramp[i] = static_cast<uint16_t>(m_lastSetpoints[i] +
+                                                (int(setpoints[i]) - int(m_lastSetpoints[i])) * point / TRAJECTORY_POINTS);
+            }
+            uint8_t packed[PackedSize];
+            Message::packSetpoints(ramp, packed);
+            trajectory.append(static_cast<char>((point - 1) * TRAJECTORY_STEP_MS));
+            trajectory.append(reinterpret_cast<const char*>(packed), PackedSize);
+        }
+        memcpy(m_lastSetpoints, setpoints, sizeof(m_lastSetpoints));
+
+        QByteArray message;
+        createMessage(mSERVOTRAJ, mWrite, trajectory, &message);
+        m_bleConnection->writeData(message);
+
+        qDebug() << "Sent PWM trajectory - Motor1:" << pwm1 << "Motor2:" << pwm2 << "Motor3:" << pwm3 << "Motor4:" << pwm4;
+        return;
+    }
+
+    if (m_packedCommands) {
+        uint16_t setpoints[4];
+        const int pwm[4] = { pwm1, pwm2, pwm3, pwm4 };
+        for (int i = 0; i < 4; ++i) {
+            setpoints[i] = static_cast<uint16_t>(qBound(0, (pwm[i] - PackedBaseUs) * PackedStepsUs, PackedMax));
+        }
+
+        // A delta frame while the change is small, a packed frame every
+        // PACKED_KEYFRAME_INTERVAL frames so a lost write is recovered
+        uint8_t packed[PackedSize];
+        uint8_t command = mSERVODELTA;
+        int size = DeltaSize;
+        if (m_framesSinceKeyframe >= PACKED_KEYFRAME_INTERVAL ||
+            !Message::packDelta(m_lastSetpoints, setpoints, packed)) {
+            Message::packSetpoints(setpoints, packed);
+            command = mSERVOPACKED;
+            size = PackedSize;
+            m_framesSinceKeyframe = 0;
+        } else {
+            m_framesSinceKeyframe++;
+        }
+        memcpy(m_lastSetpoints, setpoints, sizeof(m_lastSetpoints));
+
+        QByteArray message;
+        createMessage(command, mWrite, QByteArray(reinterpret_cast<const char*>(packed), size), &message);
+        m_bleConnection->writeData(message);
+
+        qDebug() << "Sent PWM values" << (command == mSERVODELTA ? "as delta" : "packed") << "- Motor1:" << pwm1 << "Motor2:" << pwm2 << "Motor3:" << pwm3 << "Motor4:" << pwm4;
+        return;
+    }
+
     // Pack all 4 PWM values (2 bytes each, little-endian)
     payload.append(static_cast<char>(pwm1 & 0xFF));        // PWM1 low byte
     payload.append(static_cast<char>((pwm1 >> 8) & 0xFF)); // PWM1 high byte
@@ -547,6 +660,12 @@ void MainWindow::onArmedClicked()
         m_bleConnection->writeData(message);
 
         m_isArmed = true;
+        m_framesSinceKeyframe = PACKED_KEYFRAME_INTERVAL;
+
+        // The server starts from neutral, the first trajectory ramps from there
+        for (int i = 0; i < 4; ++i) {
+            m_lastSetpoints[i] = static_cast<uint16_t>((1500 - PackedBaseUs) * PackedStepsUs);
+        }
         m_armedButton->setText("DisArm");
         statusChanged("System ARMED - PWM commands enabled");
     }
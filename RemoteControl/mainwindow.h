@@ -16,6 +16,7 @@
 #include <QFrame>
 #include <QFont>
 #include <QMessageBox>
+#include <QElapsedTimer>
 #include "message.h"
 #include "bluetoothclient.h"
 
@@ -97,7 +98,7 @@ private:
 
     // Message handling methods
     void createMessage(uint8_t msgId, uint8_t rw, QByteArray payload, QByteArray *result);
-    void parseMessage(QByteArray *data, uint8_t &command, QByteArray &value, uint8_t &rw);
+    bool parseMessage(const QByteArray &data, MessageView *parsed);
 
 // Platform-specific methods
 #if defined(Q_OS_ANDROID)
@@ -134,6 +135,19 @@ private:
     Message message;
     bool m_isArmed;
 
+    // Packed setpoint frames, used when the server lists mCapsPacked
+    static constexpr int PACKED_KEYFRAME_INTERVAL = 10;   // delta frames between two packed frames
+    bool m_packedCommands;
+    uint16_t m_lastSetpoints[4];                          // base of the next delta frame
+    int m_framesSinceKeyframe;
+
+    // Trajectory frames, used when the server lists mCapsTrajectory: a
+    // slider change goes out as a ramp played back by the server
+    static constexpr int TRAJECTORY_POINTS = 5;
+    static constexpr int TRAJECTORY_STEP_MS = 20;         // 100ms of trajectory per frame
+    bool m_trajectoryCommands;
+    QElapsedTimer m_trajectoryClock;                      // sender time of the frames
+
     // PWM throttling
     QTimer *m_pwmSendTimer;
     int m_pendingMotorNumber;
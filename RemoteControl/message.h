@@ -15,9 +15,32 @@
 #define mSERVO2     0xa1
 #define mSERVO3     0xa2
 #define mSERVO4     0xa3
+#define mSERVOFINE  0xa4 //All 4 ESCs, pulse widths in 1/16us
+#define mSERVOPACKED 0xa5 //All 4 ESCs, 12 bits each (PackedSize bytes)
+#define mSERVODELTA 0xa6 //All 4 ESCs, change from the last setpoints (DeltaSize bytes)
+#define mCAPS       0xa7 //Read: server answers with its mCaps bits
+#define mSERVOTRAJ  0xa8 //All 4 ESCs, timed packed setpoints played back by the server
 #define mData       0xe1
 
+#define mCapsPacked 0x01 //mSERVOPACKED and mSERVODELTA understood
+#define mCapsTrajectory 0x02 //mSERVOTRAJ understood
+
+//Packed setpoint: 1/4us steps above PackedBaseUs, 0-4095 (1000-2023.75us)
+#define PackedBaseUs   1000
+#define PackedStepsUs  4
+#define PackedMax      4095
+#define PackedSize     6    //4 x 12 bits
+#define DeltaSize      5    //4 x int8 steps + check byte of the base setpoints
+
+//Trajectory: uint16 sender time in ms (wraps), then points of uint8 ms after
+//the sender time + packed setpoints, in time order
+#define TrajHeaderSize 2
+#define TrajPointSize  (1 + PackedSize)
+#define TrajMaxPoints  ((MaxLen - TrajHeaderSize) / TrajPointSize)
+
 #define MaxPayload 1024
+#define MaxLen      255  //len field is one byte
+#define CrcSize     2    //CRC-16/CCITT-FALSE over header..data, little-endian
 
 //message len max is 256, header, command, rw and cheksum total len is 8, therefore payload max len is 248
 //max input bluetooth buffer in this chip allows a payload max 0x38
@@ -28,17 +51,98 @@ typedef struct {
     uint8_t rw;
     uint8_t command;
     uint8_t data[MaxPayload];
-    uint8_t CheckSum[2];
+    uint8_t CheckSum[2]; //CRC-16 as received
 } MessagePack;
 
+// Parsed message that points into the received buffer instead of copying
+// the payload, valid as long as that buffer is
+typedef struct {
+    uint8_t header;
+    uint8_t len;
+    uint8_t rw;
+    uint8_t command;
+    const uint8_t *data;
+} MessageView;
+
 
 class Message
 {
 public:
     Message();
-    bool parse(uint8_t *dataUART, uint8_t size, MessagePack *message);
-    uint8_t create_pack(uint8_t RW,uint8_t command, QByteArray dataSend, uint8_t *dataUART);
+    // No copy or allocation, message->data points into dataUART. False on
+    // a bad header, length or CRC.
+    bool parse(const uint8_t *dataUART, int size, MessageView *message);
+    // Copies the payload into a MessagePack
+    bool parse(uint8_t *dataUART, int size, MessagePack *message);
+    // Frame with CRC into dataUART (up to 4 + MaxLen + CrcSize bytes), returns its size
+    int create_pack(uint8_t RW,uint8_t command, QByteArray dataSend, uint8_t *dataUART);
+
+    // Table-driven CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff)
+    static uint16_t crc16(const uint8_t *data, int size);
+
+    // 4 packed setpoints (0-PackedMax) <-> PackedSize bytes
+    static void packSetpoints(const uint16_t setpoints[4], uint8_t *out);
+    static void unpackSetpoints(const uint8_t *in, uint16_t setpoints[4]);
+
+    // Delta frame from base to setpoints; false if a channel moved more
+    // than 127 steps, send a packed frame then
+    static bool packDelta(const uint16_t base[4], const uint16_t setpoints[4], uint8_t *out);
+    // False if base is not what the frame was encoded against (a frame was
+    // lost) or a result leaves 0-PackedMax
+    static bool unpackDelta(const uint16_t base[4], const uint8_t *in, uint16_t setpoints[4]);
+
+};
+
+// Frame decoder for a byte stream cut into arbitrary chunks: a BLE write can
+// carry part of a frame, several frames or garbage between them. Scans for
+// the header byte, a header with an unknown rw field is skipped as noise and
+// a frame with a bad CRC is counted and rescanned from the byte after its
+// header. While a split frame waits for the rest of its length, a complete
+// CRC-valid frame found behind it wins and the pending one is counted as
+// corrupt, so a damaged length byte does not hold back the frames after it.
+// Frames that arrive whole point into the chunk, split frames are collected
+// in a fixed buffer, so memory stays bounded.
+//
+//   decoder.feed(chunk, size);
+//   while (decoder.next(&message, &frame, &frameSize)) { ... }
+class MessageDecoder
+{
+public:
+    static constexpr int MaxFrame = 4 + MaxLen + CrcSize;
+
+    MessageDecoder();
+
+    // Drop a partial frame, e.g. on a new connection
+    void reset();
+
+    // Start decoding a chunk, it must stay valid until next() returns false
+    void feed(const uint8_t *data, int size);
+
+    // Next complete frame; message, frame and frameSize (the whole frame
+    // header to CRC) are valid until the next call
+    bool next(MessageView *message, const uint8_t **frame, int *frameSize);
+
+    // Bytes skipped while looking for a frame header
+    uint64_t getSkippedBytes() const { return m_skippedBytes; }
+
+    // Complete frames dropped for a CRC mismatch
+    uint64_t getCorruptFrames() const { return m_corruptFrames; }
+
+private:
+    // Move a partial frame that turned out to be noise up to its next header
+    void resync();
+
+    // Drop the pending partial frame for a complete valid one behind it
+    bool acceptLaterFrame();
 
+    const uint8_t *m_input;
+    int m_inputSize;
+    int m_inputPos;
+    uint8_t m_partial[MaxFrame];
+    int m_partialSize;
+    int m_partialUsed;                  // front of m_partial returned as the last frame
+    uint64_t m_skippedBytes;
+    uint64_t m_corruptFrames;
 };
 
 #endif // MESSAGE_H
@@ -0,0 +1,98 @@
+#include "blecapture.h"
+#include "clock.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+static const char BLE_CAPTURE_MAGIC[8] = { 'E', 'S', 'C', 'B', 'L', 'E', '0', '1' };
+
+BleCaptureWriter::BleCaptureWriter()
+    : m_file(nullptr)
+    , m_startNs(0)
+{
+}
+
+BleCaptureWriter::~BleCaptureWriter()
+{
+    close();
+}
+
+bool BleCaptureWriter::open(const std::string& path)
+{
+    close();
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file) {
+        LOG_ERROR("Failed to create BLE capture %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    fwrite(BLE_CAPTURE_MAGIC, sizeof(BLE_CAPTURE_MAGIC), 1, m_file);
+    m_startNs = Clock::getInstance()->nowNs();
+
+    LOG_INFO("Capturing BLE input to %s", path.c_str());
+    return true;
+}
+
+void BleCaptureWriter::close()
+{
+    if (m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void BleCaptureWriter::write(BleEventType type, const uint8_t* data, size_t size)
+{
+    if (!m_file) {
+        return;
+    }
+
+    const int64_t timeNs = Clock::getInstance()->nowNs() - m_startNs;
+    const uint8_t typeByte = uint8_t(type);
+    const uint16_t length = uint16_t(std::min<size_t>(size, UINT16_MAX));
+    fwrite(&timeNs, sizeof(timeNs), 1, m_file);
+    fwrite(&typeByte, sizeof(typeByte), 1, m_file);
+    fwrite(&length, sizeof(length), 1, m_file);
+    if (length) {
+        fwrite(data, 1, length, m_file);
+    }
+}
+
+bool loadBleCapture(const std::string& path, std::vector<BleEvent>* events)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        LOG_ERROR("Failed to open BLE capture %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    char magic[sizeof(BLE_CAPTURE_MAGIC)];
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, BLE_CAPTURE_MAGIC, sizeof(magic)) != 0) {
+        LOG_ERROR("%s is not a BLE capture", path.c_str());
+        fclose(file);
+        return false;
+    }
+
+    events->clear();
+    for (;;) {
+        BleEvent event;
+        uint8_t typeByte;
+        uint16_t length;
+        if (fread(&event.timeNs, sizeof(event.timeNs), 1, file) != 1 ||
+            fread(&typeByte, sizeof(typeByte), 1, file) != 1 ||
+            fread(&length, sizeof(length), 1, file) != 1) {
+            break;
+        }
+        event.type = BleEventType(typeByte);
+        event.data.resize(length);
+        if (length && fread(event.data.data(), 1, length, file) != length) {
+            // Cut off by a crash of the capturing process
+            break;
+        }
+        events->push_back(std::move(event));
+    }
+
+    fclose(file);
+    return true;
+}
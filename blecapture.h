@@ -0,0 +1,49 @@
+#ifndef BLECAPTURE_H
+#define BLECAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Capture of what the BLE link delivered to ServoController: raw packets and
+// connection changes with their arrival time, for replay without a
+// Bluetooth adapter (see BleReplay).
+//
+// File: "ESCBLE01", then per event int64 time (ns since the capture
+// started), uint8 type, uint16 size and the packet bytes, host byte order.
+
+enum class BleEventType : uint8_t {
+    Data = 1,
+    Connected = 2,
+    Disconnected = 3
+};
+
+struct BleEvent {
+    int64_t timeNs;
+    BleEventType type;
+    std::vector<uint8_t> data;
+};
+
+class BleCaptureWriter
+{
+public:
+    BleCaptureWriter();
+    ~BleCaptureWriter();
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_file != nullptr; }
+
+    // Buffered, the file is flushed on close()
+    void write(BleEventType type, const uint8_t* data = nullptr, size_t size = 0);
+
+private:
+    FILE* m_file;
+    int64_t m_startNs;
+};
+
+// Whole capture, oldest first
+bool loadBleCapture(const std::string& path, std::vector<BleEvent>* events);
+
+#endif // BLECAPTURE_H
@@ -0,0 +1,45 @@
+#include "clock.h"
+#include <time.h>
+#include <cerrno>
+
+Clock *Clock::theInstance_ = nullptr;
+
+Clock* Clock::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        static SystemClock systemClock;
+        theInstance_ = &systemClock;
+    }
+    return theInstance_;
+}
+
+void Clock::setInstance(Clock* clock)
+{
+    theInstance_ = clock;
+}
+
+void Clock::spinUntilNs(int64_t deadlineNs)
+{
+    while (nowNs() < deadlineNs) {
+        // Busy wait
+    }
+}
+
+int64_t SystemClock::nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+void SystemClock::sleepUntilNs(int64_t deadlineNs)
+{
+    struct timespec ts;
+    ts.tv_sec = deadlineNs / 1000000000LL;
+    ts.tv_nsec = deadlineNs % 1000000000LL;
+
+    // Absolute deadline: signals and preemption cannot add drift
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <cstdint>
+
+// Time source of the PWM engine. Edge scheduling, command timestamps and
+// every wait go through Clock::getInstance(), so a VirtualClock can replace
+// the system clock and run thousands of frames without real waiting.
+//
+// The clock is chosen with setInstance() before the engine is started and
+// must stay alive while it runs; by default it is the SystemClock.
+class Clock
+{
+public:
+    virtual ~Clock() = default;
+
+    static Clock* getInstance();
+
+    // Install a clock, nullptr restores the system clock
+    static void setInstance(Clock* clock);
+
+    // Monotonic time in nanoseconds
+    virtual int64_t nowNs() = 0;
+
+    // Block until nowNs() >= deadlineNs
+    virtual void sleepUntilNs(int64_t deadlineNs) = 0;
+
+    // Busy-wait until deadlineNs, for the stretch below the sleep resolution
+    virtual void spinUntilNs(int64_t deadlineNs);
+
+    void sleepForNs(int64_t durationNs) { sleepUntilNs(nowNs() + durationNs); }
+
+    // Threads that wait on the clock register for their lifetime (see
+    // ClockThread), a virtual clock only advances when all of them sleep
+    virtual void attachThread() {}
+    virtual void detachThread() {}
+
+private:
+    static Clock *theInstance_;
+};
+
+// CLOCK_MONOTONIC with absolute clock_nanosleep
+class SystemClock : public Clock
+{
+public:
+    int64_t nowNs() override;
+    void sleepUntilNs(int64_t deadlineNs) override;
+};
+
+// Attaches the current thread to the installed clock for its scope
+class ClockThread
+{
+public:
+    ClockThread() : m_clock(Clock::getInstance()) { m_clock->attachThread(); }
+    ~ClockThread() { m_clock->detachThread(); }
+
+    ClockThread(const ClockThread&) = delete;
+    ClockThread& operator=(const ClockThread&) = delete;
+
+private:
+    Clock* m_clock;
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,311 @@
+#include "dshot.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "gpiohal.h"
+#include "clock.h"
+
+// DShotEncoder
+
+uint16_t DShotEncoder::crc(uint16_t packet, bool inverted)
+{
+    uint16_t crc = (packet ^ (packet >> 4) ^ (packet >> 8)) & 0x0F;
+    return inverted ? (~crc & 0x0F) : crc;
+}
+
+uint16_t DShotEncoder::encodeFrame(uint16_t value, bool telemetry, bool inverted)
+{
+    uint16_t packet = uint16_t(((value & 0x07FF) << 1) | (telemetry ? 1 : 0));
+    return uint16_t((packet << 4) | crc(packet, inverted));
+}
+
+uint16_t DShotEncoder::commandToValue(PulseWidth command, bool mode3d)
+{
+    constexpr int32_t MIN = 1000 * PulseWidth::TICKS_PER_US;
+    constexpr int32_t NEUTRAL = 1500 * PulseWidth::TICKS_PER_US;
+    constexpr int32_t MAX = 2000 * PulseWidth::TICKS_PER_US;
+    const int32_t ticks = std::max(MIN, std::min(MAX, command.ticks()));
+
+    if (!mode3d) {
+        if (ticks == MIN) {
+            return uint16_t(DShotCommand::MotorStop);
+        }
+        return uint16_t(THROTTLE_MIN + (ticks - MIN) * (THROTTLE_MAX - THROTTLE_MIN) / (MAX - MIN));
+    }
+
+    // 3D: 1500 stop, 1500-2000 -> 1048-2047 forward, 1500-1000 -> 48-1047 reverse
+    if (ticks == NEUTRAL) {
+        return uint16_t(DShotCommand::MotorStop);
+    }
+    if (ticks > NEUTRAL) {
+        return uint16_t(THROTTLE_3D_FORWARD_MIN + (ticks - NEUTRAL) * (THROTTLE_MAX - THROTTLE_3D_FORWARD_MIN) / (MAX - NEUTRAL));
+    }
+    return uint16_t(THROTTLE_MIN + (NEUTRAL - ticks) * (THROTTLE_3D_FORWARD_MIN - 1 - THROTTLE_MIN) / (NEUTRAL - MIN));
+}
+
+DShotBitTiming DShotEncoder::bitTiming(int bitRate)
+{
+    DShotBitTiming timing;
+    timing.bitPeriodNs = 1000000000LL / bitRate;
+    timing.zeroHighNs = timing.bitPeriodNs * 3 / 8;
+    timing.oneHighNs = timing.bitPeriodNs * 3 / 4;
+    return timing;
+}
+
+void DShotEncoder::waveform(uint16_t frame, const DShotBitTiming& timing, int64_t* highNs)
+{
+    for (int bit = 0; bit < FRAME_BITS; ++bit) {
+        bool one = frame & (0x8000 >> bit);
+        highNs[bit] = one ? timing.oneHighNs : timing.zeroHighNs;
+    }
+}
+
+// DShotGpioSink
+
+DShotGpioSink::DShotGpioSink(int gpioPin)
+    : m_gpioPin(gpioPin)
+    , m_gpio(nullptr)
+    , m_timing{0, 0, 0}
+{
+}
+
+bool DShotGpioSink::open(const DShotBitTiming& timing)
+{
+    m_timing = timing;
+    m_gpio = GpioHal::getInstance();
+    return m_gpio->configureOutput(m_gpioPin);
+}
+
+void DShotGpioSink::close()
+{
+    if (m_gpio) {
+        m_gpio->releasePin(m_gpioPin);
+    }
+}
+
+bool DShotGpioSink::transmit(uint16_t frame)
+{
+    int64_t highNs[DShotEncoder::FRAME_BITS];
+    DShotEncoder::waveform(frame, m_timing, highNs);
+
+    // Every bit on an absolute grid so write latency does not accumulate
+    Clock* clock = Clock::getInstance();
+    const int64_t start = clock->nowNs();
+    for (int bit = 0; bit < DShotEncoder::FRAME_BITS; ++bit) {
+        const int64_t bitStart = start + bit * m_timing.bitPeriodNs;
+
+        clock->spinUntilNs(bitStart);
+        m_gpio->write(m_gpioPin, true);
+
+        clock->spinUntilNs(bitStart + highNs[bit]);
+        m_gpio->write(m_gpioPin, false);
+    }
+    return true;
+}
+
+// DShotSpiSink
+
+DShotSpiSink::DShotSpiSink(const std::string& device)
+    : m_device(device)
+    , m_fd(-1)
+    , m_speedHz(0)
+    , m_timing{0, 0, 0}
+    , m_bidirectional(false)
+    , m_captureBytes(0)
+{
+}
+
+DShotSpiSink::~DShotSpiSink()
+{
+    close();
+}
+
+bool DShotSpiSink::open(const DShotBitTiming& timing)
+{
+    m_timing = timing;
+    m_speedHz = uint32_t(1000000000LL * SPI_BITS_PER_BIT / timing.bitPeriodNs);
+
+    m_fd = ::open(m_device.c_str(), O_RDWR | O_CLOEXEC);
+    if (m_fd < 0) {
+        LOG_ERROR("Failed to open %s: %s", m_device.c_str(), strerror(errno));
+        return false;
+    }
+
+    uint8_t mode = SPI_MODE_0;
+    uint8_t bits = 8;
+    if (ioctl(m_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+        ioctl(m_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+        ioctl(m_fd, SPI_IOC_WR_MAX_SPEED_HZ, &m_speedHz) < 0) {
+        LOG_ERROR("Failed to configure %s: %s", m_device.c_str(), strerror(errno));
+        close();
+        return false;
+    }
+
+    // ~30μs turnaround + 21 bits at 5/4 bit rate + margin, one SPI byte per DShot bit period
+    const int64_t windowNs = 30000 + DShotTelemetryDecoder::RESPONSE_BITS * timing.bitPeriodNs * 4 / 5 + 20000;
+    m_captureBytes = int(std::min<int64_t>(MAX_CAPTURE_BYTES, windowNs / timing.bitPeriodNs));
+
+    LOG_INFO("DShot SPI sink on %s at %uHz", m_device.c_str(), (unsigned)m_speedHz);
+    return true;
+}
+
+void DShotSpiSink::close()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool DShotSpiSink::setBidirectional(bool enabled)
+{
+    m_bidirectional = enabled;
+    return true;
+}
+
+size_t DShotSpiSink::telemetrySamples(const uint8_t** bytes, uint32_t* samplesPerBitQ8)
+{
+    if (!m_bidirectional || m_captureBytes == 0) {
+        return 0;
+    }
+
+    // Response runs at 5/4 of the DShot bit rate
+    *bytes = m_rxBuffer + DShotEncoder::FRAME_BITS;
+    *samplesPerBitQ8 = SPI_BITS_PER_BIT * 256 * 4 / 5;
+    return size_t(m_captureBytes) * 8;
+}
+
+void DShotSpiSink::encodeBytes(uint16_t frame, const DShotBitTiming& timing, bool inverted, uint8_t* bytes)
+{
+    // Number of high SPI bits for a 0 and a 1 (3/8 and 6/8 of the bit period)
+    const int64_t spiBitNs = timing.bitPeriodNs / SPI_BITS_PER_BIT;
+    const int zeroBits = int((timing.zeroHighNs + spiBitNs / 2) / spiBitNs);
+    const int oneBits = int((timing.oneHighNs + spiBitNs / 2) / spiBitNs);
+    const uint8_t zeroPattern = uint8_t(0xFF << (8 - zeroBits));
+    const uint8_t onePattern = uint8_t(0xFF << (8 - oneBits));
+
+    for (int bit = 0; bit < DShotEncoder::FRAME_BITS; ++bit) {
+        uint8_t pattern = (frame & (0x8000 >> bit)) ? onePattern : zeroPattern;
+        bytes[bit] = inverted ? uint8_t(~pattern) : pattern;
+    }
+}
+
+bool DShotSpiSink::transmit(uint16_t frame)
+{
+    if (m_fd < 0) {
+        return false;
+    }
+
+    encodeBytes(frame, m_timing, m_bidirectional, m_txBuffer);
+
+    // Bidirectional: keep the line idle high and sample the response in the same transfer
+    int length = DShotEncoder::FRAME_BITS;
+    if (m_bidirectional) {
+        memset(m_txBuffer + length, 0xFF, m_captureBytes);
+        length += m_captureBytes;
+    }
+
+    struct spi_ioc_transfer transfer;
+    memset(&transfer, 0, sizeof(transfer));
+    transfer.tx_buf = reinterpret_cast<uintptr_t>(m_txBuffer);
+    transfer.rx_buf = m_bidirectional ? reinterpret_cast<uintptr_t>(m_rxBuffer) : 0;
+    transfer.len = length;
+    transfer.speed_hz = m_speedHz;
+    transfer.bits_per_word = 8;
+
+    return ioctl(m_fd, SPI_IOC_MESSAGE(1), &transfer) == length;
+}
+
+// DShotOutput
+
+DShotOutput::DShotOutput(std::unique_ptr<DShotSink> sink, int bitRate, bool bidirectional)
+    : m_sink(std::move(sink))
+    , m_timing(DShotEncoder::bitTiming(bitRate))
+    , m_value(uint16_t(DShotCommand::MotorStop))
+    , m_pendingCommand(0)
+    , m_bidirectional(bidirectional)
+    , m_open(false)
+    , m_eRpm(0)
+    , m_telemetryFrames(0)
+    , m_telemetryErrors(0)
+{
+}
+
+DShotOutput::~DShotOutput()
+{
+    close();
+}
+
+bool DShotOutput::open()
+{
+    if (m_open || !m_sink) {
+        return m_open;
+    }
+
+    if (!m_sink->setBidirectional(m_bidirectional)) {
+        LOG_ERROR("DShot sink does not support bidirectional telemetry");
+        return false;
+    }
+
+    m_open = m_sink->open(m_timing);
+    return m_open;
+}
+
+void DShotOutput::close()
+{
+    if (m_open) {
+        m_sink->close();
+        m_open = false;
+    }
+}
+
+void DShotOutput::setValue(uint16_t value)
+{
+    m_value.store(std::min(value, DShotEncoder::THROTTLE_MAX), std::memory_order_relaxed);
+}
+
+void DShotOutput::queueCommand(DShotCommand command, int repeat)
+{
+    repeat = std::max(1, std::min(0xFFFF, repeat));
+    m_pendingCommand.store((uint32_t(command) << 16) | uint32_t(repeat), std::memory_order_release);
+}
+
+bool DShotOutput::transmitFrame()
+{
+    uint16_t value = m_value.load(std::memory_order_relaxed);
+    bool telemetry = false;
+
+    // Special commands go out with the telemetry bit set, as the ESCs expect
+    uint32_t pending = m_pendingCommand.load(std::memory_order_acquire);
+    while (pending & 0xFFFF) {
+        if (m_pendingCommand.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel)) {
+            value = uint16_t(pending >> 16);
+            telemetry = true;
+            break;
+        }
+    }
+
+    if (!m_sink->transmit(DShotEncoder::encodeFrame(value, telemetry, m_bidirectional))) {
+        return false;
+    }
+
+    if (m_bidirectional) {
+        const uint8_t* samples = nullptr;
+        uint32_t samplesPerBitQ8 = 0;
+        size_t sampleCount = m_sink->telemetrySamples(&samples, &samplesPerBitQ8);
+
+        DShotTelemetry telemetry;
+        if (sampleCount > 0 && DShotTelemetryDecoder::decodePacked(samples, sampleCount, samplesPerBitQ8, &telemetry)) {
+            m_eRpm.store(telemetry.eRpm, std::memory_order_relaxed);
+            m_telemetryFrames.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_telemetryErrors.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,193 @@
+#ifndef DSHOT_H
+#define DSHOT_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include "dshottelemetry.h"
+#include "pulsewidth.h"
+
+// DShot digital ESC protocol.
+//
+// A frame is 16 bits, MSB first: 11-bit value, 1 telemetry request bit and a
+// 4-bit CRC (XOR of the three nibbles of the first 12 bits, inverted for
+// bidirectional DShot). Values 0-47 are special commands, 48-2047 throttle.
+// Every bit has the same period; a 1 is high for 75% of it, a 0 for 37.5%.
+
+enum class DShotCommand : uint16_t {
+    MotorStop = 0,
+    Beep1 = 1,
+    Beep2 = 2,
+    Beep3 = 3,
+    Beep4 = 4,
+    Beep5 = 5,
+    EscInfo = 6,
+    SpinDirection1 = 7,
+    SpinDirection2 = 8,
+    Mode3dOff = 9,
+    Mode3dOn = 10,
+    SettingsRequest = 11,
+    SaveSettings = 12,
+    SpinDirectionNormal = 20,
+    SpinDirectionReversed = 21
+};
+
+struct DShotBitTiming {
+    int64_t bitPeriodNs;
+    int64_t zeroHighNs;
+    int64_t oneHighNs;
+};
+
+class DShotEncoder
+{
+public:
+    static constexpr int FRAME_BITS = 16;
+    static constexpr uint16_t THROTTLE_MIN = 48;
+    static constexpr uint16_t THROTTLE_MAX = 2047;
+    static constexpr uint16_t THROTTLE_3D_FORWARD_MIN = 1048;   // 3D mode: 48-1047 reverse, 1048-2047 forward
+
+    // 4-bit checksum of the 12-bit value + telemetry field
+    static uint16_t crc(uint16_t packet, bool inverted = false);
+
+    // Full 16-bit frame
+    static uint16_t encodeFrame(uint16_t value, bool telemetry, bool inverted = false);
+
+    // Standard 1000-2000μs command to a DShot value. In 3D mode 1500μs is
+    // motor stop and the two halves map to reverse/forward, otherwise 1000μs
+    // is stop and 1000-2000μs covers 48-2047. The full 1/16μs command
+    // resolution is used (about 0.5μs per DShot step).
+    static uint16_t commandToValue(PulseWidth command, bool mode3d);
+
+    // Bit timing for 150000, 300000 or 600000 bit/s
+    static DShotBitTiming bitTiming(int bitRate);
+
+    // High time of each of the 16 bits, MSB first
+    static void waveform(uint16_t frame, const DShotBitTiming& timing, int64_t* highNs);
+};
+
+// Output stage a DShot frame is clocked out through
+class DShotSink
+{
+public:
+    virtual ~DShotSink() = default;
+
+    virtual bool open(const DShotBitTiming& timing) = 0;
+    virtual void close() = 0;
+
+    // Send one frame, blocks until the last bit has been clocked out
+    virtual bool transmit(uint16_t frame) = 0;
+
+    // Bidirectional DShot: inverted line and a capture window for the ESC's
+    // eRPM response after every frame. Returns false if not supported.
+    virtual bool setBidirectional(bool enabled) { return !enabled; }
+
+    // Bit-packed line samples (MSB first) captured after the last transmit(),
+    // returns the number of samples, 0 if nothing was captured
+    virtual size_t telemetrySamples(const uint8_t** bytes, uint32_t* samplesPerBitQ8)
+    {
+        (void)bytes;
+        (void)samplesPerBitQ8;
+        return 0;
+    }
+};
+
+// Bit-bangs the waveform on a GPIO pin with busy-waits. ~107μs per frame at
+// DShot150, faster modes need the SPI sink (ESCControlThread picks it).
+class GpioHal;
+
+class DShotGpioSink : public DShotSink
+{
+public:
+    explicit DShotGpioSink(int gpioPin);
+
+    bool open(const DShotBitTiming& timing) override;
+    void close() override;
+    bool transmit(uint16_t frame) override;
+
+private:
+    int m_gpioPin;
+    GpioHal *m_gpio;
+    DShotBitTiming m_timing;
+};
+
+// Clocks the waveform out on SPI MOSI, 8 SPI bits per DShot bit, so one
+// frame is a single 16-byte transfer done by the SPI controller. In
+// bidirectional mode the transfer is extended by a capture window and the
+// ESC response is read back on MISO (MISO on the signal line, MOSI through
+// a series resistor).
+class DShotSpiSink : public DShotSink
+{
+public:
+    static constexpr int SPI_BITS_PER_BIT = 8;
+
+    explicit DShotSpiSink(const std::string& device = "/dev/spidev0.0");
+    ~DShotSpiSink();
+
+    bool open(const DShotBitTiming& timing) override;
+    void close() override;
+    bool transmit(uint16_t frame) override;
+    bool setBidirectional(bool enabled) override;
+    size_t telemetrySamples(const uint8_t** bytes, uint32_t* samplesPerBitQ8) override;
+
+    // SPI byte pattern for a frame, exposed for testing
+    static void encodeBytes(uint16_t frame, const DShotBitTiming& timing, bool inverted, uint8_t* bytes);
+
+private:
+    static constexpr int MAX_CAPTURE_BYTES = 128;
+
+    std::string m_device;
+    int m_fd;
+    uint32_t m_speedHz;
+    DShotBitTiming m_timing;
+    bool m_bidirectional;
+    int m_captureBytes;
+    uint8_t m_txBuffer[DShotEncoder::FRAME_BITS + MAX_CAPTURE_BYTES];
+    uint8_t m_rxBuffer[DShotEncoder::FRAME_BITS + MAX_CAPTURE_BYTES];
+};
+
+// One DShot ESC channel: the current value plus queued special commands,
+// transmitted by the PWM scheduler thread once per frame.
+class DShotOutput
+{
+public:
+    DShotOutput(std::unique_ptr<DShotSink> sink, int bitRate, bool bidirectional = false);
+    ~DShotOutput();
+
+    bool open();
+    bool isBidirectional() const { return m_bidirectional; }
+    void close();
+
+    // Any thread
+    void setValue(uint16_t value);
+    uint16_t getValue() const { return m_value.load(std::memory_order_relaxed); }
+
+    // Send a special command instead of the throttle for the next 'repeat'
+    // frames (direction and 3D changes need 6-10 repeats to be accepted)
+    void queueCommand(DShotCommand command, int repeat = 1);
+
+    // PWM scheduler thread
+    bool transmitFrame();
+
+    // Last decoded telemetry (bidirectional mode), any thread
+    uint32_t getERpm() const { return m_eRpm.load(std::memory_order_relaxed); }
+    uint64_t getTelemetryFrameCount() const { return m_telemetryFrames.load(std::memory_order_relaxed); }
+    uint64_t getTelemetryErrorCount() const { return m_telemetryErrors.load(std::memory_order_relaxed); }
+
+    const DShotBitTiming& timing() const { return m_timing; }
+
+private:
+    std::unique_ptr<DShotSink> m_sink;
+    DShotBitTiming m_timing;
+    std::atomic<uint16_t> m_value;
+    std::atomic<uint32_t> m_pendingCommand;     // command << 16 | remaining repeats
+    bool m_bidirectional;
+    bool m_open;
+
+    std::atomic<uint32_t> m_eRpm;
+    std::atomic<uint64_t> m_telemetryFrames;
+    std::atomic<uint64_t> m_telemetryErrors;
+};
+
+#endif // DSHOT_H
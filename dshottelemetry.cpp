@@ -0,0 +1,169 @@
+#include "dshottelemetry.h"
+
+// 5-bit GCR code -> nibble, 0xFF = invalid code
+static const uint8_t GCR_DECODE[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0x0F,
+    0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x05, 0x06, 0x07,
+    0xFF, 0x00, 0x08, 0x01, 0xFF, 0x04, 0x0C, 0xFF
+};
+
+// Nibble -> 5-bit GCR code
+static const uint8_t GCR_ENCODE[16] = {
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+bool DShotTelemetryDecoder::decodeSamples(const uint8_t* samples, size_t sampleCount, uint32_t samplesPerBitQ8,
+                                          DShotTelemetry* telemetry)
+{
+    return decodeEdges([samples](size_t i) { return samples[i] != 0; },
+                       sampleCount, samplesPerBitQ8, telemetry);
+}
+
+bool DShotTelemetryDecoder::decodePacked(const uint8_t* bytes, size_t sampleCount, uint32_t samplesPerBitQ8,
+                                         DShotTelemetry* telemetry)
+{
+    return decodeEdges([bytes](size_t i) { return (bytes[i >> 3] & (0x80 >> (i & 7))) != 0; },
+                       sampleCount, samplesPerBitQ8, telemetry);
+}
+
+template <typename SampleAt>
+bool DShotTelemetryDecoder::decodeEdges(SampleAt sampleAt, size_t sampleCount, uint32_t samplesPerBitQ8,
+                                        DShotTelemetry* telemetry)
+{
+    if (!telemetry || samplesPerBitQ8 < 256) {
+        return false;
+    }
+
+    // The line idles high, the response starts with a falling edge
+    size_t i = 0;
+    while (i < sampleCount && !sampleAt(i)) {
+        ++i;    // skip the tail of our own frame / turnaround
+    }
+    while (i < sampleCount && sampleAt(i)) {
+        ++i;
+    }
+    if (i >= sampleCount) {
+        return false;
+    }
+
+    // Edge-interval decode: each run between transitions is round(run / bit) equal bits,
+    // resynchronising on every edge so clock drift does not accumulate
+    uint32_t levels = 0;
+    int bits = 0;
+    bool level = false;
+    size_t runStart = i;
+
+    while (bits < RESPONSE_BITS) {
+        while (i < sampleCount && sampleAt(i) == level) {
+            ++i;
+        }
+
+        uint32_t runQ8 = uint32_t(i - runStart) << 8;
+        int count = int((runQ8 + samplesPerBitQ8 / 2) / samplesPerBitQ8);
+
+        if (count == 0) {
+            return false;       // glitch shorter than half a bit
+        }
+
+        // The last high run merges with the idle line, its length is inferred
+        if (i >= sampleCount || bits + count > RESPONSE_BITS) {
+            if (!level) {
+                return false;   // capture ended or overran inside a low run
+            }
+            count = RESPONSE_BITS - bits;
+        }
+
+        levels = (levels << count) | (level ? ((1u << count) - 1) : 0);
+        bits += count;
+        level = !level;
+        runStart = i;
+    }
+
+    return decodeLevels(levels, telemetry);
+}
+
+bool DShotTelemetryDecoder::decodeLevels(uint32_t levels, DShotTelemetry* telemetry)
+{
+    // Transition decode to the 20-bit GCR word
+    uint32_t gcr = (levels ^ (levels >> 1)) & 0xFFFFF;
+
+    uint16_t value = 0;
+    for (int quintet = 3; quintet >= 0; --quintet) {
+        uint8_t nibble = GCR_DECODE[(gcr >> (quintet * 5)) & 0x1F];
+        if (nibble == 0xFF) {
+            return false;
+        }
+        value = uint16_t((value << 4) | nibble);
+    }
+
+    // XOR of all nibbles including the checksum must be 0xF
+    uint16_t csum = value;
+    csum ^= csum >> 8;
+    csum ^= csum >> 4;
+    if ((csum & 0x0F) != 0x0F) {
+        return false;
+    }
+
+    telemetry->value = value >> 4;
+
+    // 0xFFF: period too long to encode, the motor is stopped
+    if (telemetry->value == 0x0FFF) {
+        telemetry->periodUs = 0;
+        telemetry->eRpm = 0;
+        return true;
+    }
+
+    telemetry->periodUs = uint32_t(telemetry->value & 0x01FF) << (telemetry->value >> 9);
+    telemetry->eRpm = telemetry->periodUs ? 60000000u / telemetry->periodUs : 0;
+    return true;
+}
+
+uint16_t DShotTelemetryDecoder::encodeWord(uint16_t value)
+{
+    value &= 0x0FFF;
+    const uint16_t csum = uint16_t(~(value ^ (value >> 4) ^ (value >> 8)) & 0x0F);
+    return uint16_t((value << 4) | csum);
+}
+
+uint32_t DShotTelemetryDecoder::encodeGcr(uint16_t word)
+{
+    uint32_t gcr = 0;
+    for (int nibble = 3; nibble >= 0; --nibble) {
+        gcr = (gcr << 5) | GCR_ENCODE[(word >> (nibble * 4)) & 0x0F];
+    }
+    return gcr;
+}
+
+uint32_t DShotTelemetryDecoder::encodeLevels(uint32_t gcr)
+{
+    // Starts low (the falling start edge), every GCR 1 toggles the line
+    uint32_t levels = 0;
+    bool level = false;
+    for (int bit = 19; bit >= 0; --bit) {
+        level ^= (gcr >> bit) & 1;
+        levels |= uint32_t(level) << bit;
+    }
+    return levels;
+}
+
+void DShotTelemetryDecoder::synthesizePacked(uint32_t levels, uint32_t samplesPerBitQ8, size_t startSample,
+                                             uint8_t* bytes, size_t sampleCount)
+{
+    for (size_t i = 0; i < (sampleCount + 7) / 8; ++i) {
+        bytes[i] = 0;
+    }
+    for (size_t i = 0; i < sampleCount; ++i) {
+        bool high = true;
+        if (i >= startSample) {
+            const uint64_t bit = (uint64_t(i - startSample) << 8) / samplesPerBitQ8;
+            if (bit < RESPONSE_BITS) {
+                high = (levels >> (RESPONSE_BITS - 1 - bit)) & 1;
+            }
+        }
+        if (high) {
+            bytes[i >> 3] |= uint8_t(0x80 >> (i & 7));
+        }
+    }
+}
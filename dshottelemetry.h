@@ -0,0 +1,56 @@
+#ifndef DSHOTTELEMETRY_H
+#define DSHOTTELEMETRY_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Bidirectional DShot eRPM telemetry.
+//
+// After each (inverted) DShot frame the ESC answers on the same wire with 21
+// bits at 5/4 of the DShot bit rate. The line levels carry a transition
+// encoding of a 20-bit GCR word: gcr = levels ^ (levels >> 1). Every 5 GCR
+// bits decode to one nibble of a 16-bit value eeem mmmm mmmm cccc, where the
+// eRPM period is m << e microseconds and cccc makes the XOR of all four
+// nibbles 0xF.
+struct DShotTelemetry {
+    uint16_t value = 0;         // 12-bit exponent/mantissa field
+    uint32_t periodUs = 0;      // electrical revolution period, 0 = motor stopped
+    uint32_t eRpm = 0;          // electrical RPM (divide by pole pairs for mechanical RPM)
+};
+
+class DShotTelemetryDecoder
+{
+public:
+    static constexpr int RESPONSE_BITS = 21;
+
+    // Decode from one sample per byte (0 = low, non-zero = high). samplesPerBit
+    // is given in 1/256 samples, e.g. 6.4 samples per bit = 1638. Returns false
+    // if no response was found, a GCR code is invalid or the checksum fails.
+    static bool decodeSamples(const uint8_t* samples, size_t sampleCount, uint32_t samplesPerBitQ8,
+                              DShotTelemetry* telemetry);
+
+    // Same for bit-packed samples, MSB first (SPI MISO capture)
+    static bool decodePacked(const uint8_t* bytes, size_t sampleCount, uint32_t samplesPerBitQ8,
+                             DShotTelemetry* telemetry);
+
+    // GCR and checksum stage: 21 line levels (MSB first) to telemetry
+    static bool decodeLevels(uint32_t levels, DShotTelemetry* telemetry);
+
+    // The ESC side, for tests and benchmarks: 12-bit value to the 16-bit word
+    // with its checksum, the word to 20 GCR bits, GCR to the 21 line levels
+    static uint16_t encodeWord(uint16_t value);
+    static uint32_t encodeGcr(uint16_t word);
+    static uint32_t encodeLevels(uint32_t gcr);
+
+    // Bit-packed capture (MSB first) of sampleCount samples: idle high, the
+    // response from sample startSample on, idle high again
+    static void synthesizePacked(uint32_t levels, uint32_t samplesPerBitQ8, size_t startSample,
+                                 uint8_t* bytes, size_t sampleCount);
+
+private:
+    template <typename SampleAt>
+    static bool decodeEdges(SampleAt sampleAt, size_t sampleCount, uint32_t samplesPerBitQ8,
+                            DShotTelemetry* telemetry);
+};
+
+#endif // DSHOTTELEMETRY_H
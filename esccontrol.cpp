@@ -1,73 +1,128 @@
 #include "esccontrol.h"
+#include "clock.h"
+#include "logger.h"
 #include <algorithm>
+#include <string>
+#include <cmath>
 #include <unistd.h>
-#include <pthread.h>
 
-ESCControl::ESCControl(int gpioPin)
+ESCControl::ESCControl(int gpioPin, PwmBackend backend)
     : m_gpioPin(gpioPin)
-    , m_pulseWidthUs(PWM_NEUTRAL_US)
+    , m_pulseWidth(PWM_NEUTRAL)
+    , m_output(PWM_NEUTRAL)
+    , m_slewRateUsPerS(0)
+    , m_slewRateQ32(0)
+    , m_rampQ16(int64_t(PWM_NEUTRAL.ticks()) << RAMP_TO_PULSE_SHIFT)
+    , m_lastRampNs(0)
     , m_isRunning(false)
+    , m_scheduler(PwmScheduler::getInstance())
+    , m_channelId(-1)
+    , m_backend(backend)
+    , m_protocol(EscProtocol::StandardPwm)
+    , m_hardwarePwmRoot(HardwarePwm::DEFAULT_SYSFS_ROOT)
+    , m_dshot3dMode(false)
+    , m_dshotBidirectional(false)
     , m_initialized(false)
 {
-    std::cout << "ESCControl created for GPIO pin " << m_gpioPin << std::endl;
+    LOG_INFO("ESCControl created for GPIO pin %d", m_gpioPin);
 }
 
 ESCControl::~ESCControl()
 {
     stop();
-    std::cout << "ESCControl destroyed for GPIO pin " << m_gpioPin << std::endl;
+    LOG_INFO("ESCControl destroyed for GPIO pin %d", m_gpioPin);
 }
 
 bool ESCControl::initialize()
 {
     if (m_initialized) {
-        std::cout << "ESC already initialized on pin " << m_gpioPin << std::endl;
+        LOG_INFO("ESC already initialized on pin %d", m_gpioPin);
         return true;
     }
 
-    // WiringPi'nin başlatıldığından emin olun (ana programda yapılmalı)
-    // wiringPiSetupGpio(); // Bu satır main'de çağrılmalı
-
-    // GPIO pinini output olarak ayarla
-    pinMode(m_gpioPin, OUTPUT);
-    digitalWrite(m_gpioPin, LOW);
+    // GPIO backend'i önceden başlatılmış olmalı (GpioHal::setup, ESCControlThread'de yapılır)
+
+    const EscProtocolTiming& timing = escProtocolTiming(m_protocol.load());
+    const int64_t neutralNs = escProtocolPulseNs(m_protocol.load(), PWM_NEUTRAL);
+
+    LOG_INFO("Initializing ESC on GPIO pin %d", m_gpioPin);
+    LOG_INFO("PWM Settings:");
+    LOG_INFO("  Protocol: %s", timing.name);
+    LOG_INFO("  Frequency: %lldHz", (long long)(1000000000 / timing.periodNs));
+    LOG_INFO("  Period: %gμs", timing.periodNs / 1000.0);
+    LOG_INFO("  Pulse range: %g-%gμs", timing.minPulseNs / 1000.0, timing.maxPulseNs / 1000.0);
+    LOG_INFO("  Neutral: %gμs", neutralNs / 1000.0);
+
+    m_pulseWidth = PWM_NEUTRAL;
+    m_output = PWM_NEUTRAL;
+    m_rampQ16.store(int64_t(PWM_NEUTRAL.ticks()) << RAMP_TO_PULSE_SHIFT, std::memory_order_relaxed);
+
+    // DShot: her frame'de scheduler thread'i sink üzerinden 16 bitlik paket gönderir
+    if (escProtocolIsDigital(m_protocol.load())) {
+        std::unique_ptr<DShotSink> sink = m_dshotSink ? std::move(m_dshotSink)
+                                                      : std::make_unique<DShotGpioSink>(m_gpioPin);
+        m_dshot = std::make_unique<DShotOutput>(std::move(sink), timing.bitRate, m_dshotBidirectional);
+        // Açılışta motor stop gönderilir: ESC ancak sıfır gaz görünce arm olur
+        // (doğrusal eşlemede neutral 1500μs yarım gaz demektir)
+        m_dshot->setValue(uint16_t(DShotCommand::MotorStop));
+        if (m_dshot3dMode) {
+            LOG_INFO("  DShot mapping: 3D (1500μs = stop), the ESC must be configured for 3D mode");
+        } else {
+            LOG_INFO("  DShot mapping: linear (1000μs = stop, 2000μs = full throttle)");
+        }
 
-    std::cout << "Initializing ESC on GPIO pin " << m_gpioPin << std::endl;
-    std::cout << "PWM Settings:" << std::endl;
-    std::cout << "  Frequency: " << PWM_FREQUENCY << "Hz" << std::endl;
-    std::cout << "  Period: " << PWM_PERIOD_US << "μs" << std::endl;
-            std::cout << "  Pulse range: " << PWM_MIN_US << "-" << PWM_MAX_US << "μs" << std::endl;
-                     std::cout << "  Neutral: " << PWM_NEUTRAL_US << "μs" << std::endl;
+        if (!m_dshot->open()) {
+            LOG_ERROR("Failed to open DShot output for pin %d", m_gpioPin);
+            m_dshot.reset();
+            return false;
+        }
 
-                         // PWM thread'ini başlat
-                         m_isRunning = true;
-    m_pulseWidthUs = PWM_NEUTRAL_US;
+        m_channelId = m_scheduler->addDigitalChannel(m_gpioPin, m_dshot.get(), timing.periodNs);
+        if (m_channelId < 0) {
+            m_dshot.reset();
+            return false;
+        }
+    }
 
-    try {
-        m_pwmThread = std::thread(&ESCControl::pwmGeneratorThread, this);
+    // Hardware PWM: period ve duty_cycle kernel'e yazılır, thread gerekmez
+    if (!m_dshot && m_backend == PwmBackend::Hardware) {
+        int channel = HardwarePwm::channelForGpio(m_gpioPin);
+        if (channel >= 0) {
+            m_hardwarePwm = std::make_unique<HardwarePwm>(HardwarePwm::DEFAULT_CHIP, channel, m_hardwarePwmRoot);
+        }
 
-        // Thread'e yüksek öncelik ver
-        pthread_t nativeHandle = m_pwmThread.native_handle();
-        struct sched_param params;
-        params.sched_priority = sched_get_priority_max(SCHED_FIFO);
+        if (m_hardwarePwm && m_hardwarePwm->open(timing.periodNs, neutralNs)) {
+            LOG_INFO("  Backend: hardware PWM");
+        } else {
+            LOG_WARNING("Warning: Hardware PWM not available on pin %d, falling back to software PWM", m_gpioPin);
+            m_hardwarePwm.reset();
+            m_backend = PwmBackend::Software;
+        }
+    }
 
-        if (pthread_setschedparam(nativeHandle, SCHED_FIFO, &params) != 0) {
-            std::cout << "Warning: Could not set high priority for PWM thread" << std::endl;
+    // Ortak PWM scheduler'ına kanal olarak ekle
+    if (!m_dshot && m_backend == PwmBackend::Software) {
+        // GPIO pinini output olarak ayarla (hardware PWM'de pin PWM fonksiyonunda kalmalı)
+        if (!GpioHal::getInstance()->configureOutput(m_gpioPin)) {
+            LOG_ERROR("Failed to configure GPIO pin %d", m_gpioPin);
+            return false;
         }
 
-        m_initialized = true;
+        m_channelId = m_scheduler->addChannel(m_gpioPin, neutralNs, timing.periodNs, timing.toleranceNs);
+        if (m_channelId < 0) {
+            LOG_ERROR("Failed to add PWM channel for pin %d", m_gpioPin);
+            return false;
+        }
+    }
 
-        // ESC'nin neutral sinyali tanıması için kısa bir bekleme
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    m_isRunning = true;
+    m_initialized = true;
 
-        std::cout << "ESC initialization complete on pin " << m_gpioPin << std::endl;
-        return true;
+    // ESC'nin neutral sinyali tanıması için kısa bir bekleme
+    Clock::getInstance()->sleepForNs(1000000000LL);
 
-    } catch (const std::exception& e) {
-        std::cerr << "Failed to start PWM thread: " << e.what() << std::endl;
-        m_isRunning = false;
-        return false;
-    }
+    LOG_INFO("ESC initialization complete on pin %d", m_gpioPin);
+    return true;
 }
 
 void ESCControl::stop()
@@ -76,41 +131,198 @@ void ESCControl::stop()
         return;
     }
 
-    std::cout << "Stopping ESC on pin " << m_gpioPin << std::endl;
+    LOG_INFO("Stopping ESC on pin %d", m_gpioPin);
 
-    // Önce neutral pozisyona getir
-    setNeutral();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Önce neutral pozisyona getir (rampa beklenmez)
+    setPulseWidth(PWM_NEUTRAL, true);
+    Clock::getInstance()->sleepForNs(100000000LL);
 
-    // PWM thread'ini durdur
+    // Kanalı scheduler'dan çıkar
     m_isRunning = false;
-
-    if (m_pwmThread.joinable()) {
-        m_pwmThread.join();
+    m_scheduler->removeChannel(m_channelId);
+    m_channelId = -1;
+
+    if (m_dshot) {
+        m_dshot->close();
+        m_dshot.reset();
+    } else if (m_hardwarePwm) {
+        m_hardwarePwm->close();
+    } else {
+        // Pin'i LOW pozisyonuna getir ve bırak
+        GpioHal::getInstance()->releasePin(m_gpioPin);
     }
 
-    // Pin'i LOW pozisyonuna getir
-    digitalWrite(m_gpioPin, LOW);
-
     m_initialized = false;
-    std::cout << "ESC stopped on pin " << m_gpioPin << std::endl;
+    LOG_INFO("ESC stopped on pin %d", m_gpioPin);
 }
 
-void ESCControl::setPulseWidth(int pulseWidthUs)
+void ESCControl::setPulseWidth(int pulseWidthUs, bool immediate)
 {
-    int constrainedWidth = constrainPulseWidth(pulseWidthUs);
-    m_pulseWidthUs = constrainedWidth;
+    setPulseWidth(PulseWidth::fromUs(pulseWidthUs), immediate);
+}
+
+void ESCControl::setPulseWidth(PulseWidth pulseWidth, bool immediate)
+{
+    PwmScheduler::PulseUpdate update;
+    if (stagePulseWidth(pulseWidth, &update, immediate)) {
+        m_scheduler->setPulseWidth(update.channelId, update.pulseWidthNs);
+    }
 
     // std::cout << "ESC pin " << m_gpioPin << ": Pulse width set to "
-    //           << constrainedWidth << "μs" << std::endl;
+    //           << pulseWidth.microseconds() << "μs" << std::endl;
+}
+
+bool ESCControl::stagePulseWidth(PulseWidth pulseWidth, PwmScheduler::PulseUpdate* update, bool immediate)
+{
+    PulseWidth constrainedWidth = constrainPulseWidth(pulseWidth);
+    m_pulseWidth = constrainedWidth;
+
+    // Slew limiti açıksa çıkışı stageRamp() hedefe taşır
+    if (!immediate && m_slewRateQ32.load(std::memory_order_relaxed) != 0) {
+        return false;
+    }
+
+    // Rampa bir sonraki adımda buradan devam eder; stop() ile yarışan bir
+    // adım eski konumu yazsa da sonraki adımlar yine hedefe gider
+    m_rampQ16.store(int64_t(constrainedWidth.ticks()) << RAMP_TO_PULSE_SHIFT, std::memory_order_relaxed);
+    return stageOutput(constrainedWidth, update);
+}
+
+void ESCControl::setSlewRate(int usPerSecond)
+{
+    usPerSecond = std::max(0, std::min(MAX_SLEW_RATE_US_PER_S, usPerSecond));
+    m_slewRateUsPerS = usPerSecond;
+
+    // μs/s -> Q32 μs/ns, frame başına adım tek çarpma ve kaydırma ile bulunur
+    m_slewRateQ32.store((int64_t(usPerSecond) << 32) / 1000000000, std::memory_order_relaxed);
+
+    if (usPerSecond) {
+        LOG_INFO("ESC pin %d: slew limit %dμs/s", m_gpioPin, usPerSecond);
+    } else {
+        LOG_INFO("ESC pin %d: slew limit off", m_gpioPin);
+    }
+}
+
+bool ESCControl::stageRamp(int64_t nowNs, PwmScheduler::PulseUpdate* update)
+{
+    const int64_t elapsedNs = std::min(nowNs - m_lastRampNs, MAX_RAMP_STEP_NS);
+    m_lastRampNs = nowNs;
+
+    const int64_t targetQ16 = int64_t(m_pulseWidth.load().ticks()) << RAMP_TO_PULSE_SHIFT;
+    int64_t rampQ16 = m_rampQ16.load(std::memory_order_relaxed);
+    if (rampQ16 == targetQ16 || elapsedNs <= 0) {
+        return false;
+    }
+
+    // Limit kapatıldıysa rampa yarıda kalmasın, hedefe atla
+    const int64_t rateQ32 = m_slewRateQ32.load(std::memory_order_relaxed);
+    if (rateQ32 == 0) {
+        rampQ16 = targetQ16;
+    } else {
+        const int64_t stepQ16 = (rateQ32 * elapsedNs) >> (32 - RAMP_FRACTION_BITS);
+        if (targetQ16 > rampQ16) {
+            rampQ16 = std::min(targetQ16, rampQ16 + stepQ16);
+        } else {
+            rampQ16 = std::max(targetQ16, rampQ16 - stepQ16);
+        }
+    }
+    m_rampQ16.store(rampQ16, std::memory_order_relaxed);
+
+    // Çıkış 1/16μs çözünürlükte, değişmeyen adım yazılmaz
+    const PulseWidth output = PulseWidth::fromTicks(
+        int32_t((rampQ16 + (int64_t(1) << (RAMP_TO_PULSE_SHIFT - 1))) >> RAMP_TO_PULSE_SHIFT));
+    if (output == m_output.load()) {
+        return false;
+    }
+    return stageOutput(output, update);
+}
+
+bool ESCControl::stageOutput(PulseWidth output, PwmScheduler::PulseUpdate* update)
+{
+    m_output = output;
+
+    if (m_dshot) {
+        m_dshot->setValue(DShotEncoder::commandToValue(output, m_dshot3dMode));
+        return false;
+    }
+
+    // Komut değerini aktif protokolün pulse aralığına çevir (kesirli kısım korunur)
+    int64_t outputNs = escProtocolPulseNs(m_protocol.load(), output);
+
+    if (m_hardwarePwm) {
+        m_hardwarePwm->setDutyCycle(outputNs);
+        return false;
+    }
+
+    update->channelId = m_channelId;
+    update->pulseWidthNs = int(outputNs);
+    return true;
 }
 
-void ESCControl::setThrottle(int throttlePercent)
+void ESCControl::setProtocol(EscProtocol protocol)
+{
+    if (m_protocol.load() == protocol) {
+        return;
+    }
+
+    // DShot kanalı farklı bir çıkış katmanı kullanır, değişiklik için yeniden başlatılmalı
+    if (m_initialized && (escProtocolIsDigital(protocol) || escProtocolIsDigital(m_protocol.load()))) {
+        LOG_ERROR("ESC pin %d: DShot protocol can only be changed before initialize()", m_gpioPin);
+        return;
+    }
+    m_protocol = protocol;
+
+    const EscProtocolTiming& timing = escProtocolTiming(protocol);
+    LOG_INFO("ESC pin %d: protocol set to %s", m_gpioPin, timing.name);
+
+    if (!m_initialized) {
+        return;
+    }
+
+    // Yeni periyodu uygula, sonra mevcut komutu yeni aralıkta tekrar yaz
+    int64_t outputNs = escProtocolPulseNs(protocol, m_output.load());
+
+    if (m_hardwarePwm) {
+        m_hardwarePwm->close();
+        if (!m_hardwarePwm->open(timing.periodNs, outputNs)) {
+            LOG_ERROR("Failed to reopen hardware PWM on pin %d", m_gpioPin);
+        }
+    } else {
+        m_scheduler->setPulseWidth(m_channelId, outputNs);
+        m_scheduler->setChannelTiming(m_channelId, timing.periodNs, timing.toleranceNs);
+    }
+}
+
+void ESCControl::setDShotSink(std::unique_ptr<DShotSink> sink)
+{
+    m_dshotSink = std::move(sink);
+}
+
+uint32_t ESCControl::getERpm() const
+{
+    return m_dshot ? m_dshot->getERpm() : 0;
+}
+
+uint64_t ESCControl::getTelemetryErrorCount() const
+{
+    return m_dshot ? m_dshot->getTelemetryErrorCount() : 0;
+}
+
+void ESCControl::sendDShotCommand(DShotCommand command, int repeat)
+{
+    if (!m_dshot) {
+        LOG_ERROR("ESC pin %d: DShot command needs a DShot protocol", m_gpioPin);
+        return;
+    }
+    m_dshot->queueCommand(command, repeat);
+}
+
+void ESCControl::setThrottle(double throttlePercent)
 {
     // Throttle'ı -100 ile +100 arasında sınırla
-    throttlePercent = std::max(-100, std::min(100, throttlePercent));
+    throttlePercent = std::max(-100.0, std::min(100.0, throttlePercent));
 
-    int pulseWidth = throttleToPulseWidth(throttlePercent);
+    PulseWidth pulseWidth = throttleToPulseWidth(throttlePercent);
     setPulseWidth(pulseWidth);
 
     // std::cout << "ESC pin " << m_gpioPin << ": Throttle set to "
@@ -137,7 +349,7 @@ void ESCControl::setReverse(int power)
 
 void ESCControl::setNeutral()
 {
-    setPulseWidth(PWM_NEUTRAL_US);
+    setPulseWidth(PWM_NEUTRAL);
     // std::cout << "ESC pin " << m_gpioPin << ": Set to neutral position" << std::endl;
 }
 
@@ -148,76 +360,35 @@ bool ESCControl::isRunning() const
 
 int ESCControl::getCurrentPulseWidth() const
 {
-    return m_pulseWidthUs.load();
+    return m_pulseWidth.load().roundedUs();
 }
 
-void ESCControl::pwmGeneratorThread()
+int64_t ESCControl::getOutputPulseWidthNs() const
 {
-    std::cout << "PWM thread started for GPIO pin " << m_gpioPin << std::endl;
-
-    // Sleep overhead'ini ölç
-    auto start = std::chrono::high_resolution_clock::now();
-    std::this_thread::sleep_for(std::chrono::microseconds(100));
-    auto end = std::chrono::high_resolution_clock::now();
-
-    int overhead = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() - 100;
-    overhead = std::max(0, overhead);
-
-    std::cout << "PWM thread overhead: " << overhead << "μs" << std::endl;
-
-        while (m_isRunning.load()) {
-        auto cycleStart = std::chrono::high_resolution_clock::now();
-
-        // Mevcut pulse width'i al
-        int currentPulseWidth = m_pulseWidthUs.load();
-
-        // Pin'i HIGH yap
-        digitalWrite(m_gpioPin, HIGH);
-
-        // Pulse süresi kadar bekle
-        if (currentPulseWidth > overhead) {
-            std::this_thread::sleep_for(std::chrono::microseconds(currentPulseWidth - overhead));
-        }
-
-        // Kesin timing için spin-wait
-        while (std::chrono::duration_cast<std::chrono::microseconds>(
-                   std::chrono::high_resolution_clock::now() - cycleStart).count() < currentPulseWidth) {
-            // Busy wait
-        }
-
-        // Pin'i LOW yap
-        digitalWrite(m_gpioPin, LOW);
-
-        // Pulse süresini hesapla
-        auto pulseTime = std::chrono::duration_cast<std::chrono::microseconds>(
-                             std::chrono::high_resolution_clock::now() - cycleStart).count();
-
-        // Periyodun geri kalanını bekle
-        int remainingTime = PWM_PERIOD_US - pulseTime;
-        if (remainingTime > overhead) {
-            std::this_thread::sleep_for(std::chrono::microseconds(remainingTime - overhead));
-        }
+    return escProtocolPulseNs(m_protocol.load(), m_output.load());
+}
 
-        // Bir sonraki cycle için kesin timing
-        while (std::chrono::duration_cast<std::chrono::microseconds>(
-                   std::chrono::high_resolution_clock::now() - cycleStart).count() < PWM_PERIOD_US) {
-            // Busy wait
-        }
-    }
+TimingSummary ESCControl::getPulseErrorStats() const
+{
+    return m_scheduler->getPulseErrorStats(m_channelId);
+}
 
-    std::cout << "PWM thread stopped for GPIO pin " << m_gpioPin << std::endl;
+uint64_t ESCControl::getMissedDeadlineCount() const
+{
+    return m_scheduler->getMissedDeadlineCount(m_channelId);
 }
 
-int ESCControl::constrainPulseWidth(int pulseWidthUs)
+PulseWidth ESCControl::constrainPulseWidth(PulseWidth pulseWidth)
 {
-    return std::max(PWM_MIN_US, std::min(PWM_MAX_US, pulseWidthUs));
+    return pulseWidth.clamped(PWM_MIN, PWM_MAX);
 }
 
-int ESCControl::throttleToPulseWidth(int throttlePercent)
+PulseWidth ESCControl::throttleToPulseWidth(double throttlePercent)
 {
     // Throttle'ı -100 ile +100 arasında sınırla
-    throttlePercent = std::max(-100, std::min(100, throttlePercent));
+    throttlePercent = std::max(-100.0, std::min(100.0, throttlePercent));
 
-    // -100 => 1000μs, 0 => 1500μs, 100 => 2000μs
-    return PWM_NEUTRAL_US + (throttlePercent * (PWM_MAX_US - PWM_NEUTRAL_US) / 100);
+    // -100 => 1000μs, 0 => 1500μs, 100 => 2000μs; %1 = 80 tick, bölmede çözünürlük kaybı yok
+    const double ticksPerPercent = (PWM_MAX.ticks() - PWM_NEUTRAL.ticks()) / 100.0;
+    return PulseWidth::fromTicks(PWM_NEUTRAL.ticks() + int32_t(std::lround(throttlePercent * ticksPerPercent)));
 }
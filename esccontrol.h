@@ -5,28 +5,79 @@
 #include <atomic>
 #include <chrono>
 #include <iostream>
-#include <wiringPi.h>
+#include <memory>
+#include <string>
+#include "pwmscheduler.h"
+#include "hardwarepwm.h"
+#include "escprotocol.h"
+#include "dshot.h"
+#include "gpiohal.h"
+
+// PWM sinyalinin nasıl üretileceği
+enum class PwmBackend {
+    Software,       // PwmScheduler thread'i ile bit-bang
+    Hardware        // Kernel PWM (/sys/class/pwm), pulse başına CPU maliyeti yok
+};
 
 class ESCControl
 {
 public:
-    // Constructor - GPIO pin numarasını alır
-    explicit ESCControl(int gpioPin);
+    // Constructor - GPIO pin numarasını ve PWM backend'ini alır
+    explicit ESCControl(int gpioPin, PwmBackend backend = PwmBackend::Software);
 
     // Destructor
     ~ESCControl();
 
-    // ESC'yi başlat (wiringPi initialization ve PWM thread başlatma)
+    // ESC'yi başlat (GPIO ayarı ve PwmScheduler'a kanal ekleme)
     bool initialize();
 
     // ESC'yi durdur
     void stop();
 
-    // PWM değerini ayarla (1000-2000 mikrosaniye arası)
-    void setPulseWidth(int pulseWidthUs);
+    // PWM değerini ayarla (1000-2000 mikrosaniye arası, aktif protokole göre ölçeklenir).
+    // Slew limiti açıksa sadece hedef değişir, immediate = true rampayı atlar
+    void setPulseWidth(PulseWidth pulseWidth, bool immediate = false);
+    void setPulseWidth(int pulseWidthUs, bool immediate = false);
+
+    // setPulseWidth'in toplu hali: software kanalında scheduler'a yazmak yerine
+    // update'i doldurup true döner (çağıran hepsini tek seferde commit eder),
+    // DShot ve hardware kanalında değeri hemen uygular ve false döner
+    bool stagePulseWidth(PulseWidth pulseWidth, PwmScheduler::PulseUpdate* update, bool immediate = false);
+
+    // Slew limiti (μs/s, 0 = kapalı). Açıkken çıkış hedefe stageRamp() ile yaklaşır
+    void setSlewRate(int usPerSecond);
+    int getSlewRate() const { return m_slewRateUsPerS.load(); }
+
+    // Rampayı nowNs'e (Clock zamanı) kadar ilerlet, her PWM frame'inde çağrılır.
+    // Çıkış değiştiyse stagePulseWidth gibi update'i doldurur
+    bool stageRamp(int64_t nowNs, PwmScheduler::PulseUpdate* update);
+
+    // ESC protokolünü seç (StandardPwm, OneShot125, OneShot42, Multishot)
+    void setProtocol(EscProtocol protocol);
+    EscProtocol getProtocol() const { return m_protocol.load(); }
+
+    // Hardware PWM sysfs kökü (varsayılan /sys/class/pwm), initialize()'dan önce çağrılmalı
+    void setHardwarePwmRoot(const std::string& sysfsRoot) { m_hardwarePwmRoot = sysfsRoot; }
+
+    // DShot çıkış katmanı (varsayılan: GPIO bit-bang), initialize()'dan önce çağrılmalı
+    void setDShotSink(std::unique_ptr<DShotSink> sink);
+
+    // DShot 3D modu: 1500μs = motor durur, altı geri, üstü ileri (varsayılan kapalı:
+    // 1000μs = stop, 2000μs = tam gaz). ESC'nin 3D moda ayarlanmış olması gerekir.
+    void setDShot3DMode(bool enabled) { m_dshot3dMode = enabled; }
 
-    // Throttle değerini ayarla (-100 ile +100 arası, 0 = neutral)
-    void setThrottle(int throttlePercent);
+    // Çift yönlü DShot: her frame sonrası ESC'nin eRPM cevabını oku, initialize()'dan önce çağrılmalı
+    void setDShotBidirectional(bool enabled) { m_dshotBidirectional = enabled; }
+
+    // Son çözülen elektriksel RPM (çift yönlü DShot, yoksa 0) ve hatalı cevap sayısı
+    uint32_t getERpm() const;
+    uint64_t getTelemetryErrorCount() const;
+
+    // DShot özel komutu gönder (beep, yön, 3D modu...)
+    void sendDShotCommand(DShotCommand command, int repeat = 1);
+
+    // Throttle değerini ayarla (-100 ile +100 arası, 0 = neutral, kesirli değerler 1/16μs'ye yuvarlanır)
+    void setThrottle(double throttlePercent);
 
     // Forward hareket (0-100 arası değer)
     void setForward(int power);
@@ -40,31 +91,63 @@ public:
     // ESC'nin çalışır durumda olup olmadığını kontrol et
     bool isRunning() const;
 
-    // Mevcut pulse width değerini al
+    // Mevcut pulse width değerini al (1000-2000μs komut değeri, rampanın hedefi)
     int getCurrentPulseWidth() const;
+    PulseWidth getPulseWidth() const { return m_pulseWidth.load(); }
+
+    // Rampadan çıkan, pine verilen komut değeri (1000-2000μs)
+    PulseWidth getOutputPulseWidth() const { return m_output.load(); }
+
+    // Pine verilen gerçek pulse süresi (nanosaniye, protokole göre)
+    int64_t getOutputPulseWidthNs() const;
+
+    // Ölçülen pulse süresi hatası ve kaçırılan deadline sayısı (sadece software backend)
+    TimingSummary getPulseErrorStats() const;
+    uint64_t getMissedDeadlineCount() const;
+
+    // Aktif PWM backend'i (hardware açılamazsa software'e düşer)
+    PwmBackend getBackend() const { return m_backend; }
 
 private:
-    // PWM sabitleri
-    static constexpr int PWM_FREQUENCY = 50;        // 50Hz (20ms period)
-    static constexpr int PWM_PERIOD_US = 20000;     // 20ms in microseconds
-    static constexpr int PWM_MIN_US = 1000;         // 1ms minimum pulse
-    static constexpr int PWM_NEUTRAL_US = 1500;     // 1.5ms neutral pulse
-    static constexpr int PWM_MAX_US = 2000;         // 2ms maximum pulse
+    // PWM komut sabitleri (çıkış süresi protokol tablosundan gelir)
+    static constexpr PulseWidth PWM_MIN = PulseWidth::fromUs(1000);       // 1ms minimum pulse
+    static constexpr PulseWidth PWM_NEUTRAL = PulseWidth::fromUs(1500);   // 1.5ms neutral pulse
+    static constexpr PulseWidth PWM_MAX = PulseWidth::fromUs(2000);       // 2ms maximum pulse
+
+    // Rampa sabit noktalı hesaplanır: konum Q16 μs, hız Q32 μs/ns
+    static constexpr int RAMP_FRACTION_BITS = 16;
+    static constexpr int RAMP_TO_PULSE_SHIFT = RAMP_FRACTION_BITS - PulseWidth::FRACTION_BITS;
+    static constexpr int MAX_SLEW_RATE_US_PER_S = 1000000;
+    static constexpr int64_t MAX_RAMP_STEP_NS = 50000000;  // kaçırılan frame'ler tek adımda telafi edilmez
 
-    // PWM thread fonksiyonu
-    void pwmGeneratorThread();
+    // Komut değerini çıkış katmanına yaz (DShot/hardware hemen, software update ile)
+    bool stageOutput(PulseWidth output, PwmScheduler::PulseUpdate* update);
 
     // Pulse width'i sınırlar içinde tutar
-    int constrainPulseWidth(int pulseWidthUs);
+    PulseWidth constrainPulseWidth(PulseWidth pulseWidth);
 
     // Throttle'ı pulse width'e çevirir
-    int throttleToPulseWidth(int throttlePercent);
+    PulseWidth throttleToPulseWidth(double throttlePercent);
 
     // Üye değişkenler
     int m_gpioPin;                          // Kullanılacak GPIO pin
-    std::atomic<int> m_pulseWidthUs;        // Mevcut pulse width (mikrosaniye)
-    std::atomic<bool> m_isRunning;          // PWM thread çalışıyor mu?
-    std::thread m_pwmThread;                // PWM üretici thread
+    std::atomic<PulseWidth> m_pulseWidth;   // Mevcut pulse width (1/16 mikrosaniye)
+    std::atomic<PulseWidth> m_output;       // Rampanın pine verdiği değer
+    std::atomic<int> m_slewRateUsPerS;      // Slew limiti, 0 = kapalı
+    std::atomic<int64_t> m_slewRateQ32;     // Aynı limit, Q32 μs/ns
+    std::atomic<int64_t> m_rampQ16;         // Rampa konumu (Q16 μs), stop() başka thread'den de yazar
+    int64_t m_lastRampNs;                   // Son rampa adımının zamanı, sadece stageRamp() yazar
+    std::atomic<bool> m_isRunning;          // PWM kanalı aktif mi?
+    PwmScheduler *m_scheduler;              // Tüm kanalları süren ortak PWM thread'i
+    int m_channelId;                        // Scheduler kanal numarası
+    PwmBackend m_backend;                   // Seçili PWM backend
+    std::atomic<EscProtocol> m_protocol;    // Seçili ESC protokolü
+    std::string m_hardwarePwmRoot;          // Hardware PWM sysfs kökü
+    std::unique_ptr<HardwarePwm> m_hardwarePwm; // Hardware backend kanalı
+    std::unique_ptr<DShotSink> m_dshotSink;     // Kullanıcının verdiği DShot sink'i
+    std::unique_ptr<DShotOutput> m_dshot;       // DShot kanalı
+    bool m_dshot3dMode;                     // DShot 3D (çift yönlü) eşleme
+    bool m_dshotBidirectional;              // DShot eRPM telemetrisi açık mı?
     bool m_initialized;                     // Başlatılmış mı?
 };
 
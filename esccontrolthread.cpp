@@ -1,105 +1,191 @@
 #include "esccontrolthread.h"
-#include <iostream>
 #include <algorithm>
-#include <wiringPi.h>
+#include "gpiohal.h"
+#include "clock.h"
+#include "logger.h"
+#include "flightrecorder.h"
+#include <unistd.h>
 
 // PWM constants (should match ESCControl constants)
-static constexpr int PWM_NEUTRAL_US = 1500;
-static constexpr int PWM_MIN_US = 1000;
-static constexpr int PWM_MAX_US = 2000;
-
-ESCControlThread::ESCControlThread()
-    : m_isRunning(false)
+static constexpr PulseWidth PWM_NEUTRAL = PulseWidth::fromUs(1500);
+static constexpr PulseWidth PWM_MIN = PulseWidth::fromUs(1000);
+static constexpr PulseWidth PWM_MAX = PulseWidth::fromUs(2000);
+
+// Command latency spans up to a few frames, 100μs buckets cover 25ms
+static constexpr int64_t COMMAND_LATENCY_BUCKET_NS = 100000;
+
+// Supervision loop interval
+static constexpr int SAFETY_CHECK_INTERVAL_MS = 50;
+
+// Failsafe reaction is bounded by one frame (20ms) plus the ramp, 100μs buckets
+static constexpr int64_t FAILSAFE_REACTION_BUCKET_NS = 100000;
+
+// Ramp step interval of the supervision loop when no PWM frames run (hardware PWM frame)
+static constexpr int RAMP_INTERVAL_MS = 20;
+
+ESCControlThread::ESCControlThread(PwmBackend backend)
+    : m_backend(backend)
+    , m_hardwarePwmRoot(HardwarePwm::DEFAULT_SYSFS_ROOT)
+    , m_protocol(EscProtocol::StandardPwm)
+    , m_dshotBidirectional(false)
+    , m_dshot3dMode(false)
+    , m_slewRates{0, 0, 0, 0}
+    , m_isRunning(false)
+    , m_threadAttached(false)
     , m_initialized(false)
-    , m_hasNewCommand(false)
+    , m_appliedSequence(0)
+    , m_deferredUpdateCount(0)
+    , m_commandLatency(COMMAND_LATENCY_BUCKET_NS)
+    , m_submittedCommands(0)
+    , m_skippedCommands(0)
+    , m_commandTimeoutNs(0)
+    , m_failsafeMode(FailsafeMode::Jump)
+    , m_lastCommandNs(0)
+    , m_failsafeActive(false)
+    , m_neutralApplied(true)
+    , m_failsafeCount(0)
+    , m_failsafeReaction(FAILSAFE_REACTION_BUCKET_NS)
 {
-    std::cout << "ESCControlThread created for 4 ESCs" << std::endl;
+    LOG_INFO("ESCControlThread created for 4 ESCs");
 }
 
 ESCControlThread::~ESCControlThread()
 {
     stop();
-    std::cout << "ESCControlThread destroyed" << std::endl;
+    LOG_INFO("ESCControlThread destroyed");
 }
 
 bool ESCControlThread::initialize()
 {
     if (m_initialized.load()) {
-        std::cout << "ESCControlThread already initialized" << std::endl;
+        LOG_INFO("ESCControlThread already initialized");
         return true;
     }
 
-    std::cout << "Initializing ESCControlThread for 4 ESCs..." << std::endl;
+    LOG_INFO("Initializing ESCControlThread for 4 ESCs...");
 
-    // Initialize WiringPi
-    if (wiringPiSetupGpio() == -1) {
-        std::cerr << "Failed to initialize WiringPi" << std::endl;
+    // The virtual backend only stands in for missing hardware when asked for
+    GpioHal* gpio = GpioHal::getInstance();
+    if (gpio->type() == GpioBackendType::Virtual && !GpioHal::isSelected()) {
+        LOG_ERROR("Refusing to drive the ESCs on the virtual GPIO backend, no GPIO driver is compiled in");
+        return false;
+    }
+
+    // Initialize the GPIO backend
+    if (!gpio->setup()) {
+        LOG_ERROR("Failed to initialize GPIO");
         return false;
     }
-    std::cout << "WiringPi initialized successfully" << std::endl;
 
     // Create all 4 ESC instances
     try {
-        m_esc1 = std::make_unique<ESCControl>(PIN_ESC_1);
-        m_esc2 = std::make_unique<ESCControl>(PIN_ESC_2);
-        m_esc3 = std::make_unique<ESCControl>(PIN_ESC_3);
-        m_esc4 = std::make_unique<ESCControl>(PIN_ESC_4);
+        m_esc1 = std::make_unique<ESCControl>(PIN_ESC_1, m_backend);
+        m_esc2 = std::make_unique<ESCControl>(PIN_ESC_2, m_backend);
+        m_esc3 = std::make_unique<ESCControl>(PIN_ESC_3, m_backend);
+        m_esc4 = std::make_unique<ESCControl>(PIN_ESC_4, m_backend);
     } catch (const std::exception& e) {
-        std::cerr << "Failed to create ESC instances: " << e.what() << std::endl;
+        LOG_ERROR("Failed to create ESC instances: %s", e.what());
         return false;
     }
 
+    // Protocol has to be set before the channels are registered
+    m_esc1->setProtocol(m_protocol);
+    m_esc2->setProtocol(m_protocol);
+    m_esc3->setProtocol(m_protocol);
+    m_esc4->setProtocol(m_protocol);
+
+    m_esc1->setHardwarePwmRoot(m_hardwarePwmRoot);
+    m_esc2->setHardwarePwmRoot(m_hardwarePwmRoot);
+    m_esc3->setHardwarePwmRoot(m_hardwarePwmRoot);
+    m_esc4->setHardwarePwmRoot(m_hardwarePwmRoot);
+
+    m_esc1->setSlewRate(m_slewRates[0]);
+    m_esc2->setSlewRate(m_slewRates[1]);
+    m_esc3->setSlewRate(m_slewRates[2]);
+    m_esc4->setSlewRate(m_slewRates[3]);
+
+    // Bidirectional DShot reads the response back over SPI, one bus per ESC.
+    // DShot300/600 bits (3.3/1.7μs) are too short to bit-bang on a real GPIO
+    // backend, they go through the same buses and fail without them; the
+    // virtual backend simulates them on the GPIO sink.
+    if (escProtocolIsDigital(m_protocol)) {
+        const EscProtocolTiming& timing = escProtocolTiming(m_protocol);
+        const bool fastDShot = timing.bitRate >= DSHOT_SPI_MIN_BIT_RATE;
+        const bool virtualGpio = GpioHal::getInstance()->type() == GpioBackendType::Virtual;
+        ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+        for (int i = 0; i < 4; ++i) {
+            escs[i]->setDShot3DMode(m_dshot3dMode);
+            if (m_dshotBidirectional) {
+                escs[i]->setDShotSink(std::make_unique<DShotSpiSink>(DSHOT_SPI_DEVICES[i]));
+                escs[i]->setDShotBidirectional(true);
+            } else if (fastDShot && !virtualGpio) {
+                if (access(DSHOT_SPI_DEVICES[i], F_OK) != 0) {
+                    LOG_ERROR("%s on ESC%d needs the SPI bus %s, GPIO bit-banging cannot meet its bit timing; "
+                              "enable the SPI overlays or use dshot150", timing.name, i + 1, DSHOT_SPI_DEVICES[i]);
+                    return false;
+                }
+                escs[i]->setDShotSink(std::make_unique<DShotSpiSink>(DSHOT_SPI_DEVICES[i]));
+            }
+        }
+    }
+
     // Initialize all ESCs
     if (!m_esc1->initialize()) {
-        std::cerr << "Failed to initialize ESC1 on pin " << PIN_ESC_1 << std::endl;
+        LOG_ERROR("Failed to initialize ESC1 on pin %d", PIN_ESC_1);
         return false;
     }
 
     if (!m_esc2->initialize()) {
-        std::cerr << "Failed to initialize ESC2 on pin " << PIN_ESC_2 << std::endl;
+        LOG_ERROR("Failed to initialize ESC2 on pin %d", PIN_ESC_2);
         m_esc1->stop(); // Clean up ESC1 if ESC2 fails
         return false;
     }
 
     if (!m_esc3->initialize()) {
-        std::cerr << "Failed to initialize ESC3 on pin " << PIN_ESC_3 << std::endl;
+        LOG_ERROR("Failed to initialize ESC3 on pin %d", PIN_ESC_3);
         m_esc1->stop();
         m_esc2->stop();
         return false;
     }
 
     if (!m_esc4->initialize()) {
-        std::cerr << "Failed to initialize ESC4 on pin " << PIN_ESC_4 << std::endl;
+        LOG_ERROR("Failed to initialize ESC4 on pin %d", PIN_ESC_4);
         m_esc1->stop();
         m_esc2->stop();
         m_esc3->stop();
         return false;
     }
 
-    // Initialize command structure with neutral positions
-    m_currentCommand.esc1PulseWidth = PWM_NEUTRAL_US;
-    m_currentCommand.esc2PulseWidth = PWM_NEUTRAL_US;
-    m_currentCommand.esc3PulseWidth = PWM_NEUTRAL_US;
-    m_currentCommand.esc4PulseWidth = PWM_NEUTRAL_US;
-    m_currentCommand.emergencyStop = false;
-    m_currentCommand.timestamp = std::chrono::steady_clock::now();
-    m_lastCommand = m_currentCommand;
+    // Initialize command slot with neutral positions
+    ESCCommand neutral;
+    neutral.timestampNs = Clock::getInstance()->nowNs();
+    m_command.store(neutral);
+    m_failsafeActive = false;
+    commandReceived();
 
-    // Start the control thread
+    // Commands are latched by the PWM thread at every frame start
+    PwmScheduler::getInstance()->setFrameListener(this);
+
+    // Start the supervision thread
     m_isRunning = true;
     try {
+        m_threadAttached = false;
         m_controlThread = std::thread(&ESCControlThread::controlThreadFunction, this);
+        while (!m_threadAttached.load()) {
+            std::this_thread::yield();
+        }
 
         // Give the thread a moment to start
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        Clock::getInstance()->sleepForNs(100000000LL);
 
         m_initialized = true;
-        std::cout << "ESCControlThread initialization complete for all 4 ESCs" << std::endl;
+        LOG_INFO("ESCControlThread initialization complete for all 4 ESCs");
         return true;
 
     } catch (const std::exception& e) {
-        std::cerr << "Failed to start control thread: " << e.what() << std::endl;
+        LOG_ERROR("Failed to start control thread: %s", e.what());
         m_isRunning = false;
+        PwmScheduler::getInstance()->setFrameListener(nullptr);
         m_esc1->stop();
         m_esc2->stop();
         m_esc3->stop();
@@ -114,21 +200,16 @@ void ESCControlThread::stop()
         return;
     }
 
-    std::cout << "Stopping ESCControlThread..." << std::endl;
+    LOG_INFO("Stopping ESCControlThread...");
 
     // First set all ESCs to neutral
+    m_trajectory.clear();
     setAllNeutral();
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Clock::getInstance()->sleepForNs(100000000LL);
 
-    // Stop the control thread
+    // Stop the control thread and detach from the PWM frames
     m_isRunning = false;
-
-    // Wake up the control thread if it's waiting
-    {
-        std::lock_guard<std::mutex> lock(m_commandMutex);
-        m_hasNewCommand = true;
-    }
-    m_commandCondition.notify_all();
+    PwmScheduler::getInstance()->setFrameListener(nullptr);
 
     // Wait for the control thread to finish
     if (m_controlThread.joinable()) {
@@ -150,7 +231,7 @@ void ESCControlThread::stop()
     }
 
     m_initialized = false;
-    std::cout << "ESCControlThread stopped" << std::endl;
+    LOG_INFO("ESCControlThread stopped");
 }
 
 bool ESCControlThread::isRunning() const
@@ -158,76 +239,168 @@ bool ESCControlThread::isRunning() const
     return m_isRunning.load() && m_initialized.load();
 }
 
+void ESCControlThread::setProtocol(EscProtocol protocol)
+{
+    m_protocol = protocol;
+
+    if (m_esc1) m_esc1->setProtocol(protocol);
+    if (m_esc2) m_esc2->setProtocol(protocol);
+    if (m_esc3) m_esc3->setProtocol(protocol);
+    if (m_esc4) m_esc4->setProtocol(protocol);
+}
+
+void ESCControlThread::setSlewRate(int escNumber, int usPerSecond)
+{
+    if (escNumber < 1 || escNumber > 4) {
+        LOG_ERROR("Invalid ESC number for slew rate: %d", escNumber);
+        return;
+    }
+    m_slewRates[escNumber - 1] = usPerSecond;
+
+    ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+    if (escs[escNumber - 1]) {
+        escs[escNumber - 1]->setSlewRate(usPerSecond);
+    }
+}
+
+void ESCControlThread::setAllSlewRate(int usPerSecond)
+{
+    for (int esc = 1; esc <= 4; ++esc) {
+        setSlewRate(esc, usPerSecond);
+    }
+}
+
+void ESCControlThread::setCommandTimeout(int timeoutMs, FailsafeMode mode)
+{
+    m_failsafeMode = mode;
+    m_commandTimeoutNs = int64_t(std::max(0, timeoutMs)) * 1000000;
+
+    if (timeoutMs > 0) {
+        LOG_INFO("Command timeout failsafe: %dms, %s to neutral", timeoutMs,
+                 mode == FailsafeMode::Ramp ? "ramp" : "jump");
+    }
+}
+
 // Individual ESC control methods
 void ESCControlThread::setESC1PulseWidth(int pulseWidthUs)
 {
-    int constrainedPulseWidth = constrainPulseWidth(pulseWidthUs);
-    setCommand(constrainedPulseWidth, m_currentCommand.esc2PulseWidth,
-               m_currentCommand.esc3PulseWidth, m_currentCommand.esc4PulseWidth);
+    setChannelCommand(0, PulseWidth::fromUs(pulseWidthUs));
 }
 
 void ESCControlThread::setESC2PulseWidth(int pulseWidthUs)
 {
-    int constrainedPulseWidth = constrainPulseWidth(pulseWidthUs);
-    setCommand(m_currentCommand.esc1PulseWidth, constrainedPulseWidth,
-               m_currentCommand.esc3PulseWidth, m_currentCommand.esc4PulseWidth);
+    setChannelCommand(1, PulseWidth::fromUs(pulseWidthUs));
 }
 
 void ESCControlThread::setESC3PulseWidth(int pulseWidthUs)
 {
-    int constrainedPulseWidth = constrainPulseWidth(pulseWidthUs);
-    setCommand(m_currentCommand.esc1PulseWidth, m_currentCommand.esc2PulseWidth,
-               constrainedPulseWidth, m_currentCommand.esc4PulseWidth);
+    setChannelCommand(2, PulseWidth::fromUs(pulseWidthUs));
 }
 
 void ESCControlThread::setESC4PulseWidth(int pulseWidthUs)
 {
-    int constrainedPulseWidth = constrainPulseWidth(pulseWidthUs);
-    setCommand(m_currentCommand.esc1PulseWidth, m_currentCommand.esc2PulseWidth,
-               m_currentCommand.esc3PulseWidth, constrainedPulseWidth);
+    setChannelCommand(3, PulseWidth::fromUs(pulseWidthUs));
+}
+
+void ESCControlThread::setESCPulseWidth(int escNumber, PulseWidth pulseWidth)
+{
+    if (escNumber < 1 || escNumber > 4) {
+        LOG_ERROR("Invalid ESC number: %d", escNumber);
+        return;
+    }
+    setChannelCommand(escNumber - 1, pulseWidth);
 }
 
 void ESCControlThread::setESC1Neutral()
 {
-    setESC1PulseWidth(PWM_NEUTRAL_US);
+    setChannelCommand(0, PWM_NEUTRAL);
 }
 
 void ESCControlThread::setESC2Neutral()
 {
-    setESC2PulseWidth(PWM_NEUTRAL_US);
+    setChannelCommand(1, PWM_NEUTRAL);
 }
 
 void ESCControlThread::setESC3Neutral()
 {
-    setESC3PulseWidth(PWM_NEUTRAL_US);
+    setChannelCommand(2, PWM_NEUTRAL);
 }
 
 void ESCControlThread::setESC4Neutral()
 {
-    setESC4PulseWidth(PWM_NEUTRAL_US);
+    setChannelCommand(3, PWM_NEUTRAL);
 }
 
 // Synchronized control methods
 void ESCControlThread::setAllPulseWidth(int pulseWidthUs)
 {
-    int constrainedPulseWidth = constrainPulseWidth(pulseWidthUs);
-    setCommand(constrainedPulseWidth, constrainedPulseWidth, constrainedPulseWidth, constrainedPulseWidth);
+    ESCCommandBatch batch;
+    std::fill(batch.pulseWidth, batch.pulseWidth + 4, PulseWidth::fromUs(pulseWidthUs));
+    submitCommand(batch);
 }
 
 void ESCControlThread::setAllNeutral()
 {
-    setAllPulseWidth(PWM_NEUTRAL_US);
+    submitCommand(ESCCommandBatch());
 }
 
 // Multi-ESC control
 void ESCControlThread::setAllDifferentialPulseWidth(int esc1PulseWidth, int esc2PulseWidth, int esc3PulseWidth, int esc4PulseWidth)
 {
-    int constrainedPulseWidth1 = constrainPulseWidth(esc1PulseWidth);
-    int constrainedPulseWidth2 = constrainPulseWidth(esc2PulseWidth);
-    int constrainedPulseWidth3 = constrainPulseWidth(esc3PulseWidth);
-    int constrainedPulseWidth4 = constrainPulseWidth(esc4PulseWidth);
+    ESCCommandBatch batch;
+    batch.pulseWidth[0] = PulseWidth::fromUs(esc1PulseWidth);
+    batch.pulseWidth[1] = PulseWidth::fromUs(esc2PulseWidth);
+    batch.pulseWidth[2] = PulseWidth::fromUs(esc3PulseWidth);
+    batch.pulseWidth[3] = PulseWidth::fromUs(esc4PulseWidth);
+    submitCommand(batch);
+}
 
-    setCommand(constrainedPulseWidth1, constrainedPulseWidth2, constrainedPulseWidth3, constrainedPulseWidth4);
+bool ESCControlThread::submitCommand(const ESCCommandBatch& batch)
+{
+    ESCCommand command;
+    command.esc1PulseWidth = constrainPulseWidth(batch.pulseWidth[0]);
+    command.esc2PulseWidth = constrainPulseWidth(batch.pulseWidth[1]);
+    command.esc3PulseWidth = constrainPulseWidth(batch.pulseWidth[2]);
+    command.esc4PulseWidth = constrainPulseWidth(batch.pulseWidth[3]);
+    command.emergencyStop = (batch.flags & ESCCommandBatch::EmergencyStop) != 0;
+
+    // A repeated command still counts as fresh for the failsafe. Refreshed
+    // before publishing so the PWM thread never sees the command with a
+    // stale deadline.
+    commandReceived();
+
+    // Compare-and-skip: a repeated command is only a seqlock read. After a
+    // timeout the ESCs are at neutral, so the repeat has to be applied.
+    ESCCommand current;
+    m_command.load(&current);
+    if (!m_failsafeActive.load(std::memory_order_acquire) &&
+        current.esc1PulseWidth == command.esc1PulseWidth &&
+        current.esc2PulseWidth == command.esc2PulseWidth &&
+        current.esc3PulseWidth == command.esc3PulseWidth &&
+        current.esc4PulseWidth == command.esc4PulseWidth &&
+        current.emergencyStop == command.emergencyStop) {
+        m_skippedCommands.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    command.timestampNs = Clock::getInstance()->nowNs();
+    m_command.store(command);
+    m_submittedCommands.fetch_add(1, std::memory_order_relaxed);
+    commandPublished();
+    return true;
+}
+
+int ESCControlThread::submitTrajectory(int64_t senderNowNs, const TrajectoryPoint* points, int count)
+{
+    // The received batch is what keeps the link alive, not the points it
+    // plays later
+    commandReceived();
+    return m_trajectory.push(senderNowNs, Clock::getInstance()->nowNs(), points, count);
+}
+
+int ESCControlThread::getQueuedTrajectoryPoints(int64_t* leadNs) const
+{
+    return m_trajectory.getQueuedPoints(Clock::getInstance()->nowNs(), leadNs);
 }
 
 // Status methods
@@ -251,6 +424,35 @@ int ESCControlThread::getESC4PulseWidth() const
     return m_esc4 ? m_esc4->getCurrentPulseWidth() : 0;
 }
 
+PulseWidth ESCControlThread::getESCPulseWidth(int escNumber) const
+{
+    const ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+    if (escNumber < 1 || escNumber > 4 || !escs[escNumber - 1]) {
+        return PulseWidth();
+    }
+    return escs[escNumber - 1]->getPulseWidth();
+}
+
+uint32_t ESCControlThread::getESC1ERpm() const
+{
+    return m_esc1 ? m_esc1->getERpm() : 0;
+}
+
+uint32_t ESCControlThread::getESC2ERpm() const
+{
+    return m_esc2 ? m_esc2->getERpm() : 0;
+}
+
+uint32_t ESCControlThread::getESC3ERpm() const
+{
+    return m_esc3 ? m_esc3->getERpm() : 0;
+}
+
+uint32_t ESCControlThread::getESC4ERpm() const
+{
+    return m_esc4 ? m_esc4->getERpm() : 0;
+}
+
 bool ESCControlThread::getESC1Status() const
 {
     return m_esc1 ? m_esc1->isRunning() : false;
@@ -271,140 +473,388 @@ bool ESCControlThread::getESC4Status() const
     return m_esc4 ? m_esc4->isRunning() : false;
 }
 
+// Timing statistics
+PwmTimingReport ESCControlThread::getTimingReport() const
+{
+    PwmTimingReport report;
+    const ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+
+    for (int i = 0; i < 4; ++i) {
+        if (escs[i]) {
+            report.pulseError[i] = escs[i]->getPulseErrorStats();
+            report.missedDeadlines[i] = escs[i]->getMissedDeadlineCount();
+            report.telemetryErrors[i] = escs[i]->getTelemetryErrorCount();
+        }
+    }
+
+    PwmScheduler* scheduler = PwmScheduler::getInstance();
+    report.periodError = scheduler->getPeriodErrorStats();
+    report.frames = scheduler->getFrameCount();
+    report.overruns = scheduler->getOverrunCount();
+    report.skippedFrames = scheduler->getSkippedFrameCount();
+    report.spinMarginNs = scheduler->getSpinMarginNs();
+    report.spinTimeNs = scheduler->getSpinTimeNs();
+    report.spinTimeSavedNs = scheduler->getSpinTimeSavedNs();
+    report.lateWakeups = scheduler->getLateWakeupCount();
+    report.commandLatency = m_commandLatency.summary();
+    report.failsafeCount = m_failsafeCount.load(std::memory_order_relaxed);
+    report.failsafeReaction = m_failsafeReaction.summary();
+    return report;
+}
+
+void ESCControlThread::resetTimingStats()
+{
+    PwmScheduler::getInstance()->resetTimingStats();
+    m_commandLatency.reset();
+    m_failsafeReaction.reset();
+    m_trajectory.resetStats();
+}
+
 // Emergency stop
 void ESCControlThread::emergencyStop()
 {
-    std::cout << "EMERGENCY STOP ACTIVATED!" << std::endl;
-    setCommand(PWM_NEUTRAL_US, PWM_NEUTRAL_US, PWM_NEUTRAL_US, PWM_NEUTRAL_US, true);
+    LOG_WARNING("EMERGENCY STOP ACTIVATED!");
+    m_trajectory.clear();
+    ESCCommandBatch batch;
+    batch.flags = ESCCommandBatch::EmergencyStop;
+    submitCommand(batch);
 }
 
 // Private methods
 void ESCControlThread::controlThreadFunction()
 {
-    std::cout << "ESC Control thread started for 4 ESCs" << std::endl;
-
+    LOG_INFO("ESC Control thread started for 4 ESCs");
+
+    // Commands are applied by the PWM thread (or by the setter when no frames
+    // run), this thread supervises the ESCs and steps the ramps of channels
+    // that have no PWM frames (hardware PWM)
+    ClockThread clockThread;
+    m_threadAttached = true;
+    Clock* clock = Clock::getInstance();
+    PwmScheduler* scheduler = PwmScheduler::getInstance();
+    int64_t nextSafetyCheckNs = 0;
     while (m_isRunning.load()) {
-        std::unique_lock<std::mutex> lock(m_commandMutex);
+        const int64_t nowNs = clock->nowNs();
+        if (!scheduler->isRunning()) {
+            playTrajectory(nowNs);
+            checkCommandTimeout(nowNs);
+            advanceRamps(nowNs);
+            recordFrame(nowNs, 0);
+        }
+        if (nowNs >= nextSafetyCheckNs) {
+            performSafetyChecks();
+            nextSafetyCheckNs = nowNs + SAFETY_CHECK_INTERVAL_MS * 1000000LL;
+        }
+        clock->sleepForNs(RAMP_INTERVAL_MS * 1000000LL);
+    }
+
+    LOG_INFO("ESC Control thread stopped");
+}
 
-        // Wait for new command or timeout
-        m_commandCondition.wait_for(lock, std::chrono::milliseconds(50),
-                                    [this] { return m_hasNewCommand.load() || !m_isRunning.load(); });
+void ESCControlThread::onFrameStart(int64_t frameStartNs)
+{
+    // Wake-up lateness for the flight recorder, read before any work
+    const int64_t wakeNs = FlightRecorder::getInstance()->isOpen() ? Clock::getInstance()->nowNs() : frameStartNs;
+
+    // One pass per frame, a newer command is picked up by the next frame
+    playTrajectory(frameStartNs);
+    applyPendingCommand(false);
+    checkCommandTimeout(frameStartNs);
+    advanceRamps(frameStartNs);
+    recordFrame(frameStartNs, wakeNs - frameStartNs);
+}
 
-        if (!m_isRunning.load()) {
-            break;
+void ESCControlThread::playTrajectory(int64_t nowNs)
+{
+    // Points only refresh the outputs while packets arrive: past the link
+    // loss deadline the failsafe owns them until the next received batch
+    const int64_t timeoutNs = m_commandTimeoutNs.load(std::memory_order_relaxed);
+    if (timeoutNs > 0 && nowNs >= m_lastCommandNs.load(std::memory_order_acquire) + timeoutNs) {
+        return;
+    }
+
+    // Published like a setter call and latched by this same frame, without
+    // blocking: a point that meets a setter in the seqlock stays queued for
+    // the next frame
+    m_trajectory.take(nowNs, [this, nowNs](const PulseWidth pulseWidth[4]) {
+        ESCCommand command;
+        command.esc1PulseWidth = constrainPulseWidth(pulseWidth[0]);
+        command.esc2PulseWidth = constrainPulseWidth(pulseWidth[1]);
+        command.esc3PulseWidth = constrainPulseWidth(pulseWidth[2]);
+        command.esc4PulseWidth = constrainPulseWidth(pulseWidth[3]);
+        command.emergencyStop = false;
+        command.timestampNs = nowNs;
+
+        ESCCommand current;
+        if (!m_command.tryLoad(&current)) {
+            return false;
+        }
+        if (!m_failsafeActive.load(std::memory_order_acquire) &&
+            current.esc1PulseWidth == command.esc1PulseWidth &&
+            current.esc2PulseWidth == command.esc2PulseWidth &&
+            current.esc3PulseWidth == command.esc3PulseWidth &&
+            current.esc4PulseWidth == command.esc4PulseWidth &&
+            !current.emergencyStop) {
+            return true;
+        }
+        if (m_command.tryStore(command) == 0) {
+            return false;
         }
+        commandPublished();
+        return true;
+    });
+}
 
-        // Check if we have a new command to execute
-        if (m_hasNewCommand.load()) {
-            ESCCommand commandToExecute = m_currentCommand;
-            m_hasNewCommand = false;
-            lock.unlock();
+void ESCControlThread::recordFrame(int64_t frameStartNs, int64_t jitterNs)
+{
+    FlightRecorder* recorder = FlightRecorder::getInstance();
+    if (!recorder->isOpen() || !m_esc1 || !m_esc2 || !m_esc3 || !m_esc4) {
+        return;
+    }
 
-            // Execute the command
-            executeCommand(commandToExecute);
+    const PulseWidth outputs[4] = {
+        m_esc1->getOutputPulseWidth(), m_esc2->getOutputPulseWidth(),
+        m_esc3->getOutputPulseWidth(), m_esc4->getOutputPulseWidth()
+    };
+    recorder->recordFrame(frameStartNs, jitterNs, outputs,
+                          m_failsafeActive.load(std::memory_order_relaxed) ? FlightRecord::Failsafe : 0);
+}
 
-            // Update last command
-            {
-                std::lock_guard<std::mutex> updateLock(m_commandMutex);
-                m_lastCommand = commandToExecute;
-            }
-        } else {
-            lock.unlock();
+void ESCControlThread::applyPendingCommand(bool untilCurrent)
+{
+    do {
+        // Another thread is applying, it re-checks the sequence before leaving
+        if (m_applying.test_and_set(std::memory_order_acquire)) {
+            return;
         }
 
-        // Perform safety checks
-        performSafetyChecks();
+        // Bounded read: the PWM thread must not spin on a preempted setter
+        ESCCommand command;
+        uint64_t sequence = 0;
+        if (m_command.tryLoad(&command, &sequence) &&
+            sequence != m_appliedSequence.load(std::memory_order_relaxed)) {
+            executeCommand(command);
+            m_appliedSequence.store(sequence, std::memory_order_release);
+            m_commandLatency.record(Clock::getInstance()->nowNs() - command.timestampNs);
+        }
 
-        // Small delay to prevent excessive CPU usage
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+        m_applying.clear(std::memory_order_release);
+    } while (untilCurrent && commandPending());
+}
+
+bool ESCControlThread::commandPending() const
+{
+    // Orders the flag release before the sequence read; pairs with the fence
+    // in commandPublished() so either the setter or the flag holder sees the
+    // other's write
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_command.sequence() != m_appliedSequence.load(std::memory_order_acquire);
+}
+
+void ESCControlThread::releaseApplying()
+{
+    m_applying.clear(std::memory_order_release);
 
-    std::cout << "ESC Control thread stopped" << std::endl;
+    // A setter that found the flag taken returned without applying. The next
+    // PWM frame picks its command up; without frames nobody would, so it is
+    // applied here before the step ends.
+    if (!PwmScheduler::getInstance()->isRunning() && commandPending()) {
+        applyPendingCommand(true);
+    }
 }
 
 void ESCControlThread::executeCommand(const ESCCommand& command)
 {
     if (!isCommandValid(command)) {
-        std::cerr << "Invalid command received, ignoring" << std::endl;
+        LOG_ERROR_EVERY(1000, "Invalid command received, ignoring");
         return;
     }
 
+    ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+    PulseWidth pulseWidths[4] = { command.esc1PulseWidth, command.esc2PulseWidth,
+                                  command.esc3PulseWidth, command.esc4PulseWidth };
     if (command.emergencyStop) {
-        std::cout << "Executing emergency stop on all ESCs" << std::endl;
-        if (m_esc1) m_esc1->setPulseWidth(PWM_NEUTRAL_US);
-        if (m_esc2) m_esc2->setPulseWidth(PWM_NEUTRAL_US);
-        if (m_esc3) m_esc3->setPulseWidth(PWM_NEUTRAL_US);
-        if (m_esc4) m_esc4->setPulseWidth(PWM_NEUTRAL_US);
+        std::fill(pulseWidths, pulseWidths + 4, PWM_NEUTRAL);
+    }
+    m_neutralApplied = std::all_of(pulseWidths, pulseWidths + 4,
+                                   [](PulseWidth pulseWidth) { return pulseWidth == PWM_NEUTRAL; });
+    m_failsafeActive.store(false, std::memory_order_release);
+
+    // Software channels are committed to the scheduler latch together so all
+    // four switch in the same frame. An emergency stop skips the slew ramp.
+    PwmScheduler::PulseUpdate updates[4];
+    int updateCount = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (escs[i] && escs[i]->stagePulseWidth(pulseWidths[i], &updates[updateCount], command.emergencyStop)) {
+            ++updateCount;
+        }
+    }
+    commitPulseWidths(updates, updateCount);
+}
+
+void ESCControlThread::checkCommandTimeout(int64_t nowNs)
+{
+    const int64_t timeoutNs = m_commandTimeoutNs.load(std::memory_order_relaxed);
+    if (timeoutNs <= 0 || m_failsafeActive.load(std::memory_order_relaxed)) {
         return;
     }
 
-    // Execute the command on all ESCs
-    if (m_esc1) {
-        m_esc1->setPulseWidth(command.esc1PulseWidth);
+    const int64_t deadlineNs = m_lastCommandNs.load(std::memory_order_acquire) + timeoutNs;
+    if (nowNs < deadlineNs) {
+        return;
     }
-    if (m_esc2) {
-        m_esc2->setPulseWidth(command.esc2PulseWidth);
+
+    // Someone is applying a command right now, look again next frame
+    if (m_applying.test_and_set(std::memory_order_acquire)) {
+        return;
     }
-    if (m_esc3) {
-        m_esc3->setPulseWidth(command.esc3PulseWidth);
+
+    // A setter refreshes the deadline before publishing, so a command that
+    // raced this check is seen here: apply it instead of the failsafe
+    if (nowNs < m_lastCommandNs.load(std::memory_order_acquire) + timeoutNs || commandPending()) {
+        releaseApplying();
+        return;
     }
-    if (m_esc4) {
-        m_esc4->setPulseWidth(command.esc4PulseWidth);
+
+    // Nothing to do if the outputs are already commanded to neutral
+    if (!m_neutralApplied) {
+        const bool immediate = m_failsafeMode.load(std::memory_order_relaxed) == FailsafeMode::Jump;
+        ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+        PwmScheduler::PulseUpdate updates[4];
+        int updateCount = 0;
+        for (int i = 0; i < 4; ++i) {
+            if (escs[i] && escs[i]->stagePulseWidth(PWM_NEUTRAL, &updates[updateCount], immediate)) {
+                ++updateCount;
+            }
+        }
+        commitPulseWidths(updates, updateCount);
+
+        m_neutralApplied = true;
+        m_failsafeCount.fetch_add(1, std::memory_order_relaxed);
+        m_failsafeReaction.record(nowNs - deadlineNs);
     }
+    m_failsafeActive.store(true, std::memory_order_release);
+
+    releaseApplying();
 }
 
-void ESCControlThread::setCommand(int esc1PulseWidth, int esc2PulseWidth, int esc3PulseWidth, int esc4PulseWidth, bool emergency)
+void ESCControlThread::advanceRamps(int64_t nowNs)
 {
-    std::lock_guard<std::mutex> lock(m_commandMutex);
+    // Ramp state belongs to whoever applies commands, skip this step if busy
+    if (m_applying.test_and_set(std::memory_order_acquire)) {
+        return;
+    }
 
-    m_currentCommand.esc1PulseWidth = esc1PulseWidth;
-    m_currentCommand.esc2PulseWidth = esc2PulseWidth;
-    m_currentCommand.esc3PulseWidth = esc3PulseWidth;
-    m_currentCommand.esc4PulseWidth = esc4PulseWidth;
-    m_currentCommand.emergencyStop = emergency;
-    m_currentCommand.timestamp = std::chrono::steady_clock::now();
+    ESCControl* escs[4] = { m_esc1.get(), m_esc2.get(), m_esc3.get(), m_esc4.get() };
+    PwmScheduler::PulseUpdate updates[4];
+    int updateCount = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (escs[i] && escs[i]->stageRamp(nowNs, &updates[updateCount])) {
+            ++updateCount;
+        }
+    }
+    // Also retries widths a busy latch refused in an earlier step
+    commitPulseWidths(updates, updateCount);
+
+    releaseApplying();
+}
 
-    m_hasNewCommand = true;
-    m_commandCondition.notify_one();
+void ESCControlThread::commitPulseWidths(const PwmScheduler::PulseUpdate* updates, int count)
+{
+    // Newer widths replace deferred ones of the same channel
+    for (int i = 0; i < count; ++i) {
+        int slot = 0;
+        while (slot < m_deferredUpdateCount && m_deferredUpdates[slot].channelId != updates[i].channelId) {
+            ++slot;
+        }
+        if (slot < 4) {
+            m_deferredUpdates[slot] = updates[i];
+            m_deferredUpdateCount = std::max(m_deferredUpdateCount, slot + 1);
+        }
+    }
+    if (m_deferredUpdateCount == 0) {
+        return;
+    }
+
+    // The PWM thread must not sleep on the latch mutex while a lower
+    // priority setter (ESCControl::setPulseWidth, channel add/remove) holds
+    // it; the widths stay deferred and go out together in a later frame
+    if (PwmScheduler::getInstance()->trySetPulseWidths(m_deferredUpdates, m_deferredUpdateCount)) {
+        m_deferredUpdateCount = 0;
+    }
+}
+
+void ESCControlThread::setChannelCommand(int channel, PulseWidth pulseWidth)
+{
+    PulseWidth constrainedPulseWidth = constrainPulseWidth(pulseWidth);
+
+    // Refresh the failsafe deadline before the PWM thread can see the command
+    commandReceived();
+
+    // Read-modify-write inside the seqlock writer so concurrent single-channel
+    // setters cannot overwrite each other's channel with a stale value
+    m_command.update([channel, constrainedPulseWidth](ESCCommand& command) {
+        PulseWidth* pulseWidths[4] = { &command.esc1PulseWidth, &command.esc2PulseWidth,
+                                &command.esc3PulseWidth, &command.esc4PulseWidth };
+        *pulseWidths[channel] = constrainedPulseWidth;
+        command.emergencyStop = false;
+        command.timestampNs = Clock::getInstance()->nowNs();
+    });
+    m_submittedCommands.fetch_add(1, std::memory_order_relaxed);
+    commandPublished();
+}
+
+void ESCControlThread::commandReceived()
+{
+    m_lastCommandNs.store(Clock::getInstance()->nowNs(), std::memory_order_release);
+}
+
+void ESCControlThread::commandPublished()
+{
+    // Without software or DShot channels there are no PWM frames to latch on
+    if (!PwmScheduler::getInstance()->isRunning()) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        applyPendingCommand(true);
+    }
 }
 
 void ESCControlThread::performSafetyChecks()
 {
     // Check if all ESCs are still running
     if (m_esc1 && !m_esc1->isRunning()) {
-        std::cerr << "Warning: ESC1 is not running" << std::endl;
+        LOG_WARNING_EVERY(1000, "Warning: ESC1 is not running");
     }
     if (m_esc2 && !m_esc2->isRunning()) {
-        std::cerr << "Warning: ESC2 is not running" << std::endl;
+        LOG_WARNING_EVERY(1000, "Warning: ESC2 is not running");
     }
     if (m_esc3 && !m_esc3->isRunning()) {
-        std::cerr << "Warning: ESC3 is not running" << std::endl;
+        LOG_WARNING_EVERY(1000, "Warning: ESC3 is not running");
     }
     if (m_esc4 && !m_esc4->isRunning()) {
-        std::cerr << "Warning: ESC4 is not running" << std::endl;
+        LOG_WARNING_EVERY(1000, "Warning: ESC4 is not running");
     }
 }
 
 bool ESCControlThread::isCommandValid(const ESCCommand& command) const
 {
     // Check if all pulse widths are within valid range
-    if (command.esc1PulseWidth < PWM_MIN_US || command.esc1PulseWidth > PWM_MAX_US) {
+    if (command.esc1PulseWidth < PWM_MIN || command.esc1PulseWidth > PWM_MAX) {
         return false;
     }
-    if (command.esc2PulseWidth < PWM_MIN_US || command.esc2PulseWidth > PWM_MAX_US) {
+    if (command.esc2PulseWidth < PWM_MIN || command.esc2PulseWidth > PWM_MAX) {
         return false;
     }
-    if (command.esc3PulseWidth < PWM_MIN_US || command.esc3PulseWidth > PWM_MAX_US) {
+    if (command.esc3PulseWidth < PWM_MIN || command.esc3PulseWidth > PWM_MAX) {
         return false;
     }
-    if (command.esc4PulseWidth < PWM_MIN_US || command.esc4PulseWidth > PWM_MAX_US) {
+    if (command.esc4PulseWidth < PWM_MIN || command.esc4PulseWidth > PWM_MAX) {
         return false;
     }
 
     return true;
 }
 
-int ESCControlThread::constrainPulseWidth(int pulseWidth) const
+PulseWidth ESCControlThread::constrainPulseWidth(PulseWidth pulseWidth) const
 {
-    return std::max(PWM_MIN_US, std::min(PWM_MAX_US, pulseWidth));
+    return pulseWidth.clamped(PWM_MIN, PWM_MAX);
 }
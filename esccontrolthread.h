@@ -1,14 +1,52 @@
 #pragma once
 
 #include "esccontrol.h"
+#include "seqlock.h"
+#include "trajectorybuffer.h"
 #include <memory>
 #include <thread>
 #include <atomic>
-#include <mutex>
-#include <condition_variable>
 #include <chrono>
 
-class ESCControlThread {
+// Snapshot of the PWM timing quality for all 4 ESCs
+struct PwmTimingReport {
+    TimingSummary pulseError[4];        // measured high time vs requested pulse width
+    uint64_t missedDeadlines[4] = {};   // falling edges later than the protocol's toleranceNs
+    TimingSummary periodError;          // frame interval vs the protocol's frame period
+    uint64_t frames = 0;
+    uint64_t overruns = 0;
+    uint64_t skippedFrames = 0;
+    int64_t spinMarginNs = 0;           // current adaptive busy-wait window
+    uint64_t spinTimeNs = 0;            // total time spent busy-waiting
+    uint64_t spinTimeSavedNs = 0;       // busy-wait avoided versus the startup calibration
+    uint64_t lateWakeups = 0;           // sleeps that woke up after the edge deadline
+    uint64_t telemetryErrors[4] = {};   // bidirectional DShot responses missing or failing the checksum
+    TimingSummary commandLatency;       // setter call to the frame that outputs the command
+    uint64_t failsafeCount = 0;         // command timeouts that drove the ESCs to neutral
+    TimingSummary failsafeReaction;     // timeout deadline to the frame that output neutral
+};
+
+// What the command-timeout failsafe does with the outputs
+enum class FailsafeMode {
+    Jump,           // neutral in the next frame, like an emergency stop
+    Ramp            // neutral through the per-ESC slew limits
+};
+
+// Whole 4-channel command, published in one operation by submitCommand()
+struct ESCCommandBatch {
+    static constexpr uint32_t EmergencyStop = 1u << 0;   // drive all ESCs to neutral
+
+    PulseWidth pulseWidth[4] = {                          // ESC1-ESC4, 1000-2000μs in 1/16μs
+        PulseWidth::fromUs(1500), PulseWidth::fromUs(1500),
+        PulseWidth::fromUs(1500), PulseWidth::fromUs(1500)
+    };
+    uint32_t flags = 0;
+};
+
+// Commands are published through a seqlock slot and latched by the PWM
+// scheduler thread at the start of each frame, so a setter never blocks and
+// a command reaches the pins in the next frame.
+class ESCControlThread : public PwmFrameListener {
 public:
     // ESC PWM Pins - Made public so they can be directly referenced
     static constexpr int PIN_ESC_1 = 18;  // First ESC PWM Pin (GPIO 18, Pin 12) - Hardware PWM capable
@@ -16,8 +54,15 @@ public:
     static constexpr int PIN_ESC_3 = 13;  // Third ESC PWM Pin (GPIO 13, Pin 33) - Hardware PWM capable
     static constexpr int PIN_ESC_4 = 19;  // Fourth ESC PWM Pin (GPIO 19, Pin 35) - Hardware PWM capable
 
-    // Constructor
-    ESCControlThread();
+    // SPI buses used for DShot300/600 and bidirectional DShot (MOSI, and
+    // MISO for bidirectional, wired to the ESC signal line)
+    static constexpr const char* DSHOT_SPI_DEVICES[4] = {
+        "/dev/spidev0.0", "/dev/spidev3.0", "/dev/spidev4.0", "/dev/spidev5.0"
+    };
+    static constexpr int DSHOT_SPI_MIN_BIT_RATE = 300000;   // slower DShot is bit-banged on GPIO
+
+    // Constructor - backend is used for all 4 ESCs
+    explicit ESCControlThread(PwmBackend backend = PwmBackend::Software);
 
     // Destructor
     ~ESCControlThread();
@@ -31,12 +76,43 @@ public:
     // Check if the thread is running
     bool isRunning() const;
 
+    // Select the ESC protocol for all 4 ESCs, may be called before or after initialize()
+    void setProtocol(EscProtocol protocol);
+    EscProtocol getProtocol() const { return m_protocol; }
+
+    // sysfs directory of the kernel PWM controllers used by the hardware
+    // backend (default /sys/class/pwm), must be set before initialize()
+    void setHardwarePwmRoot(const std::string& sysfsRoot) { m_hardwarePwmRoot = sysfsRoot; }
+
+    // Bidirectional DShot eRPM telemetry, must be set before initialize()
+    void setDShotBidirectional(bool enabled) { m_dshotBidirectional = enabled; }
+
+    // DShot 3D mapping (1500μs = stop, below = reverse, above = forward) instead
+    // of the linear 1000-2000μs throttle. The ESC has to be configured for 3D
+    // mode itself; must be set before initialize()
+    void setDShot3DMode(bool enabled) { m_dshot3dMode = enabled; }
+
+    // Setpoint slew limit in μs/s per ESC (escNumber 1-4), 0 = off. Outputs
+    // ramp toward the command at the PWM frame rate; an emergency stop
+    // bypasses the ramp. May be called before or after initialize().
+    void setSlewRate(int escNumber, int usPerSecond);
+    void setAllSlewRate(int usPerSecond);
+
+    // Drive the ESCs to neutral when no command (repeated or not) arrived for
+    // timeoutMs, checked every PWM frame. 0 disables. The next command after
+    // a timeout is applied even if it repeats the previous one.
+    void setCommandTimeout(int timeoutMs, FailsafeMode mode = FailsafeMode::Jump);
+    bool isFailsafeActive() const { return m_failsafeActive.load(std::memory_order_relaxed); }
+
     // Individual ESC control methods (pulse width in microseconds)
     void setESC1PulseWidth(int pulseWidthUs);
     void setESC2PulseWidth(int pulseWidthUs);
     void setESC3PulseWidth(int pulseWidthUs);
     void setESC4PulseWidth(int pulseWidthUs);
 
+    // Sub-microsecond setpoint for one ESC (escNumber 1-4)
+    void setESCPulseWidth(int escNumber, PulseWidth pulseWidth);
+
     // Convenience methods for common positions
     void setESC1Neutral();
     void setESC2Neutral();
@@ -50,19 +126,46 @@ public:
     // Multi-ESC control (set all 4 ESCs with different values)
     void setAllDifferentialPulseWidth(int esc1PulseWidth, int esc2PulseWidth, int esc3PulseWidth, int esc4PulseWidth);
 
-    // Get current status
+    // Transactional update of all channels. A command equal to the current
+    // one is skipped without writing anything; returns false in that case.
+    bool submitCommand(const ESCCommandBatch& batch);
+    uint64_t getSubmittedCommandCount() const { return m_submittedCommands.load(std::memory_order_relaxed); }
+    uint64_t getSkippedCommandCount() const { return m_skippedCommands.load(std::memory_order_relaxed); }
+
+    // Timed setpoints (sender timeline, see TrajectoryBuffer), each submitted
+    // by the frame it falls due in. The caller clears the trajectory before
+    // switching back to submitCommand(); an emergency stop clears it.
+    int submitTrajectory(int64_t senderNowNs, const TrajectoryPoint* points, int count);
+    void clearTrajectory() { m_trajectory.clear(); }
+    void setTrajectoryDepth(int depthMs) { m_trajectory.setDepthNs(depthMs * 1000000LL); }
+    int getQueuedTrajectoryPoints(int64_t* leadNs) const;
+    TrajectoryStats getTrajectoryStats() const { return m_trajectory.getStats(); }
+
+    // Get current status (commanded pulse width, the ramp target)
     int getESC1PulseWidth() const;
     int getESC2PulseWidth() const;
     int getESC3PulseWidth() const;
     int getESC4PulseWidth() const;
+    PulseWidth getESCPulseWidth(int escNumber) const;   // full resolution, escNumber 1-4
+    uint32_t getESC1ERpm() const;      // electrical RPM, 0 without bidirectional DShot
+    uint32_t getESC2ERpm() const;
+    uint32_t getESC3ERpm() const;
+    uint32_t getESC4ERpm() const;
     bool getESC1Status() const;
     bool getESC2Status() const;
     bool getESC3Status() const;
     bool getESC4Status() const;
 
+    // PWM timing statistics, safe to call from any thread
+    PwmTimingReport getTimingReport() const;
+    void resetTimingStats();
+
     // Emergency stop
     void emergencyStop();
 
+    // PwmFrameListener, runs on the PWM scheduler thread
+    void onFrameStart(int64_t frameStartNs) override;
+
 private:
     // ESC instances
     std::unique_ptr<ESCControl> m_esc1;
@@ -70,37 +173,70 @@ private:
     std::unique_ptr<ESCControl> m_esc3;
     std::unique_ptr<ESCControl> m_esc4;
 
+    // PWM backend and protocol requested for the ESCs
+    PwmBackend m_backend;
+    std::string m_hardwarePwmRoot;
+    EscProtocol m_protocol;
+    bool m_dshotBidirectional;
+    bool m_dshot3dMode;
+    int m_slewRates[4];
+
     // Thread management
     std::thread m_controlThread;
     std::atomic<bool> m_isRunning;
+    std::atomic<bool> m_threadAttached;     // control thread holds its ClockThread
     std::atomic<bool> m_initialized;
 
-    // Thread synchronization
-    mutable std::mutex m_commandMutex;
-    std::condition_variable m_commandCondition;
-    std::atomic<bool> m_hasNewCommand;
-
-    // Command storage (protected by mutex)
+    // Command storage, written by the setters and read by the PWM thread
     struct ESCCommand {
-        int esc1PulseWidth = 1500; // Neutral position
-        int esc2PulseWidth = 1500; // Neutral position
-        int esc3PulseWidth = 1500; // Neutral position
-        int esc4PulseWidth = 1500; // Neutral position
+        PulseWidth esc1PulseWidth = PulseWidth::fromUs(1500); // Neutral position
+        PulseWidth esc2PulseWidth = PulseWidth::fromUs(1500); // Neutral position
+        PulseWidth esc3PulseWidth = PulseWidth::fromUs(1500); // Neutral position
+        PulseWidth esc4PulseWidth = PulseWidth::fromUs(1500); // Neutral position
         bool emergencyStop = false;
-        std::chrono::steady_clock::time_point timestamp;
+        int64_t timestampNs = 0;   // Clock time of the setter call
     };
-    ESCCommand m_currentCommand;
-    ESCCommand m_lastCommand;
+    SeqLock<ESCCommand> m_command;
+    std::atomic<uint64_t> m_appliedSequence;    // last command sequence written to the ESCs
+    std::atomic_flag m_applying = ATOMIC_FLAG_INIT;
+    // Staged widths a busy latch refused, committed with the next ones; guarded by m_applying
+    PwmScheduler::PulseUpdate m_deferredUpdates[4];
+    int m_deferredUpdateCount;
+    TimingHistogram m_commandLatency;
+    std::atomic<uint64_t> m_submittedCommands;
+    std::atomic<uint64_t> m_skippedCommands;
+
+    // Jitter buffer of timed setpoints, drained by whoever steps the frames
+    TrajectoryBuffer m_trajectory;
+
+    // Command-timeout failsafe, evaluated by whoever steps the frames
+    std::atomic<int64_t> m_commandTimeoutNs;    // 0 = off
+    std::atomic<FailsafeMode> m_failsafeMode;
+    std::atomic<int64_t> m_lastCommandNs;       // Clock time of the last setter call
+    std::atomic<bool> m_failsafeActive;
+    bool m_neutralApplied;                      // last applied command was neutral, guarded by m_applying
+    std::atomic<uint64_t> m_failsafeCount;
+    TimingHistogram m_failsafeReaction;
 
     // Private methods
     void controlThreadFunction();
+    void applyPendingCommand(bool untilCurrent);
+    void playTrajectory(int64_t nowNs);
     void executeCommand(const ESCCommand& command);
-    void setCommand(int esc1PulseWidth, int esc2PulseWidth, int esc3PulseWidth, int esc4PulseWidth, bool emergency = false);
+    void advanceRamps(int64_t nowNs);
+    void checkCommandTimeout(int64_t nowNs);
+    void recordFrame(int64_t frameStartNs, int64_t jitterNs);
+    void commandReceived();
+    void setChannelCommand(int channel, PulseWidth pulseWidth);
+    void commandPublished();
+    bool commandPending() const;
+    void releaseApplying();
+    void commitPulseWidths(const PwmScheduler::PulseUpdate* updates, int count);
 
     // Safety features
     void performSafetyChecks();
     bool isCommandValid(const ESCCommand& command) const;
 
     // Utility methods
-    int constrainPulseWidth(int pulseWidth) const;
+    PulseWidth constrainPulseWidth(PulseWidth pulseWidth) const;
 };
@@ -0,0 +1,48 @@
+#include "escprotocol.h"
+#include <algorithm>
+#include <cstring>
+
+// Periods are integer divisors of each other so all protocols can share one
+// scheduler frame (see PwmScheduler)
+static const EscProtocolTiming PROTOCOL_TIMINGS[] = {
+    { "pwm",        20000000, 1000000, 2000000, 10000,      0 },
+    { "oneshot125",   500000,  125000,  250000,  2000,      0 },
+    { "oneshot42",    250000,   42000,   84000,  1000,      0 },
+    { "multishot",    125000,    5000,   25000,   500,      0 },
+    { "dshot150",     500000,       0,       0,  1000, 150000 },
+    { "dshot300",     500000,       0,       0,   500, 300000 },
+    { "dshot600",     500000,       0,       0,   250, 600000 },
+};
+
+static constexpr PulseWidth COMMAND_MIN = PulseWidth::fromUs(1000);
+static constexpr PulseWidth COMMAND_MAX = PulseWidth::fromUs(2000);
+
+const EscProtocolTiming& escProtocolTiming(EscProtocol protocol)
+{
+    return PROTOCOL_TIMINGS[static_cast<int>(protocol)];
+}
+
+int64_t escProtocolPulseNs(EscProtocol protocol, PulseWidth command)
+{
+    const EscProtocolTiming& timing = escProtocolTiming(protocol);
+    const int32_t ticks = command.clamped(COMMAND_MIN, COMMAND_MAX).ticks();
+
+    return timing.minPulseNs + (int64_t(ticks - COMMAND_MIN.ticks()) * (timing.maxPulseNs - timing.minPulseNs))
+                               / (COMMAND_MAX.ticks() - COMMAND_MIN.ticks());
+}
+
+bool escProtocolIsDigital(EscProtocol protocol)
+{
+    return escProtocolTiming(protocol).bitRate != 0;
+}
+
+bool escProtocolFromName(const char* name, EscProtocol* protocol)
+{
+    for (int i = 0; i < int(sizeof(PROTOCOL_TIMINGS) / sizeof(PROTOCOL_TIMINGS[0])); ++i) {
+        if (strcmp(name, PROTOCOL_TIMINGS[i].name) == 0) {
+            *protocol = static_cast<EscProtocol>(i);
+            return true;
+        }
+    }
+    return false;
+}
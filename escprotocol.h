@@ -0,0 +1,42 @@
+#ifndef ESCPROTOCOL_H
+#define ESCPROTOCOL_H
+
+#include <cstdint>
+#include "pulsewidth.h"
+
+// ESC signalling modes. The analog ones encode the throttle as a pulse
+// width and differ in pulse range and frame rate, DShot sends a 16-bit
+// digital frame (see dshot.h).
+enum class EscProtocol {
+    StandardPwm,    // 1000-2000μs @ 50Hz
+    OneShot125,     // 125-250μs @ 2kHz
+    OneShot42,      // 42-84μs @ 4kHz
+    Multishot,      // 5-25μs @ 8kHz
+    DShot150,       // 150kbit/s @ 2kHz
+    DShot300,       // 300kbit/s @ 2kHz
+    DShot600        // 600kbit/s @ 2kHz
+};
+
+struct EscProtocolTiming {
+    const char* name;
+    int64_t periodNs;           // frame period
+    int64_t minPulseNs;         // command 1000μs
+    int64_t maxPulseNs;         // command 2000μs
+    int64_t toleranceNs;        // falling edge error above this counts as a missed deadline
+    int bitRate;                // DShot bit rate, 0 for analog protocols
+};
+
+// Timing table entry for a protocol
+const EscProtocolTiming& escProtocolTiming(EscProtocol protocol);
+
+// Map a standard 1000-2000μs command onto the protocol's pulse range,
+// keeping the 1/16μs fraction of the command
+int64_t escProtocolPulseNs(EscProtocol protocol, PulseWidth command);
+
+// True for the DShot modes
+bool escProtocolIsDigital(EscProtocol protocol);
+
+// Parse "pwm", "oneshot125", "oneshot42", "multishot", "dshot150", "dshot300" or "dshot600"
+bool escProtocolFromName(const char* name, EscProtocol* protocol);
+
+#endif // ESCPROTOCOL_H
@@ -0,0 +1,195 @@
+#include "flightrecorder.h"
+#include "clock.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <time.h>
+
+FlightRecorder *FlightRecorder::theInstance_ = nullptr;
+
+FlightRecorder* FlightRecorder::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new FlightRecorder();
+    }
+    return theInstance_;
+}
+
+FlightRecorder::FlightRecorder()
+    : m_records(nullptr)
+    , m_header(nullptr)
+    , m_capacity(0)
+    , m_mappedSize(0)
+    , m_fd(-1)
+    , m_armed(false)
+{
+}
+
+bool FlightRecorder::open(const std::string& path, uint64_t capacity)
+{
+    close();
+    capacity = std::max<uint64_t>(capacity, 1);
+
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m_fd < 0) {
+        LOG_ERROR("Failed to open flight recorder %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Keep the previous sessions if the file has the same geometry
+    const size_t size = sizeof(FlightRecorderHeader) + capacity * sizeof(FlightRecord);
+    struct stat st;
+    const bool resize = fstat(m_fd, &st) != 0 || size_t(st.st_size) != size;
+    if (resize && (ftruncate(m_fd, 0) != 0 || ftruncate(m_fd, off_t(size)) != 0)) {
+        LOG_ERROR("Failed to size flight recorder %s: %s", path.c_str(), strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    // Fault every page in now and keep it resident: the PWM thread writes
+    // records and must not take a page fault on a record slot
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, 0);
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("Failed to map flight recorder %s: %s", path.c_str(), strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    if (mlock(mapping, size) != 0) {
+        LOG_WARNING("Failed to lock flight recorder %s in memory: %s (raise RLIMIT_MEMLOCK)",
+                    path.c_str(), strerror(errno));
+    }
+
+    // On a disk filesystem writeback write-protects the pages it flushes and
+    // the next record waits for the write; tmpfs has no writeback
+    struct statfs fs;
+    if (fstatfs(m_fd, &fs) == 0 && fs.f_type != TMPFS_MAGIC) {
+        LOG_WARNING("Flight recorder %s is not on tmpfs, writeback can stall the PWM thread (use %s)",
+                    path.c_str(), DEFAULT_PATH);
+    }
+
+    m_header = static_cast<FlightRecorderHeader*>(mapping);
+    m_mappedSize = size;
+    m_capacity = capacity;
+
+    if (memcmp(m_header->magic, FlightRecorderHeader::MAGIC, sizeof(m_header->magic)) != 0 ||
+        m_header->version != FlightRecorderHeader::VERSION ||
+        m_header->recordSize != sizeof(FlightRecord) ||
+        m_header->capacity != capacity) {
+        memset(mapping, 0, size);
+        memcpy(m_header->magic, FlightRecorderHeader::MAGIC, sizeof(m_header->magic));
+        m_header->version = FlightRecorderHeader::VERSION;
+        m_header->recordSize = sizeof(FlightRecord);
+        m_header->capacity = capacity;
+        m_header->writeIndex.store(0, std::memory_order_relaxed);
+    }
+
+    m_records.store(reinterpret_cast<FlightRecord*>(m_header + 1), std::memory_order_release);
+
+    // Session marker, ties the monotonic timestamps to wall time
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    const int64_t wallNs = int64_t(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+
+    uint64_t position;
+    FlightRecord* record = beginRecord(&position);
+    record->timeNs = Clock::getInstance()->nowNs();
+    record->type = FlightRecordType::Session;
+    record->packetSize = sizeof(wallNs);
+    memcpy(record->packet, &wallNs, sizeof(wallNs));
+    commitRecord(record, position);
+
+    LOG_INFO("Flight recorder: %s, %llu records (%zu KB)", path.c_str(),
+             (unsigned long long)capacity, size / 1024);
+    return true;
+}
+
+void FlightRecorder::close()
+{
+    if (!m_header) {
+        return;
+    }
+
+    m_records.store(nullptr, std::memory_order_release);
+    msync(m_header, m_mappedSize, MS_SYNC);
+    munmap(m_header, m_mappedSize);
+    ::close(m_fd);
+    m_header = nullptr;
+    m_fd = -1;
+}
+
+FlightRecord* FlightRecorder::beginRecord(uint64_t* position)
+{
+    *position = m_header->writeIndex.fetch_add(1, std::memory_order_relaxed);
+    FlightRecord* record = m_records.load(std::memory_order_relaxed) + *position % m_capacity;
+
+    // Invalidate before overwriting, a crash mid-write leaves sequence 0
+    record->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record->flags = m_armed.load(std::memory_order_relaxed) ? FlightRecord::Armed : 0;
+    record->packetSize = 0;
+    record->reserved = 0;
+    record->jitterNs = 0;
+    memset(record->pulseTicks, 0, sizeof(record->pulseTicks));
+    return record;
+}
+
+void FlightRecorder::commitRecord(FlightRecord* record, uint64_t position)
+{
+    record->sequence.store(position + 1, std::memory_order_release);
+}
+
+void FlightRecorder::recordFrame(int64_t timeNs, int64_t jitterNs, const PulseWidth outputs[4], uint8_t flags)
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    uint64_t position;
+    FlightRecord* record = beginRecord(&position);
+    record->timeNs = timeNs;
+    record->type = FlightRecordType::Frame;
+    record->flags |= flags;
+    record->jitterNs = int32_t(std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, jitterNs)));
+    for (int i = 0; i < 4; ++i) {
+        record->pulseTicks[i] = uint16_t(outputs[i].ticks());
+    }
+    commitRecord(record, position);
+}
+
+void FlightRecorder::recordCommand(int64_t timeNs, const uint8_t* packet, size_t size,
+                                   const PulseWidth commanded[4], uint8_t flags)
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    uint64_t position;
+    FlightRecord* record = beginRecord(&position);
+    record->timeNs = timeNs;
+    record->type = FlightRecordType::Command;
+    record->flags |= flags;
+    if (commanded) {
+        for (int i = 0; i < 4; ++i) {
+            record->pulseTicks[i] = uint16_t(commanded[i].ticks());
+        }
+    }
+    record->packetSize = uint8_t(std::min(size, FlightRecord::PACKET_SIZE));
+    memcpy(record->packet, packet, record->packetSize);
+    commitRecord(record, position);
+}
+
+uint64_t FlightRecorder::getRecordCount() const
+{
+    return m_header ? m_header->writeIndex.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,104 @@
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "pulsewidth.h"
+
+// Black-box recorder. Every BLE command and every PWM frame appends a fixed
+// 64-byte record to a circular file mapped with MAP_SHARED, so the records
+// are in the page cache as soon as they are written and survive a crash of
+// the process. FlightDecoder turns the file into CSV.
+//
+// The mapping is populated and locked at open(). Keep the file on tmpfs
+// (DEFAULT_PATH): on a disk filesystem every writeback of a page makes the
+// next record on it wait in a page fault, on the PWM thread.
+//
+// Writers claim a slot with one fetch_add and publish it by storing its
+// sequence last; a record whose sequence does not match its position was
+// torn by a crash or overwritten and is skipped by the decoder. Reopening a
+// file with the same capacity continues after the previous session.
+
+enum class FlightRecordType : uint8_t {
+    Session = 1,        // recorder opened, packet holds the CLOCK_REALTIME ns at open
+    Command = 2,        // BLE packet received, pulse = commanded widths
+    Frame = 3           // PWM frame started, pulse = committed outputs, jitter = wake-up lateness
+};
+
+struct FlightRecord {
+    static constexpr uint8_t Armed = 1u << 0;
+    static constexpr uint8_t Failsafe = 1u << 1;
+    static constexpr uint8_t ParseError = 1u << 2;
+    static constexpr size_t PACKET_SIZE = 32;
+
+    std::atomic<uint64_t> sequence;     // position + 1, 0 while being written
+    int64_t timeNs;                     // Clock::getInstance() timeline
+    FlightRecordType type;
+    uint8_t flags;
+    uint8_t packetSize;                 // bytes of the packet kept (longer packets are cut)
+    uint8_t reserved;
+    int32_t jitterNs;
+    uint16_t pulseTicks[4];             // PulseWidth ticks (1/16μs), 0 = none
+    uint8_t packet[PACKET_SIZE];
+};
+
+struct FlightRecorderHeader {
+    static constexpr char MAGIC[8] = { 'E', 'S', 'C', 'F', 'L', 'I', 'G', 'H' };
+    static constexpr uint32_t VERSION = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t capacity;
+    std::atomic<uint64_t> writeIndex;   // records claimed since the file was created
+    uint8_t reserved[32];
+};
+
+static_assert(sizeof(FlightRecord) == 64, "FlightRecord layout is part of the file format");
+static_assert(sizeof(FlightRecorderHeader) == 64, "FlightRecorderHeader layout is part of the file format");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "records are shared through a file mapping");
+
+class FlightRecorder
+{
+public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 131072;     // 8MB, ~20 minutes of frames and commands at 50Hz
+    static constexpr const char* DEFAULT_PATH = "/dev/shm/esc-flight.bin";   // tmpfs: survives the process, not a reboot
+
+    static FlightRecorder* getInstance();
+
+    // Map (and create or resize) the file; recording is off until it is open
+    bool open(const std::string& path, uint64_t capacity = DEFAULT_CAPACITY);
+
+    // Only after the writers have stopped
+    void close();
+
+    bool isOpen() const { return m_records.load(std::memory_order_acquire) != nullptr; }
+
+    // Stamped into the flags of every following record
+    void setArmed(bool armed) { m_armed.store(armed, std::memory_order_relaxed); }
+
+    void recordFrame(int64_t timeNs, int64_t jitterNs, const PulseWidth outputs[4], uint8_t flags = 0);
+    void recordCommand(int64_t timeNs, const uint8_t* packet, size_t size, const PulseWidth commanded[4],
+                       uint8_t flags = 0);
+
+    uint64_t getRecordCount() const;
+
+private:
+    FlightRecorder();
+
+    FlightRecord* beginRecord(uint64_t* position);
+    void commitRecord(FlightRecord* record, uint64_t position);
+
+    std::atomic<FlightRecord*> m_records;
+    FlightRecorderHeader* m_header;
+    uint64_t m_capacity;
+    size_t m_mappedSize;
+    int m_fd;
+    std::atomic<bool> m_armed;
+
+    static FlightRecorder *theInstance_;
+};
+
+#endif // FLIGHTRECORDER_H
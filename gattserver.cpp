@@ -126,7 +126,8 @@ void GattServer::startBleService()
     QLowEnergyCharacteristicData charTxData;
     charTxData.setUuid(txUuid);
     charTxData.setValue(QByteArray(2, 0));
-    charTxData.setProperties(QLowEnergyCharacteristic::Write);
+    // Frames carry a CRC, so clients may skip the per-write response
+    charTxData.setProperties(QLowEnergyCharacteristic::Write | QLowEnergyCharacteristic::WriteNoResponse);
     const QLowEnergyDescriptorData txClientConfig(QBluetoothUuid::DescriptorType::ClientCharacteristicConfiguration, QByteArray(2, 0));
     charTxData.addDescriptor(txClientConfig);
     serviceData.addCharacteristic(charTxData);
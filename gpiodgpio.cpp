@@ -0,0 +1,131 @@
+#include "gpiodgpio.h"
+#include "logger.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <gpiod.h>
+
+GpiodGpio::GpiodGpio(const std::string& chipPath)
+    : m_chipPath(chipPath)
+    , m_chip(nullptr)
+    , m_request(nullptr)
+{
+}
+
+GpiodGpio::~GpiodGpio()
+{
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (m_request) {
+        gpiod_line_request_release(m_request);
+        m_request = nullptr;
+    }
+    if (m_chip) {
+        gpiod_chip_close(m_chip);
+        m_chip = nullptr;
+    }
+}
+
+bool GpiodGpio::setup()
+{
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (m_chip) {
+        return true;
+    }
+
+    m_chip = gpiod_chip_open(m_chipPath.c_str());
+    if (!m_chip) {
+        LOG_ERROR("Failed to open %s: %s", m_chipPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    LOG_INFO("libgpiod initialized on %s", m_chipPath.c_str());
+    return true;
+}
+
+bool GpiodGpio::configureOutput(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (!m_chip || pin < 0) {
+        return false;
+    }
+
+    if (std::find(m_offsets.begin(), m_offsets.end(), unsigned(pin)) == m_offsets.end()) {
+        m_offsets.push_back(unsigned(pin));
+    }
+    return requestLines();
+}
+
+void GpiodGpio::releasePin(int pin)
+{
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    auto it = std::find(m_offsets.begin(), m_offsets.end(), unsigned(pin));
+    if (it == m_offsets.end()) {
+        return;
+    }
+
+    m_offsets.erase(it);
+    requestLines();
+}
+
+void GpiodGpio::write(int pin, bool high)
+{
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (m_request) {
+        gpiod_line_request_set_value(m_request, unsigned(pin),
+                                     high ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE);
+    }
+}
+
+void GpiodGpio::writeMany(const int* pins, const bool* levels, int count)
+{
+    unsigned int offsets[MAX_BATCH];
+    gpiod_line_value values[MAX_BATCH];
+    count = std::min(count, MAX_BATCH);
+
+    for (int i = 0; i < count; ++i) {
+        offsets[i] = unsigned(pins[i]);
+        values[i] = levels[i] ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+    }
+
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    if (m_request && count > 0) {
+        gpiod_line_request_set_values_subset(m_request, size_t(count), offsets, values);
+    }
+}
+
+bool GpiodGpio::requestLines()
+{
+    if (m_request) {
+        gpiod_line_request_release(m_request);
+        m_request = nullptr;
+    }
+    if (m_offsets.empty()) {
+        return true;
+    }
+
+    gpiod_line_settings *settings = gpiod_line_settings_new();
+    gpiod_line_config *lineConfig = gpiod_line_config_new();
+    gpiod_request_config *requestConfig = gpiod_request_config_new();
+
+    bool ok = settings && lineConfig && requestConfig;
+    if (ok) {
+        gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT);
+        gpiod_line_settings_set_output_value(settings, GPIOD_LINE_VALUE_INACTIVE);
+        gpiod_request_config_set_consumer(requestConfig, "esccontrol");
+
+        ok = gpiod_line_config_add_line_settings(lineConfig, m_offsets.data(), m_offsets.size(), settings) == 0;
+    }
+    if (ok) {
+        m_request = gpiod_chip_request_lines(m_chip, requestConfig, lineConfig);
+        ok = m_request != nullptr;
+    }
+
+    if (!ok) {
+        LOG_ERROR("Failed to request GPIO lines on %s: %s", m_chipPath.c_str(), strerror(errno));
+    }
+
+    gpiod_request_config_free(requestConfig);
+    gpiod_line_config_free(lineConfig);
+    gpiod_line_settings_free(settings);
+    return ok;
+}
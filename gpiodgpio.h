@@ -0,0 +1,46 @@
+#ifndef GPIODGPIO_H
+#define GPIODGPIO_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gpiohal.h"
+
+struct gpiod_chip;
+struct gpiod_line_request;
+
+// libgpiod v2 backend. All output pins are held in a single line request so
+// writeMany() sets them with one GPIO_V2_LINE_SET_VALUES ioctl. Pin numbers
+// are line offsets on the chip (equal to BCM numbers on the Pi header chip).
+class GpiodGpio : public GpioHal
+{
+public:
+    static constexpr const char* DEFAULT_CHIP = "/dev/gpiochip0";
+
+    explicit GpiodGpio(const std::string& chipPath = DEFAULT_CHIP);
+    ~GpiodGpio();
+
+    GpioBackendType type() const override { return GpioBackendType::Gpiod; }
+    bool setup() override;
+    bool configureOutput(int pin) override;
+    void releasePin(int pin) override;
+    void write(int pin, bool high) override;
+    void writeMany(const int* pins, const bool* levels, int count) override;
+
+private:
+    static constexpr int MAX_BATCH = 64;
+
+    // Re-request the line set after a pin was added or removed
+    bool requestLines();
+
+    std::string m_chipPath;
+    gpiod_chip *m_chip;
+    gpiod_line_request *m_request;
+    std::vector<unsigned int> m_offsets;
+
+    // Serialises writes against re-requesting the lines, never contended
+    // once the ESCs are initialized
+    std::mutex m_requestMutex;
+};
+
+#endif // GPIODGPIO_H
@@ -0,0 +1,125 @@
+#include "gpiohal.h"
+#include "virtualgpio.h"
+#include "logger.h"
+#include <cstring>
+
+#ifdef HAVE_WIRINGPI
+#include "wiringpigpio.h"
+#endif
+#ifdef HAVE_LIBGPIOD
+#include "gpiodgpio.h"
+#endif
+
+GpioHal *GpioHal::theInstance_ = nullptr;
+bool GpioHal::theSelected_ = false;
+
+static GpioHal* createBackend(GpioBackendType type, const char* chipPath)
+{
+    switch (type) {
+#ifdef HAVE_WIRINGPI
+    case GpioBackendType::WiringPi:
+        return new WiringPiGpio();
+#endif
+#ifdef HAVE_LIBGPIOD
+    case GpioBackendType::Gpiod:
+        return new GpiodGpio(chipPath ? chipPath : GpiodGpio::DEFAULT_CHIP);
+#endif
+    case GpioBackendType::Virtual:
+        return new VirtualGpio();
+    default:
+        (void)chipPath;
+        return nullptr;
+    }
+}
+
+GpioHal* GpioHal::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+#if defined(HAVE_WIRINGPI)
+        theInstance_ = createBackend(GpioBackendType::WiringPi, nullptr);
+#elif defined(HAVE_LIBGPIOD)
+        theInstance_ = createBackend(GpioBackendType::Gpiod, nullptr);
+#else
+        LOG_ERROR("No GPIO driver compiled in (wiringPi or libgpiod), the virtual backend drives no pins; "
+                  "select it with --gpio=virtual to run without hardware");
+        theInstance_ = createBackend(GpioBackendType::Virtual, nullptr);
+#endif
+    }
+    return theInstance_;
+}
+
+bool GpioHal::select(GpioBackendType type, const char* chipPath)
+{
+    if (theInstance_ != nullptr) {
+        if (theInstance_->type() == type) {
+            return true;
+        }
+        LOG_ERROR("GPIO backend already set to %s", typeName(theInstance_->type()));
+        return false;
+    }
+
+    theInstance_ = createBackend(type, chipPath);
+    if (theInstance_ == nullptr) {
+        LOG_ERROR("GPIO backend %s is not compiled in", typeName(type));
+        return false;
+    }
+    theSelected_ = true;
+    return true;
+}
+
+bool GpioHal::isAvailable(GpioBackendType type)
+{
+    switch (type) {
+    case GpioBackendType::WiringPi:
+#ifdef HAVE_WIRINGPI
+        return true;
+#else
+        return false;
+#endif
+    case GpioBackendType::Gpiod:
+#ifdef HAVE_LIBGPIOD
+        return true;
+#else
+        return false;
+#endif
+    case GpioBackendType::Virtual:
+        return true;
+    }
+    return false;
+}
+
+bool GpioHal::typeFromName(const char* name, GpioBackendType* type)
+{
+    static const GpioBackendType types[] = {
+        GpioBackendType::WiringPi, GpioBackendType::Gpiod, GpioBackendType::Virtual
+    };
+
+    for (GpioBackendType candidate : types) {
+        if (strcmp(name, typeName(candidate)) == 0) {
+            *type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* GpioHal::typeName(GpioBackendType type)
+{
+    switch (type) {
+    case GpioBackendType::WiringPi:
+        return "wiringpi";
+    case GpioBackendType::Gpiod:
+        return "gpiod";
+    case GpioBackendType::Virtual:
+        return "virtual";
+    }
+    return "unknown";
+}
+
+void GpioHal::writeMany(const int* pins, const bool* levels, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        write(pins[i], levels[i]);
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef GPIOHAL_H
+#define GPIOHAL_H
+
+#include <cstdint>
+
+// Which GPIO driver the pins are driven through
+enum class GpioBackendType {
+    WiringPi,       // wiringPi digitalWrite, one register write per pin
+    Gpiod,          // libgpiod v2 line request, several lines per ioctl
+    Virtual         // in-memory pins with timestamped edges, no hardware needed
+};
+
+// GPIO hardware abstraction used by the ESC outputs. Pins are BCM numbers.
+//
+// One backend is active per process. It is chosen with select() before the
+// first getInstance() call, otherwise the default is the first one compiled
+// in (wiringPi, libgpiod). wiringPi and libgpiod are only built when the
+// libraries are found, so the controller also builds off a Pi; without either
+// the default is the virtual backend, which drives no pins, and
+// ESCControlThread refuses to start on it unless it was selected explicitly.
+class GpioHal
+{
+public:
+    virtual ~GpioHal() = default;
+
+    static GpioHal* getInstance();
+
+    // Pick the backend, fails if it is not compiled in or already chosen differently
+    static bool select(GpioBackendType type, const char* chipPath = nullptr);
+
+    // True once select() picked the backend, false for the compiled-in default
+    static bool isSelected() { return theSelected_; }
+    static bool isAvailable(GpioBackendType type);
+    static bool typeFromName(const char* name, GpioBackendType* type);
+    static const char* typeName(GpioBackendType type);
+
+    virtual GpioBackendType type() const = 0;
+
+    // Open the GPIO driver, safe to call more than once
+    virtual bool setup() = 0;
+
+    // Claim a pin as output, driven low
+    virtual bool configureOutput(int pin) = 0;
+    virtual void releasePin(int pin) = 0;
+
+    // Real-time path, no allocation or locking beyond the driver call
+    virtual void write(int pin, bool high) = 0;
+
+    // Drive several pins in one call. The base version writes them one by one,
+    // backends that can set lines together override it.
+    virtual void writeMany(const int* pins, const bool* levels, int count);
+
+private:
+    static GpioHal *theInstance_;
+    static bool theSelected_;
+};
+
+#endif // GPIOHAL_H
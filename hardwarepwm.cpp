@@ -0,0 +1,121 @@
+#include "hardwarepwm.h"
+#include "logger.h"
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+HardwarePwm::HardwarePwm(int chip, int channel, const std::string& sysfsRoot)
+    : m_chip(chip)
+    , m_channel(channel)
+    , m_sysfsRoot(sysfsRoot)
+    , m_dutyCycleFd(-1)
+{
+}
+
+HardwarePwm::~HardwarePwm()
+{
+    close();
+}
+
+std::string HardwarePwm::channelPath() const
+{
+    return m_sysfsRoot + "/pwmchip" + std::to_string(m_chip) + "/pwm" + std::to_string(m_channel);
+}
+
+bool HardwarePwm::open(int periodNs, int dutyCycleNs)
+{
+    if (isOpen()) {
+        return true;
+    }
+
+    const std::string chipPath = m_sysfsRoot + "/pwmchip" + std::to_string(m_chip);
+    const std::string path = channelPath();
+    struct stat st;
+
+    // Export the channel unless it is already there
+    if (stat(path.c_str(), &st) != 0) {
+        if (!writeAttribute(chipPath + "/export", m_channel)) {
+            LOG_ERROR("Failed to export PWM channel %d on %s", m_channel, chipPath.c_str());
+            return false;
+        }
+
+        // udev needs a moment to create the channel directory and fix permissions
+        for (int retry = 0; retry < 50 && stat(path.c_str(), &st) != 0; ++retry) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // duty_cycle must never exceed period, clear it before changing the period
+    writeAttribute(path + "/duty_cycle", 0);
+
+    if (!writeAttribute(path + "/period", periodNs) ||
+        !writeAttribute(path + "/duty_cycle", dutyCycleNs) ||
+        !writeAttribute(path + "/enable", 1)) {
+        LOG_ERROR("Failed to configure hardware PWM %s", path.c_str());
+        return false;
+    }
+
+    // Keep duty_cycle open so every update is one write
+    m_dutyCycleFd = ::open((path + "/duty_cycle").c_str(), O_WRONLY | O_CLOEXEC);
+    if (m_dutyCycleFd < 0) {
+        LOG_ERROR("Failed to open %s/duty_cycle: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    LOG_INFO("Hardware PWM enabled on %s (period %dns)", path.c_str(), periodNs);
+    return true;
+}
+
+void HardwarePwm::close()
+{
+    if (!isOpen()) {
+        return;
+    }
+
+    ::close(m_dutyCycleFd);
+    m_dutyCycleFd = -1;
+
+    writeAttribute(channelPath() + "/enable", 0);
+}
+
+bool HardwarePwm::setDutyCycle(int dutyCycleNs)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    char buffer[16];
+    int len = snprintf(buffer, sizeof(buffer), "%d\n", dutyCycleNs);
+    return pwrite(m_dutyCycleFd, buffer, len, 0) == len;
+}
+
+int HardwarePwm::channelForGpio(int gpioPin)
+{
+    // RP1 PWM0: GPIO12 -> ch0, GPIO13 -> ch1, GPIO18 -> ch2, GPIO19 -> ch3
+    switch (gpioPin) {
+    case 12: return 0;
+    case 13: return 1;
+    case 18: return 2;
+    case 19: return 3;
+    default: return -1;
+    }
+}
+
+bool HardwarePwm::writeAttribute(const std::string& path, long value) const
+{
+    int fd = ::open(path.c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    char buffer[24];
+    int len = snprintf(buffer, sizeof(buffer), "%ld\n", value);
+    bool ok = write(fd, buffer, len) == len;
+    ::close(fd);
+    return ok;
+}
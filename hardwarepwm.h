@@ -0,0 +1,43 @@
+#ifndef HARDWAREPWM_H
+#define HARDWAREPWM_H
+
+#include <string>
+
+// One channel of a kernel PWM controller driven through the sysfs interface
+// (/sys/class/pwm/pwmchipN/pwmM). Once the channel is opened a pulse width
+// change is a single write to duty_cycle, the CPU does no work per pulse.
+// The sysfs root can be pointed at a plain directory tree for testing.
+class HardwarePwm
+{
+public:
+    static constexpr const char* DEFAULT_SYSFS_ROOT = "/sys/class/pwm";
+    static constexpr int DEFAULT_CHIP = 0;          // RP1 PWM0 with the pwm overlay loaded
+
+    HardwarePwm(int chip, int channel, const std::string& sysfsRoot = DEFAULT_SYSFS_ROOT);
+    ~HardwarePwm();
+
+    // Export the channel, program the period and enable the output
+    bool open(int periodNs, int dutyCycleNs);
+
+    // Disable the output and close the duty_cycle file
+    void close();
+
+    // Single write, duty cycle in nanoseconds
+    bool setDutyCycle(int dutyCycleNs);
+
+    bool isOpen() const { return m_dutyCycleFd >= 0; }
+    std::string channelPath() const;
+
+    // Raspberry Pi 5 (RP1) PWM0 channel for a GPIO pin, -1 if the pin has no hardware PWM
+    static int channelForGpio(int gpioPin);
+
+private:
+    bool writeAttribute(const std::string& path, long value) const;
+
+    int m_chip;
+    int m_channel;
+    std::string m_sysfsRoot;
+    int m_dutyCycleFd;
+};
+
+#endif // HARDWAREPWM_H
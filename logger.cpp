@@ -0,0 +1,204 @@
+#include "logger.h"
+#include "clock.h"
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+Logger* Logger::getInstance()
+{
+    // Never destroyed: objects torn down during exit may still log. The
+    // atexit hook writes out what is queued and stops the writer thread.
+    static Logger* instance = [] {
+        Logger* logger = new Logger();
+        std::atexit([] { Logger::getInstance()->stop(); });
+        return logger;
+    }();
+    return instance;
+}
+
+bool Logger::levelFromName(const char* name, LogLevel* level)
+{
+    static const struct { const char* name; LogLevel level; } levels[] = {
+        { "debug", LogLevel::Debug },
+        { "info", LogLevel::Info },
+        { "warning", LogLevel::Warning },
+        { "error", LogLevel::Error },
+        { "off", LogLevel::Off },
+    };
+    for (const auto& entry : levels) {
+        if (strcmp(name, entry.name) == 0) {
+            *level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::Logger()
+    : m_enqueuePos(0)
+    , m_dequeuePos(0)
+    , m_dropped(0)
+    , m_reportedDropped(0)
+    , m_level(LogLevel::Info)
+    , m_output(nullptr)
+    , m_running(true)
+{
+    static_assert((RING_SIZE & (RING_SIZE - 1)) == 0, "RING_SIZE must be a power of two");
+
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_thread = std::thread(&Logger::writerThread, this);
+}
+
+void Logger::setOutput(FILE* stream)
+{
+    m_output.store(stream, std::memory_order_relaxed);
+}
+
+void Logger::log(LogLevel level, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(level, 0, format, args);
+    va_end(args);
+}
+
+void Logger::logSuppressed(LogLevel level, uint32_t suppressed, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vlog(level, suppressed, format, args);
+    va_end(args);
+}
+
+void Logger::vlog(LogLevel level, uint32_t suppressed, const char* format, va_list args)
+{
+    // Claim a slot (bounded MPSC queue: a slot is free for position pos when
+    // its sequence equals pos, and holds a message when it equals pos + 1)
+    uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &m_slots[pos & (RING_SIZE - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t diff = int64_t(sequence) - int64_t(pos);
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Ring full, the writer is behind
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->suppressed = suppressed;
+    vsnprintf(slot->text, MESSAGE_SIZE, format, args);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (!m_running.load(std::memory_order_acquire)) {
+        // Shutting down, write it out now
+        std::lock_guard<std::mutex> lock(m_syncMutex);
+        drain();
+    }
+}
+
+bool Logger::drain()
+{
+    bool wrote = false;
+    uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot& slot = m_slots[pos & (RING_SIZE - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+            // Empty, or a producer is still formatting this slot
+            break;
+        }
+        write(slot);
+        slot.sequence.store(pos + RING_SIZE, std::memory_order_release);
+        ++pos;
+        m_dequeuePos.store(pos, std::memory_order_release);
+        wrote = true;
+    }
+
+    uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDropped) {
+        FILE* out = m_output.load(std::memory_order_relaxed);
+        fprintf(out ? out : stderr, "Logger: %llu messages dropped (ring full)\n",
+                (unsigned long long)(dropped - m_reportedDropped));
+        m_reportedDropped = dropped;
+        wrote = true;
+    }
+
+    if (wrote) {
+        FILE* out = m_output.load(std::memory_order_relaxed);
+        if (out) {
+            fflush(out);
+        } else {
+            fflush(stdout);
+            fflush(stderr);
+        }
+    }
+    return wrote;
+}
+
+void Logger::write(const Slot& slot)
+{
+    FILE* out = m_output.load(std::memory_order_relaxed);
+    if (!out) {
+        out = slot.level >= LogLevel::Warning ? stderr : stdout;
+    }
+    fputs(slot.text, out);
+    if (slot.suppressed) {
+        fprintf(out, " (%u similar messages suppressed)", slot.suppressed);
+    }
+    fputc('\n', out);
+}
+
+void Logger::writerThread()
+{
+    while (m_running.load(std::memory_order_acquire)) {
+        drain();
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+    }
+}
+
+void Logger::flush()
+{
+    uint64_t target = m_enqueuePos.load(std::memory_order_acquire);
+    if (!m_running.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(m_syncMutex);
+        drain();
+        return;
+    }
+    while (m_dequeuePos.load(std::memory_order_acquire) < target && m_running.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void Logger::stop()
+{
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    std::lock_guard<std::mutex> lock(m_syncMutex);
+    drain();
+}
+
+bool LogRateLimiter::allow(uint32_t* suppressed)
+{
+    int64_t nowNs = Clock::getInstance()->nowNs();
+    int64_t nextNs = m_nextNs.load(std::memory_order_relaxed);
+    if (nowNs < nextNs || !m_nextNs.compare_exchange_strong(nextNs, nowNs + m_intervalNs, std::memory_order_relaxed)) {
+        m_suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    *suppressed = m_suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
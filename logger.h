@@ -0,0 +1,132 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+// Asynchronous logger. Callers format into a slot of a fixed-size lock-free
+// ring and return; a background thread writes the slots out, so terminal I/O
+// never runs on the command or PWM paths. Producers do not allocate, lock or
+// block: when the ring is full the message is dropped and counted.
+//
+// Info and Debug go to stdout, Warning and Error to stderr, unless setOutput()
+// sends everything to one stream. Use the LOG_* macros below.
+class Logger
+{
+public:
+    static constexpr size_t MESSAGE_SIZE = 192;     // longer messages are truncated
+    static constexpr size_t RING_SIZE = 512;        // power of two
+    static constexpr int DRAIN_INTERVAL_MS = 10;
+
+    static Logger* getInstance();
+
+    static bool levelFromName(const char* name, LogLevel* level);
+
+    void setLevel(LogLevel level) { m_level.store(level, std::memory_order_relaxed); }
+    LogLevel getLevel() const { return m_level.load(std::memory_order_relaxed); }
+    bool isEnabled(LogLevel level) const { return level >= getLevel(); }
+
+    // Also applies to queued messages not yet written; nullptr restores the stdout/stderr split
+    void setOutput(FILE* stream);
+
+    void log(LogLevel level, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+    // As log(), noting how many messages a rate limiter dropped before this one
+    void logSuppressed(LogLevel level, uint32_t suppressed, const char* format, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    // Block until everything logged so far is written
+    void flush();
+
+    // Drain and stop the writer thread, later messages are written synchronously
+    void stop();
+
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    Logger();
+
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        LogLevel level;
+        uint32_t suppressed;
+        char text[MESSAGE_SIZE];
+    };
+
+    void vlog(LogLevel level, uint32_t suppressed, const char* format, va_list args);
+    bool drain();
+    void write(const Slot& slot);
+    void writerThread();
+
+    Slot m_slots[RING_SIZE];
+    alignas(64) std::atomic<uint64_t> m_enqueuePos;
+    alignas(64) std::atomic<uint64_t> m_dequeuePos;     // advanced by the consumer only
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_reportedDropped;                 // consumer side
+    std::atomic<LogLevel> m_level;
+    std::atomic<FILE*> m_output;
+    std::atomic<bool> m_running;
+    std::mutex m_syncMutex;                     // consumer side once the writer thread is stopped
+    std::thread m_thread;
+};
+
+// Lets one message through per interval and counts the rest. One instance per
+// call site (see LOG_*_EVERY), shared by every thread that reaches it.
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(int64_t intervalNs) : m_intervalNs(intervalNs), m_nextNs(INT64_MIN), m_suppressed(0) {}
+
+    // True if the message should be logged; *suppressed is the number dropped since the last one
+    bool allow(uint32_t* suppressed);
+
+private:
+    int64_t m_intervalNs;
+    std::atomic<int64_t> m_nextNs;
+    std::atomic<uint32_t> m_suppressed;
+};
+
+#define LOG_AT(level, ...) \
+    do { \
+        Logger* logger_ = Logger::getInstance(); \
+        if (logger_->isEnabled(level)) { \
+            logger_->log(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_AT_EVERY(level, intervalMs, ...) \
+    do { \
+        Logger* logger_ = Logger::getInstance(); \
+        if (logger_->isEnabled(level)) { \
+            static LogRateLimiter limiter_(int64_t(intervalMs) * 1000000LL); \
+            uint32_t suppressed_; \
+            if (limiter_.allow(&suppressed_)) { \
+                logger_->logSuppressed(level, suppressed_, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+// At most one message per intervalMs from this call site
+#define LOG_DEBUG_EVERY(intervalMs, ...) LOG_AT_EVERY(LogLevel::Debug, intervalMs, __VA_ARGS__)
+#define LOG_INFO_EVERY(intervalMs, ...) LOG_AT_EVERY(LogLevel::Info, intervalMs, __VA_ARGS__)
+#define LOG_WARNING_EVERY(intervalMs, ...) LOG_AT_EVERY(LogLevel::Warning, intervalMs, __VA_ARGS__)
+#define LOG_ERROR_EVERY(intervalMs, ...) LOG_AT_EVERY(LogLevel::Error, intervalMs, __VA_ARGS__)
+
+#endif // LOGGER_H
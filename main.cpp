@@ -1,14 +1,18 @@
 #include <QCoreApplication>
 #include "servocontroller.h"
-#include <iostream>
+#include "gpiohal.h"
+#include "logger.h"
+#include "flightrecorder.h"
 #include <signal.h>
+#include <cstring>
+#include <cstdlib>
 
 // Global servo controller instance for signal handling
 ServoController *g_servoController = nullptr;
 
 // Signal handler for clean shutdown
 void signalHandler(int signal) {
-    std::cout << "\nReceived signal " << signal << ", shutting down..." << std::endl;
+    LOG_INFO("Received signal %d, shutting down...", signal);
     if (g_servoController) {
         g_servoController->emergencyStop();
         g_servoController->stop();
@@ -20,7 +24,7 @@ int main(int argc, char *argv[])
 {
     QCoreApplication app(argc, argv);
 
-    std::cout << "Starting Balance Robot Servo Controller" << std::endl;
+    LOG_INFO("Starting Balance Robot Servo Controller");
 
     // Set up signal handlers for clean shutdown
     signal(SIGINT, signalHandler);   // Ctrl+C
@@ -30,23 +34,119 @@ int main(int argc, char *argv[])
     ServoController servoController;
     g_servoController = &servoController;
 
+    // --hw-pwm: drive the ESCs from the kernel PWM controller instead of the software scheduler,
+    // --hw-pwm-root=<path>: sysfs directory of the PWM controllers (default /sys/class/pwm)
+    // --protocol=<pwm|oneshot125|oneshot42|multishot|dshot150|dshot300|dshot600>: ESC signalling mode
+    // --dshot-bidir: bidirectional DShot, eRPM telemetry read back over SPI
+    // --dshot-3d: DShot 3D mapping, 1500μs = stop (the ESC must be configured for 3D)
+    // --gpio=<wiringpi|gpiod|virtual>: GPIO driver, --gpio-chip=<path>: gpiod chip device
+    // --slew=<us/s>: ramp the ESC setpoints at most this fast (0 = off)
+    // --command-timeout=<ms>: neutral when no command arrives in time, --failsafe=<jump|ramp>
+    // --trajectory-depth=<ms>: jitter buffer depth for timed setpoint batches (default 40)
+    // --log-level=<debug|info|warning|error|off>: least severe message written (default info)
+    // --flight-recorder[=<file>]: black-box record of every command and PWM frame
+    // (default /dev/shm/esc-flight.bin, keep it on tmpfs),
+    // --flight-recorder-records=<n>: ring capacity (64 bytes per record)
+    // --ble-capture=<file>: record the received BLE packets for BleReplay
+    const char* gpioName = nullptr;
+    const char* gpioChip = nullptr;
+    int commandTimeoutMs = 0;
+    const char* flightRecorderPath = nullptr;
+    uint64_t flightRecorderRecords = FlightRecorder::DEFAULT_CAPACITY;
+    FailsafeMode failsafeMode = FailsafeMode::Jump;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--hw-pwm") == 0) {
+            servoController.setPwmBackend(PwmBackend::Hardware);
+        } else if (strncmp(argv[i], "--hw-pwm-root=", 14) == 0) {
+            servoController.setHardwarePwmRoot(argv[i] + 14);
+        } else if (strncmp(argv[i], "--protocol=", 11) == 0) {
+            EscProtocol protocol;
+            if (!escProtocolFromName(argv[i] + 11, &protocol)) {
+                LOG_ERROR("Unknown ESC protocol: %s", argv[i] + 11);
+                return -1;
+            }
+            servoController.setEscProtocol(protocol);
+        } else if (strcmp(argv[i], "--dshot-bidir") == 0) {
+            servoController.setDShotBidirectional(true);
+        } else if (strcmp(argv[i], "--dshot-3d") == 0) {
+            servoController.setDShot3DMode(true);
+        } else if (strncmp(argv[i], "--gpio=", 7) == 0) {
+            gpioName = argv[i] + 7;
+        } else if (strncmp(argv[i], "--gpio-chip=", 12) == 0) {
+            gpioChip = argv[i] + 12;
+        } else if (strncmp(argv[i], "--slew=", 7) == 0) {
+            servoController.setSlewRate(atoi(argv[i] + 7));
+        } else if (strncmp(argv[i], "--command-timeout=", 18) == 0) {
+            commandTimeoutMs = atoi(argv[i] + 18);
+        } else if (strncmp(argv[i], "--trajectory-depth=", 19) == 0) {
+            servoController.setTrajectoryDepth(atoi(argv[i] + 19));
+        } else if (strncmp(argv[i], "--failsafe=", 11) == 0) {
+            if (strcmp(argv[i] + 11, "ramp") == 0) {
+                failsafeMode = FailsafeMode::Ramp;
+            } else if (strcmp(argv[i] + 11, "jump") == 0) {
+                failsafeMode = FailsafeMode::Jump;
+            } else {
+                LOG_ERROR("Unknown failsafe mode: %s", argv[i] + 11);
+                return -1;
+            }
+        } else if (strncmp(argv[i], "--log-level=", 12) == 0) {
+            LogLevel level;
+            if (!Logger::levelFromName(argv[i] + 12, &level)) {
+                LOG_ERROR("Unknown log level: %s", argv[i] + 12);
+                return -1;
+            }
+            Logger::getInstance()->setLevel(level);
+        } else if (strcmp(argv[i], "--flight-recorder") == 0) {
+            flightRecorderPath = FlightRecorder::DEFAULT_PATH;
+        } else if (strncmp(argv[i], "--flight-recorder=", 18) == 0) {
+            flightRecorderPath = argv[i] + 18;
+        } else if (strncmp(argv[i], "--flight-recorder-records=", 26) == 0) {
+            flightRecorderRecords = strtoull(argv[i] + 26, nullptr, 10);
+        } else if (strncmp(argv[i], "--ble-capture=", 14) == 0) {
+            servoController.setBleCapture(argv[i] + 14);
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            LOG_ERROR("Unknown option: %s", argv[i]);
+            return -1;
+        }
+    }
+
+    servoController.setCommandTimeout(commandTimeoutMs, failsafeMode);
+
+    if (gpioName) {
+        GpioBackendType gpioType;
+        if (!GpioHal::typeFromName(gpioName, &gpioType)) {
+            LOG_ERROR("Unknown GPIO backend: %s", gpioName);
+            return -1;
+        }
+        if (!GpioHal::select(gpioType, gpioChip)) {
+            return -1;
+        }
+    } else if (gpioChip && !GpioHal::select(GpioBackendType::Gpiod, gpioChip)) {
+        return -1;
+    }
+
+    if (flightRecorderPath && !FlightRecorder::getInstance()->open(flightRecorderPath, flightRecorderRecords)) {
+        return -1;
+    }
+
     // Initialize the servo controller system
     if (!servoController.initialize()) {
-        std::cerr << "Failed to initialize servo controller" << std::endl;
+        LOG_ERROR("Failed to initialize servo controller");
         return -1;
     }
 
-    std::cout << "Servo controller initialized successfully" << std::endl;
-    std::cout << "System ready - waiting for BLE connections..." << std::endl;
-    std::cout << "Send ARM command (0x03) via BLE to enable servo control" << std::endl;
-    std::cout << "Press Ctrl+C to exit" << std::endl;
+    LOG_INFO("Servo controller initialized successfully");
+    LOG_INFO("System ready - waiting for BLE connections...");
+    LOG_INFO("Send ARM command (0x03) via BLE to enable servo control");
+    LOG_INFO("Press Ctrl+C to exit");
 
     // Run the Qt event loop
     int result = app.exec();
 
     // Clean shutdown
-    std::cout << "Shutting down servo controller..." << std::endl;
+    LOG_INFO("Shutting down servo controller...");
     servoController.stop();
+    FlightRecorder::getInstance()->close();
 
     return result;
 }
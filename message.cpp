@@ -1,13 +1,127 @@
 #include "message.h"
+#include <string.h>
+#include <algorithm>
+
+static const uint16_t crcTable[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
 
 Message::Message()
 {
 }
 
-bool Message::parse(uint8_t *dataUART, uint8_t size, MessagePack *message)
+uint16_t Message::crc16(const uint8_t *data, int size)
+{
+    uint16_t crc = 0xffff;
+    for (int i = 0; i < size; i++) {
+        crc = uint16_t(crc << 8) ^ crcTable[(crc >> 8) ^ data[i]];
+    }
+    return crc;
+}
+
+void Message::packSetpoints(const uint16_t setpoints[4], uint8_t *out)
+{
+    // Two channels in 3 bytes: a[7:0], b[3:0] a[11:8], b[11:4]
+    for (int pair = 0; pair < 2; pair++) {
+        const uint16_t a = setpoints[2 * pair] & PackedMax;
+        const uint16_t b = setpoints[2 * pair + 1] & PackedMax;
+        out[3 * pair] = uint8_t(a & 0xFF);
+        out[3 * pair + 1] = uint8_t((a >> 8) | ((b & 0x0F) << 4));
+        out[3 * pair + 2] = uint8_t(b >> 4);
+    }
+}
+
+void Message::unpackSetpoints(const uint8_t *in, uint16_t setpoints[4])
+{
+    for (int pair = 0; pair < 2; pair++) {
+        setpoints[2 * pair] = uint16_t(in[3 * pair] | ((in[3 * pair + 1] & 0x0F) << 8));
+        setpoints[2 * pair + 1] = uint16_t((in[3 * pair + 1] >> 4) | (in[3 * pair + 2] << 4));
+    }
+}
+
+// Identifies the setpoints a delta frame is relative to
+static uint8_t baseCheck(const uint16_t base[4])
+{
+    uint8_t packed[PackedSize];
+    Message::packSetpoints(base, packed);
+    return uint8_t(Message::crc16(packed, PackedSize));
+}
+
+bool Message::packDelta(const uint16_t base[4], const uint16_t setpoints[4], uint8_t *out)
+{
+    for (int i = 0; i < 4; i++) {
+        const int delta = int(setpoints[i]) - int(base[i]);
+        if (delta < -127 || delta > 127) {
+            return false;
+        }
+        out[i] = uint8_t(int8_t(delta));
+    }
+    out[4] = baseCheck(base);
+    return true;
+}
+
+bool Message::unpackDelta(const uint16_t base[4], const uint8_t *in, uint16_t setpoints[4])
+{
+    if (in[4] != baseCheck(base)) {
+        return false;
+    }
+    uint16_t result[4];
+    for (int i = 0; i < 4; i++) {
+        const int value = int(base[i]) + int8_t(in[i]);
+        if (value < 0 || value > PackedMax) {
+            return false;
+        }
+        result[i] = uint16_t(value);
+    }
+    for (int i = 0; i < 4; i++) {
+        setpoints[i] = result[i];
+    }
+    return true;
+}
+
+// CRC of a frame whose length is known to be complete
+static bool frameCrcValid(const uint8_t *frame)
+{
+    const int crcOffset = 4 + frame[1];
+    const uint16_t received = uint16_t(frame[crcOffset] | (frame[crcOffset + 1] << 8));
+    return Message::crc16(frame, crcOffset) == received;
+}
+
+bool Message::parse(const uint8_t *dataUART, int size, MessageView *message)
 {
     // Safety check for null pointers and minimum packet size
-    if (!dataUART || !message || size < 4) {
+    if (!dataUART || !message || size < 4 + CrcSize) {
         return false;
     }
 
@@ -16,31 +130,42 @@ bool Message::parse(uint8_t *dataUART, uint8_t size, MessagePack *message)
         return false;
     }
 
-    // Initialize message fields
+    // Safety check for data length
+    if (dataUART[1] > size - 4 - CrcSize) {
+        return false;
+    }
+
+    if (!frameCrcValid(dataUART)) {
+        return false;
+    }
+
     message->header = dataUART[0];
     message->len = dataUART[1];
     message->rw = dataUART[2];
     message->command = dataUART[3];
+    message->data = dataUART + 4;
 
-    // Safety check for data length
-    if (message->len > MaxPayload || message->len > (size - 4)) {
-        return false;  // Prevent buffer overflow
-    }
+    return true;
+}
 
-    // Copy data with bounds checking
-    int data_index = 0;
-    for (int uart_index = 4; uart_index < (4 + message->len) && uart_index < size; uart_index++) {
-        if (data_index < MaxPayload) {
-            message->data[data_index++] = dataUART[uart_index];
-        } else {
-            return false;  // Buffer would overflow
-        }
+bool Message::parse(uint8_t *dataUART, int size, MessagePack *message)
+{
+    MessageView view;
+    if (!message || !parse(dataUART, size, &view)) {
+        return false;
     }
 
+    message->header = view.header;
+    message->len = view.len;
+    message->rw = view.rw;
+    message->command = view.command;
+    memcpy(message->data, view.data, view.len);
+    memcpy(message->CheckSum, view.data + view.len, CrcSize);
+
     return true;
 }
 
-uint8_t Message::create_pack(uint8_t RW, uint8_t command, QByteArray dataSend, uint8_t *dataUART)
+int Message::create_pack(uint8_t RW, uint8_t command, QByteArray dataSend, uint8_t *dataUART)
 {
     // Safety check
     if (!dataUART) {
@@ -49,9 +174,9 @@ uint8_t Message::create_pack(uint8_t RW, uint8_t command, QByteArray dataSend, u
 
     int dataSendLen = dataSend.length();
 
-    // Limit length to prevent buffer overflow
-    if (dataSendLen > MaxPayload) {
-        dataSendLen = MaxPayload;
+    // Limit length to what the len field can hold
+    if (dataSendLen > MaxLen) {
+        dataSendLen = MaxLen;
     }
 
     // Create header
@@ -65,5 +190,160 @@ uint8_t Message::create_pack(uint8_t RW, uint8_t command, QByteArray dataSend, u
         dataUART[4 + data_index] = dataSend.at(data_index);
     }
 
-    return dataSendLen + 4;
+    // CRC over everything before it, little-endian like the PWM fields
+    const uint16_t crc = crc16(dataUART, 4 + dataSendLen);
+    dataUART[4 + dataSendLen] = uint8_t(crc & 0xFF);
+    dataUART[5 + dataSendLen] = uint8_t(crc >> 8);
+
+    return dataSendLen + 4 + CrcSize;
+}
+
+// A header byte followed by an rw field that no sender uses is noise
+static bool headerPlausible(const uint8_t *frame, int size)
+{
+    return frame[0] == mHeader && (size < 3 || frame[2] == mWrite || frame[2] == mRead);
+}
+
+// Frame already checked by the decoder
+static void viewFrame(const uint8_t *frame, MessageView *message)
+{
+    message->header = frame[0];
+    message->len = frame[1];
+    message->rw = frame[2];
+    message->command = frame[3];
+    message->data = frame + 4;
+}
+
+MessageDecoder::MessageDecoder()
+    : m_input(nullptr)
+    , m_inputSize(0)
+    , m_inputPos(0)
+    , m_partialSize(0)
+    , m_partialUsed(0)
+    , m_skippedBytes(0)
+    , m_corruptFrames(0)
+{
+}
+
+void MessageDecoder::reset()
+{
+    m_input = nullptr;
+    m_inputSize = 0;
+    m_inputPos = 0;
+    m_partialSize = 0;
+    m_partialUsed = 0;
+}
+
+void MessageDecoder::feed(const uint8_t *data, int size)
+{
+    m_input = data;
+    m_inputSize = data ? size : 0;
+    m_inputPos = 0;
+}
+
+void MessageDecoder::resync()
+{
+    int next = 1;
+    while (next < m_partialSize && m_partial[next] != mHeader) {
+        next++;
+    }
+    m_skippedBytes += next;
+    m_partialSize -= next;
+    memmove(m_partial, m_partial + next, m_partialSize);
+}
+
+bool MessageDecoder::acceptLaterFrame()
+{
+    for (int pos = 1; pos + 4 + CrcSize <= m_partialSize; pos++) {
+        const uint8_t *start = m_partial + pos;
+        const int available = m_partialSize - pos;
+        if (headerPlausible(start, available) && 4 + start[1] + CrcSize <= available && frameCrcValid(start)) {
+            m_corruptFrames++;
+            m_skippedBytes += pos;
+            m_partialSize = available;
+            memmove(m_partial, start, m_partialSize);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool MessageDecoder::next(MessageView *message, const uint8_t **frame, int *frameSize)
+{
+    // Bytes after the frame returned last time from the buffer (left by a resync)
+    if (m_partialUsed > 0) {
+        m_partialSize -= m_partialUsed;
+        memmove(m_partial, m_partial + m_partialUsed, m_partialSize);
+        m_partialUsed = 0;
+    }
+
+    // Complete a frame split across chunks
+    while (m_partialSize > 0) {
+        if (!headerPlausible(m_partial, m_partialSize)) {
+            resync();
+            continue;
+        }
+        const int need = m_partialSize >= 2 ? 4 + m_partial[1] + CrcSize : 2;
+        if (m_partialSize < need) {
+            const int take = std::min(need - m_partialSize, m_inputSize - m_inputPos);
+            if (take == 0) {
+                // The length may be corrupt: a complete frame behind it is
+                // not held back until the claimed length has arrived
+                if (acceptLaterFrame()) {
+                    continue;
+                }
+                return false;
+            }
+            memcpy(m_partial + m_partialSize, m_input + m_inputPos, take);
+            m_partialSize += take;
+            m_inputPos += take;
+            continue;
+        }
+
+        if (!frameCrcValid(m_partial)) {
+            m_corruptFrames++;
+            resync();
+            continue;
+        }
+
+        // Whole frame, the buffer is free again once the caller is done with it
+        *frame = m_partial;
+        *frameSize = need;
+        m_partialUsed = need;
+        viewFrame(m_partial, message);
+        return true;
+    }
+
+    // Frames inside the current chunk, no copy
+    while (m_inputPos < m_inputSize) {
+        const uint8_t *start = m_input + m_inputPos;
+        const int available = m_inputSize - m_inputPos;
+        if (!headerPlausible(start, available)) {
+            m_skippedBytes++;
+            m_inputPos++;
+            continue;
+        }
+        if (available < 4 || available < 4 + start[1] + CrcSize) {
+            // Keep the beginning of the frame for the next chunk
+            memcpy(m_partial, start, available);
+            m_partialSize = available;
+            m_inputPos = m_inputSize;
+            return acceptLaterFrame() && next(message, frame, frameSize);
+        }
+
+        if (!frameCrcValid(start)) {
+            m_corruptFrames++;
+            m_skippedBytes++;
+            m_inputPos++;
+            continue;
+        }
+
+        *frame = start;
+        *frameSize = 4 + start[1] + CrcSize;
+        m_inputPos += *frameSize;
+        viewFrame(start, message);
+        return true;
+    }
+
+    return false;
 }
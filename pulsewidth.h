@@ -0,0 +1,56 @@
+#ifndef PULSEWIDTH_H
+#define PULSEWIDTH_H
+
+#include <cstdint>
+
+// ESC command pulse width in fixed point, 1/16μs per tick. The command range
+// 1000-2000μs is 16000-32000 ticks, so a value still fits the 16-bit BLE
+// fields. Backends that resolve finer than 1μs (hardware PWM, DShot) use the
+// fraction, the bit-banged output gets it as nanoseconds.
+class PulseWidth
+{
+public:
+    static constexpr int FRACTION_BITS = 4;
+    static constexpr int32_t TICKS_PER_US = 1 << FRACTION_BITS;
+    static constexpr int MAX_US = INT32_MAX / TICKS_PER_US;
+    static constexpr int MIN_US = INT32_MIN / TICKS_PER_US;
+
+    constexpr PulseWidth() : m_ticks(0) {}
+
+    static constexpr PulseWidth fromTicks(int32_t ticks) { return PulseWidth(ticks); }
+
+    // Saturates instead of overflowing for out-of-range integer commands;
+    // the setters clamp the result to the command range anyway
+    static constexpr PulseWidth fromUs(int us)
+    {
+        return PulseWidth(us > MAX_US ? MAX_US * TICKS_PER_US
+                                      : (us < MIN_US ? MIN_US * TICKS_PER_US : us * TICKS_PER_US));
+    }
+
+    constexpr int32_t ticks() const { return m_ticks; }
+
+    // Nearest whole microsecond, for the integer APIs and the legacy protocol
+    constexpr int roundedUs() const { return (m_ticks + TICKS_PER_US / 2) >> FRACTION_BITS; }
+
+    // Exact value, for logging
+    constexpr double microseconds() const { return double(m_ticks) / TICKS_PER_US; }
+
+    constexpr int64_t nanoseconds() const { return int64_t(m_ticks) * 1000 / TICKS_PER_US; }
+
+    constexpr PulseWidth clamped(PulseWidth low, PulseWidth high) const
+    {
+        return m_ticks < low.m_ticks ? low : (m_ticks > high.m_ticks ? high : *this);
+    }
+
+    constexpr bool operator==(PulseWidth other) const { return m_ticks == other.m_ticks; }
+    constexpr bool operator!=(PulseWidth other) const { return m_ticks != other.m_ticks; }
+    constexpr bool operator<(PulseWidth other) const { return m_ticks < other.m_ticks; }
+    constexpr bool operator>(PulseWidth other) const { return m_ticks > other.m_ticks; }
+
+private:
+    explicit constexpr PulseWidth(int32_t ticks) : m_ticks(ticks) {}
+
+    int32_t m_ticks;
+};
+
+#endif // PULSEWIDTH_H
@@ -0,0 +1,480 @@
+#include "pwmscheduler.h"
+#include "dshot.h"
+#include "logger.h"
+#include <algorithm>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include "gpiohal.h"
+#include "clock.h"
+
+PwmScheduler *PwmScheduler::theInstance_ = nullptr;
+
+PwmScheduler* PwmScheduler::getInstance()
+{
+    if (theInstance_ == nullptr)
+    {
+        theInstance_ = new PwmScheduler();
+    }
+    return theInstance_;
+}
+
+PwmScheduler::PwmScheduler()
+    : m_channelCount(0)
+    , m_isRunning(false)
+    , m_threadAttached(false)
+    , m_framePeriodNs(DEFAULT_PERIOD_NS)
+    , m_frameListener(nullptr)
+    , m_frameCount(0)
+    , m_overrunCount(0)
+    , m_skippedFrameCount(0)
+    , m_lastRiseNs(0)
+    , m_frameLatch{}
+    , m_latchRetryCount(0)
+{
+}
+
+PwmScheduler::~PwmScheduler()
+{
+    stopThread();
+}
+
+int PwmScheduler::addChannel(int gpioPin, int pulseWidthNs, int64_t periodNs, int64_t toleranceNs)
+{
+    std::lock_guard<std::mutex> lock(m_channelMutex);
+
+    for (int id = 0; id < MAX_CHANNELS; ++id) {
+        if (m_channels[id].gpioPin.load() != -1) {
+            continue;
+        }
+
+        // Width first so the frame loop never sees the pin with a stale value
+        setPulseWidth(id, pulseWidthNs);
+        m_channels[id].periodNs = periodNs;
+        m_channels[id].toleranceNs = toleranceNs;
+        m_channels[id].digitalOutput = nullptr;
+        m_channels[id].pulseError.reset();
+        m_channels[id].missedDeadlines = 0;
+        m_channels[id].gpioPin = gpioPin;
+        ++m_channelCount;
+        updateFramePeriod();
+
+        if (!m_isRunning.load()) {
+            startThread();
+        }
+
+        LOG_INFO("PWM channel %d added for GPIO pin %d", id, gpioPin);
+        return id;
+    }
+
+    LOG_ERROR("No free PWM channel for GPIO pin %d", gpioPin);
+    return -1;
+}
+
+int PwmScheduler::addDigitalChannel(int gpioPin, DShotOutput* output, int64_t periodNs)
+{
+    std::lock_guard<std::mutex> lock(m_channelMutex);
+
+    for (int id = 0; id < MAX_CHANNELS; ++id) {
+        if (m_channels[id].gpioPin.load() != -1) {
+            continue;
+        }
+
+        setPulseWidth(id, 0);
+        m_channels[id].periodNs = periodNs;
+        m_channels[id].toleranceNs = 0;
+        m_channels[id].digitalOutput = output;
+        m_channels[id].pulseError.reset();
+        m_channels[id].missedDeadlines = 0;
+        m_channels[id].gpioPin = gpioPin;
+        ++m_channelCount;
+        updateFramePeriod();
+
+        if (!m_isRunning.load()) {
+            startThread();
+        }
+
+        LOG_INFO("DShot channel %d added for GPIO pin %d", id, gpioPin);
+        return id;
+    }
+
+    LOG_ERROR("No free PWM channel for GPIO pin %d", gpioPin);
+    return -1;
+}
+
+void PwmScheduler::removeChannel(int channelId)
+{
+    if (channelId < 0 || channelId >= MAX_CHANNELS) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_channelMutex);
+
+    int gpioPin = m_channels[channelId].gpioPin.exchange(-1);
+    if (gpioPin == -1) {
+        return;
+    }
+    --m_channelCount;
+    updateFramePeriod();
+
+    // The frame in progress may still be transmitting through the output,
+    // wait for it so the caller can destroy the output afterwards
+    if (m_channels[channelId].digitalOutput.exchange(nullptr) != nullptr) {
+        waitForFrameEnd();
+    }
+
+    LOG_INFO("PWM channel %d removed for GPIO pin %d", channelId, gpioPin);
+
+    if (m_channelCount == 0) {
+        stopThread();
+    }
+}
+
+void PwmScheduler::setFrameListener(PwmFrameListener* listener)
+{
+    PwmFrameListener* previous = m_frameListener.exchange(listener, std::memory_order_acq_rel);
+    if (previous != nullptr && listener == nullptr) {
+        waitForFrameEnd();
+    }
+}
+
+void PwmScheduler::waitForFrameEnd()
+{
+    uint64_t frame = m_frameCount.load();
+    while (m_isRunning.load() && m_frameCount.load() == frame) {
+        Clock::getInstance()->sleepForNs(100000);
+    }
+}
+
+void PwmScheduler::setChannelTiming(int channelId, int64_t periodNs, int64_t toleranceNs)
+{
+    if (channelId < 0 || channelId >= MAX_CHANNELS) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_channelMutex);
+
+    m_channels[channelId].toleranceNs = toleranceNs;
+    m_channels[channelId].periodNs = periodNs;
+    updateFramePeriod();
+}
+
+void PwmScheduler::setPulseWidth(int channelId, int pulseWidthNs)
+{
+    if (channelId < 0 || channelId >= MAX_CHANNELS) {
+        return;
+    }
+    PulseUpdate update{channelId, pulseWidthNs};
+    setPulseWidths(&update, 1);
+}
+
+void PwmScheduler::setPulseWidths(const PulseUpdate* updates, int count)
+{
+    m_pulseLatch.update([updates, count](PulseLatch& latch) { applyUpdates(&latch, updates, count); });
+}
+
+bool PwmScheduler::trySetPulseWidths(const PulseUpdate* updates, int count)
+{
+    return m_pulseLatch.tryUpdate([updates, count](PulseLatch& latch) { applyUpdates(&latch, updates, count); }) != 0;
+}
+
+void PwmScheduler::applyUpdates(PulseLatch* latch, const PulseUpdate* updates, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (updates[i].channelId >= 0 && updates[i].channelId < MAX_CHANNELS) {
+            latch->pulseWidthNs[updates[i].channelId] = updates[i].pulseWidthNs;
+        }
+    }
+}
+
+bool PwmScheduler::isRunning() const
+{
+    return m_isRunning.load();
+}
+
+int PwmScheduler::getChannelCount() const
+{
+    std::lock_guard<std::mutex> lock(m_channelMutex);
+    return m_channelCount;
+}
+
+TimingSummary PwmScheduler::getPulseErrorStats(int channelId) const
+{
+    if (channelId < 0 || channelId >= MAX_CHANNELS) {
+        return TimingSummary();
+    }
+    return m_channels[channelId].pulseError.summary();
+}
+
+uint64_t PwmScheduler::getMissedDeadlineCount(int channelId) const
+{
+    if (channelId < 0 || channelId >= MAX_CHANNELS) {
+        return 0;
+    }
+    return m_channels[channelId].missedDeadlines.load(std::memory_order_relaxed);
+}
+
+TimingSummary PwmScheduler::getPeriodErrorStats() const
+{
+    return m_periodError.summary();
+}
+
+void PwmScheduler::resetTimingStats()
+{
+    for (int id = 0; id < MAX_CHANNELS; ++id) {
+        m_channels[id].pulseError.reset();
+        m_channels[id].missedDeadlines.store(0, std::memory_order_relaxed);
+    }
+    m_periodError.reset();
+    m_sleepEstimator.resetMetrics();
+    m_overrunCount.store(0, std::memory_order_relaxed);
+    m_skippedFrameCount.store(0, std::memory_order_relaxed);
+}
+
+void PwmScheduler::updateFramePeriod()
+{
+    // Called with m_channelMutex held
+    int64_t periodNs = 0;
+
+    for (int id = 0; id < MAX_CHANNELS; ++id) {
+        if (m_channels[id].gpioPin.load() == -1) {
+            continue;
+        }
+        int64_t channelPeriod = m_channels[id].periodNs.load();
+        if (periodNs == 0 || channelPeriod < periodNs) {
+            periodNs = channelPeriod;
+        }
+    }
+
+    m_framePeriodNs = periodNs > 0 ? periodNs : DEFAULT_PERIOD_NS;
+}
+
+void PwmScheduler::startThread()
+{
+    m_isRunning = true;
+    m_threadAttached = false;
+    m_thread = std::thread(&PwmScheduler::schedulerThread, this);
+
+    // A virtual clock must not advance past the first frame before the new
+    // thread is attached to it
+    while (!m_threadAttached.load()) {
+        std::this_thread::yield();
+    }
+
+    // Only this thread needs real-time priority, everything else stays in the normal class
+    struct sched_param params;
+    params.sched_priority = sched_get_priority_max(SCHED_FIFO);
+
+    if (pthread_setschedparam(m_thread.native_handle(), SCHED_FIFO, &params) != 0) {
+        LOG_WARNING("Warning: Could not set high priority for PWM scheduler thread");
+    }
+}
+
+void PwmScheduler::stopThread()
+{
+    m_isRunning = false;
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void PwmScheduler::schedulerThread()
+{
+    LOG_INFO("PWM scheduler thread started");
+
+    // A virtual clock only advances while this thread sleeps on it
+    ClockThread clockThread;
+    m_threadAttached = true;
+
+    // Default 50μs timer slack would be added to every sleep of a non-RT thread
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+    // Seed the sleep estimator, it keeps adapting on every sleep afterwards
+    int64_t start = clockNowNs();
+    Clock::getInstance()->sleepUntilNs(start + 100000);
+    m_sleepEstimator.reset(clockNowNs() - start - 100000);
+    m_sleepEstimator.resetMetrics();
+
+    LOG_INFO("PWM scheduler initial spin margin: %lldμs", (long long)(m_sleepEstimator.spinMarginNs() / 1000));
+
+    m_frameCount = 0;
+    m_overrunCount = 0;
+    m_skippedFrameCount = 0;
+    m_lastRiseNs = 0;
+
+    int64_t t0 = clockNowNs();
+    int64_t periodNs = m_framePeriodNs.load();
+    uint64_t frameIndex = 0;
+    uint64_t frameNumber = 0;
+
+    while (m_isRunning.load()) {
+        const int64_t frameStart = t0 + int64_t(frameIndex) * periodNs;
+
+        runFrame(frameStart, frameNumber++);
+        m_frameCount.fetch_add(1, std::memory_order_relaxed);
+
+        // Next frame on the absolute timeline
+        ++frameIndex;
+        int64_t nextFrameStart = t0 + int64_t(frameIndex) * periodNs;
+        int64_t now = clockNowNs();
+
+        if (now > nextFrameStart) {
+            // Overrun: skip the slots already missed instead of shifting the timeline
+            m_overrunCount.fetch_add(1, std::memory_order_relaxed);
+
+            uint64_t missed = uint64_t((now - nextFrameStart) / periodNs) + 1;
+            m_skippedFrameCount.fetch_add(missed, std::memory_order_relaxed);
+            frameIndex += missed;
+            nextFrameStart = t0 + int64_t(frameIndex) * periodNs;
+        }
+
+        // A protocol change starts a new timeline at the next frame boundary
+        int64_t newPeriodNs = m_framePeriodNs.load(std::memory_order_relaxed);
+        if (newPeriodNs != periodNs) {
+            t0 = nextFrameStart;
+            periodNs = newPeriodNs;
+            frameIndex = 0;
+            frameNumber = 0;
+            m_lastRiseNs = 0;
+        }
+
+        // Wait for the rest of the period
+        waitUntil(nextFrameStart);
+    }
+
+    LOG_INFO("PWM scheduler thread stopped");
+}
+
+void PwmScheduler::runFrame(int64_t frameStartNs, uint64_t frameNumber)
+{
+    // Latch pending commands before the snapshot
+    PwmFrameListener* listener = m_frameListener.load(std::memory_order_acquire);
+    if (listener) {
+        listener->onFrameStart(frameStartNs);
+    }
+
+    // Snapshot the channels due in this frame, sorted by falling edge
+    Edge edges[MAX_CHANNELS];
+    int edgeCount = 0;
+    DShotOutput* digitalOutputs[MAX_CHANNELS];
+    int digitalCount = 0;
+    const int64_t framePeriodNs = m_framePeriodNs.load(std::memory_order_relaxed);
+
+    // One consistent copy of all widths for the whole frame. If a writer was
+    // preempted mid-commit keep the previous frame's widths.
+    if (!m_pulseLatch.tryLoad(&m_frameLatch)) {
+        m_latchRetryCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    const PulseLatch& latch = m_frameLatch;
+
+    for (int id = 0; id < MAX_CHANNELS; ++id) {
+        int gpioPin = m_channels[id].gpioPin.load(std::memory_order_acquire);
+        if (gpioPin == -1) {
+            continue;
+        }
+
+        // Slower protocols are pulsed every n-th frame
+        uint64_t divider = uint64_t(std::max<int64_t>(1, m_channels[id].periodNs.load(std::memory_order_relaxed) / framePeriodNs));
+        if (frameNumber % divider != 0) {
+            continue;
+        }
+
+        DShotOutput* digitalOutput = m_channels[id].digitalOutput.load(std::memory_order_acquire);
+        if (digitalOutput) {
+            digitalOutputs[digitalCount++] = digitalOutput;
+            continue;
+        }
+
+        Edge edge{id, gpioPin,
+                  latch.pulseWidthNs[id],
+                  m_channels[id].toleranceNs.load(std::memory_order_relaxed),
+                  0};
+
+        // Insertion sort, at most MAX_CHANNELS entries
+        int pos = edgeCount++;
+        while (pos > 0 && edges[pos - 1].pulseWidthNs > edge.pulseWidthNs) {
+            edges[pos] = edges[pos - 1];
+            --pos;
+        }
+        edges[pos] = edge;
+    }
+
+    // DShot frames first, the sinks block until the frame is clocked out
+    for (int i = 0; i < digitalCount; ++i) {
+        digitalOutputs[i]->transmitFrame();
+    }
+
+    // Raise all pins in one GPIO call. Falling edges are measured from the
+    // time the call returned: a late wake-up shifts the pulse but never
+    // shortens it, and on a backend that writes the pins one by one the last
+    // pin raised still gets its full width (the earlier ones get the write
+    // time on top).
+    GpioHal* gpio = GpioHal::getInstance();
+    int pins[MAX_CHANNELS];
+    bool levels[MAX_CHANNELS];
+
+    for (int i = 0; i < edgeCount; ++i) {
+        pins[i] = edges[i].gpioPin;
+        levels[i] = true;
+    }
+    gpio->writeMany(pins, levels, edgeCount);
+
+    const int64_t riseNs = std::max(frameStartNs, clockNowNs());
+    for (int i = 0; i < edgeCount; ++i) {
+        edges[i].riseNs = riseNs;
+    }
+
+    if (m_lastRiseNs != 0) {
+        m_periodError.record(riseNs - m_lastRiseNs - framePeriodNs);
+    }
+    m_lastRiseNs = riseNs;
+
+    // Drop each pin at its own deadline; pins whose deadline has also passed
+    // by then (equal pulse widths) go low in the same GPIO call
+    int i = 0;
+    while (i < edgeCount) {
+        waitUntil(riseNs + edges[i].pulseWidthNs);
+
+        const int64_t nowNs = clockNowNs();
+        int batch = 0;
+        do {
+            pins[batch] = edges[i + batch].gpioPin;
+            levels[batch] = false;
+            ++batch;
+        } while (i + batch < edgeCount && riseNs + edges[i + batch].pulseWidthNs <= nowNs);
+        gpio->writeMany(pins, levels, batch);
+
+        const int64_t fallNs = clockNowNs();
+        for (int j = i; j < i + batch; ++j) {
+            Channel& channel = m_channels[edges[j].channelId];
+            channel.pulseError.record(fallNs - edges[j].riseNs - edges[j].pulseWidthNs);
+            if (fallNs - (riseNs + edges[j].pulseWidthNs) > edges[j].toleranceNs) {
+                channel.missedDeadlines.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        i += batch;
+    }
+}
+
+void PwmScheduler::waitUntil(int64_t deadlineNs)
+{
+    // Absolute sleep up to the adaptive spin margin, then spin for the last stretch
+    const int64_t marginNs = m_sleepEstimator.spinMarginNs();
+    int64_t wakeNs = deadlineNs - marginNs;
+    Clock* clock = Clock::getInstance();
+    int64_t sleptMarginNs = 0;
+    if (wakeNs > clock->nowNs()) {
+        clock->sleepUntilNs(wakeNs);
+        m_sleepEstimator.addSample(clock->nowNs() - wakeNs);
+        sleptMarginNs = marginNs;
+    }
+
+    int64_t spinStart = clock->nowNs();
+    clock->spinUntilNs(deadlineNs);
+    m_sleepEstimator.addSpinTime(clock->nowNs() - spinStart, sleptMarginNs);
+}
+
+int64_t PwmScheduler::clockNowNs()
+{
+    return Clock::getInstance()->nowNs();
+}
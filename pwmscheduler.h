@@ -0,0 +1,174 @@
+#ifndef PWMSCHEDULER_H
+#define PWMSCHEDULER_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include "timinghistogram.h"
+#include "sleepestimator.h"
+#include "seqlock.h"
+
+class DShotOutput;
+
+// Hook run by the scheduler thread at the start of every frame, before the
+// channel snapshot, so pulse widths set from it are output in that frame.
+// Must not block; it runs inside the real-time frame loop.
+class PwmFrameListener
+{
+public:
+    virtual ~PwmFrameListener() = default;
+    virtual void onFrameStart(int64_t frameStartNs) = 0;
+};
+
+// Single real-time thread that generates the software PWM signal for every
+// registered ESC channel. Each frame all active pins are raised together and
+// dropped one by one at their own falling edge, so the whole controller uses
+// at most one core regardless of the number of ESCs.
+//
+// Frames are scheduled on an absolute CLOCK_MONOTONIC timeline (frame N starts
+// at t0 + N * period), so a late frame does not push the following ones back.
+//
+// Channels may run different ESC protocols. The frame period is the shortest
+// channel period and a slower channel is pulsed every (its period / frame
+// period) frames, so the protocol periods must divide each other. Mixing a
+// standard PWM channel with a kHz protocol makes every 40th frame overrun.
+// DShot channels are clocked out through their sink at the start of the
+// frame, before the analog pins are raised.
+//
+// Pulse widths live in one latch that the frame loop reads once per frame,
+// so the widths committed together by setPulseWidths() are always output in
+// the same frame and a frame never mixes an old and a new command.
+class PwmScheduler
+{
+public:
+    static constexpr int MAX_CHANNELS = 8;
+    static constexpr int64_t DEFAULT_PERIOD_NS = 20000000;  // 50Hz frame
+
+    struct PulseUpdate {
+        int channelId;
+        int pulseWidthNs;
+    };
+
+    static PwmScheduler* getInstance();
+
+    // Register a GPIO pin, returns the channel id or -1 if no slot is free.
+    // The scheduler thread is started with the first channel.
+    // A falling edge later than toleranceNs counts as a missed deadline.
+    int addChannel(int gpioPin, int pulseWidthNs, int64_t periodNs, int64_t toleranceNs);
+
+    // Register a DShot channel, the output is transmitted once per period
+    int addDigitalChannel(int gpioPin, DShotOutput* output, int64_t periodNs);
+
+    // Unregister a channel, the thread is stopped with the last channel.
+    // For a DShot channel this returns only after the current frame is done.
+    void removeChannel(int channelId);
+
+    // Change the frame period and tolerance of a channel (protocol switch)
+    void setChannelTiming(int channelId, int64_t periodNs, int64_t toleranceNs);
+
+    // Lock-free, picked up at the start of the next frame
+    void setPulseWidth(int channelId, int pulseWidthNs);
+
+    // Commit several widths atomically, they take effect in the same frame
+    void setPulseWidths(const PulseUpdate* updates, int count);
+
+    // setPulseWidths() for real-time callers (the frame listener): never
+    // sleeps on a concurrent writer, returns false without committing
+    // anything if one holds the latch, the caller retries next frame
+    bool trySetPulseWidths(const PulseUpdate* updates, int count);
+
+    // Install or clear (nullptr) the frame listener. Clearing returns only
+    // after a running frame is done, so the listener can be destroyed.
+    void setFrameListener(PwmFrameListener* listener);
+
+    bool isRunning() const;
+    int getChannelCount() const;
+
+    int64_t getFramePeriodNs() const { return m_framePeriodNs.load(std::memory_order_relaxed); }
+
+    // Frame statistics since the thread was started
+    uint64_t getFrameCount() const { return m_frameCount.load(std::memory_order_relaxed); }
+    uint64_t getOverrunCount() const { return m_overrunCount.load(std::memory_order_relaxed); }
+    uint64_t getSkippedFrameCount() const { return m_skippedFrameCount.load(std::memory_order_relaxed); }
+    uint64_t getLatchRetryCount() const { return m_latchRetryCount.load(std::memory_order_relaxed); }
+
+    // Measured high time versus requested pulse width, per channel
+    TimingSummary getPulseErrorStats(int channelId) const;
+    uint64_t getMissedDeadlineCount(int channelId) const;
+
+    // Interval between consecutive frames versus the frame period
+    TimingSummary getPeriodErrorStats() const;
+
+    // Adaptive sleep/spin calibration
+    int64_t getSpinMarginNs() const { return m_sleepEstimator.getMarginNs(); }
+    uint64_t getSpinTimeNs() const { return m_sleepEstimator.getSpinTimeNs(); }
+    uint64_t getSpinTimeSavedNs() const { return m_sleepEstimator.getSpinTimeSavedNs(); }
+    uint64_t getLateWakeupCount() const { return m_sleepEstimator.getLateWakeups(); }
+
+    // Clear all histograms and counters, callable from any thread
+    void resetTimingStats();
+
+private:
+    PwmScheduler();
+    ~PwmScheduler();
+
+    PwmScheduler(const PwmScheduler&) = delete;
+    PwmScheduler& operator=(const PwmScheduler&) = delete;
+
+    struct Channel {
+        std::atomic<int> gpioPin{-1};               // -1 = free slot
+        std::atomic<int64_t> periodNs{DEFAULT_PERIOD_NS};
+        std::atomic<int64_t> toleranceNs{0};
+        std::atomic<DShotOutput*> digitalOutput{nullptr};
+        TimingHistogram pulseError;
+        std::atomic<uint64_t> missedDeadlines{0};
+    };
+
+    struct Edge {
+        int channelId;
+        int gpioPin;
+        int pulseWidthNs;
+        int64_t toleranceNs;
+        int64_t riseNs;
+    };
+
+    void startThread();
+    void stopThread();
+    void schedulerThread();
+    void updateFramePeriod();
+    void runFrame(int64_t frameStartNs, uint64_t frameNumber);
+    void waitUntil(int64_t deadlineNs);
+    void waitForFrameEnd();
+
+    static int64_t clockNowNs();
+
+    // Pulse widths of all channels, committed together and read once per frame
+    struct PulseLatch {
+        int32_t pulseWidthNs[MAX_CHANNELS];
+    };
+    static void applyUpdates(PulseLatch* latch, const PulseUpdate* updates, int count);
+
+    Channel m_channels[MAX_CHANNELS];
+    SeqLock<PulseLatch> m_pulseLatch;
+    mutable std::mutex m_channelMutex;              // add/remove only, never taken by the frame loop
+    int m_channelCount;
+    std::atomic<bool> m_isRunning;
+    std::thread m_thread;
+    std::atomic<bool> m_threadAttached;             // scheduler thread holds its ClockThread
+    SleepEstimator m_sleepEstimator;
+    std::atomic<int64_t> m_framePeriodNs;           // shortest active channel period
+    std::atomic<PwmFrameListener*> m_frameListener;
+
+    std::atomic<uint64_t> m_frameCount;
+    std::atomic<uint64_t> m_overrunCount;           // frames that ended after the next frame start
+    std::atomic<uint64_t> m_skippedFrameCount;      // whole frames dropped to get back on the timeline
+    TimingHistogram m_periodError;
+    int64_t m_lastRiseNs;
+    PulseLatch m_frameLatch;                        // scheduler thread copy of the latch
+    std::atomic<uint64_t> m_latchRetryCount;        // frames that reused the previous widths
+
+    static PwmScheduler *theInstance_;
+};
+
+#endif // PWMSCHEDULER_H
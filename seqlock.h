@@ -0,0 +1,184 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <thread>
+#include <mutex>
+
+// Sequence lock for a small trivially copyable value.
+//
+// Readers never block and never write shared memory: they copy the value and
+// retry if a write overlapped the copy, so the PWM thread can read it every
+// frame without contending with the producers. Writers are serialised by a
+// mutex that only producers take, so a writer preempted mid-write puts the
+// other producers to sleep instead of spinning; a reader that keeps finding
+// the sequence odd yields after SPIN_LIMIT attempts.
+//
+// A real-time reader must use tryLoad(), and a real-time writer tryStore()
+// or tryUpdate():
+// spinning or sleeping on a preempted lower priority writer on the same core
+// would never let that writer finish.
+//
+// The payload is stored as relaxed atomic words so the racy copy is not a
+// data race in the C++ memory model.
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+public:
+    SeqLock()
+        : m_sequence(0)
+    {
+        store(T());
+    }
+
+    explicit SeqLock(const T& value)
+        : m_sequence(0)
+    {
+        store(T(value));
+    }
+
+    // Publish a new value, returns its sequence number (always even)
+    uint64_t store(const T& value)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        uint64_t sequence = beginWrite();
+        writeWords(value);
+        m_sequence.store(sequence + 2, std::memory_order_release);
+        return sequence + 2;
+    }
+
+    // Publish unless another writer holds the writer side, for a real-time
+    // writer that must not sleep on the mutex. Returns 0 when nothing was
+    // stored.
+    uint64_t tryStore(const T& value)
+    {
+        std::unique_lock<std::mutex> lock(m_writeMutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return 0;
+        }
+        uint64_t sequence = beginWrite();
+        writeWords(value);
+        m_sequence.store(sequence + 2, std::memory_order_release);
+        return sequence + 2;
+    }
+
+    // Read-modify-write under the writer side, for partial updates that must
+    // not lose a concurrent writer's change. modify(T&) must not block.
+    template <typename Modify>
+    uint64_t update(Modify modify)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        return modifyLocked(modify);
+    }
+
+    // update() unless another writer holds the writer side, returns 0 when
+    // modify was not called (real-time writers)
+    template <typename Modify>
+    uint64_t tryUpdate(Modify modify)
+    {
+        std::unique_lock<std::mutex> lock(m_writeMutex, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            return 0;
+        }
+        return modifyLocked(modify);
+    }
+
+    // Consistent copy of the latest value, returns its sequence number
+    uint64_t load(T* value) const
+    {
+        uint64_t sequence;
+        while (!tryLoad(value, &sequence)) {
+            std::this_thread::yield();
+        }
+        return sequence;
+    }
+
+    // Bounded read: gives up after SPIN_LIMIT attempts that overlapped a write
+    bool tryLoad(T* value, uint64_t* sequence = nullptr) const
+    {
+        uint64_t words[WORDS];
+        for (int attempt = 0; attempt < SPIN_LIMIT; ++attempt) {
+            uint64_t before = m_sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (size_t i = 0; i < WORDS; ++i) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+
+            memcpy(value, words, sizeof(T));
+            if (sequence) {
+                *sequence = before;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    T load() const
+    {
+        T value;
+        load(&value);
+        return value;
+    }
+
+    // Sequence of the last completed store, cheap change check for readers
+    uint64_t sequence() const { return m_sequence.load(std::memory_order_acquire) & ~uint64_t(1); }
+
+private:
+    // Writer mutex held: read, modify and publish the value
+    template <typename Modify>
+    uint64_t modifyLocked(Modify& modify)
+    {
+        uint64_t sequence = beginWrite();
+
+        uint64_t words[WORDS];
+        for (size_t i = 0; i < WORDS; ++i) {
+            words[i] = m_words[i].load(std::memory_order_relaxed);
+        }
+        T value;
+        memcpy(&value, words, sizeof(T));
+
+        modify(value);
+
+        writeWords(value);
+        m_sequence.store(sequence + 2, std::memory_order_release);
+        return sequence + 2;
+    }
+
+    // Writer mutex held: mark the write in progress (odd sequence)
+    uint64_t beginWrite()
+    {
+        uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return sequence;
+    }
+
+    void writeWords(const T& value)
+    {
+        uint64_t words[WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < WORDS; ++i) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    static constexpr int SPIN_LIMIT = 64;
+    static constexpr size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::mutex m_writeMutex;
+    std::atomic<uint64_t> m_sequence;
+    std::atomic<uint64_t> m_words[WORDS];
+};
+
+#endif // SEQLOCK_H
@@ -1,72 +1,100 @@
 #include "servocontroller.h"
-#include <iostream>
 #include <algorithm>
-#include <wiringPi.h>
+#include "gpiohal.h"
+#include "logger.h"
+#include "flightrecorder.h"
+#include "clock.h"
 
 ServoController::ServoController(QObject *parent)
     : QObject(parent)
     , gattServer(nullptr)
+    , pwmBackend(PwmBackend::Software)
+    , hardwarePwmRoot(HardwarePwm::DEFAULT_SYSFS_ROOT)
+    , escProtocol(EscProtocol::StandardPwm)
+    , dshotBidirectional(false)
+    , dshot3dMode(false)
+    , slewRate(0)
+    , commandTimeoutMs(0)
+    , failsafeMode(FailsafeMode::Jump)
+    , trajectoryDepthMs(int(TrajectoryBuffer::DEFAULT_DEPTH_NS / 1000000))
     , systemArmed(false)
     , bleConnected(false)
     , initialized(false)
+    , bleEnabled(true)
+    , trajectorySynced(false)
+    , trajectorySenderMs(0)
 {
-    std::cout << "ServoController created" << std::endl;
+    std::fill(commandedPwm, commandedPwm + 4, PWM_NEUTRAL);
+    LOG_INFO("ServoController created");
 }
 
 ServoController::~ServoController()
 {
     stop();
-    std::cout << "ServoController destroyed" << std::endl;
+    LOG_INFO("ServoController destroyed");
 }
 
 bool ServoController::initialize()
 {
     if (initialized) {
-        std::cout << "ServoController already initialized" << std::endl;
+        LOG_INFO("ServoController already initialized");
         return true;
     }
 
-    std::cout << "Initializing ServoController..." << std::endl;
+    LOG_INFO("Initializing ServoController...");
 
-    // Initialize WiringPi first
-    if (wiringPiSetupGpio() == -1) {
-        std::cerr << "Failed to initialize WiringPi" << std::endl;
+    // Initialize the GPIO backend first
+    if (!GpioHal::getInstance()->setup()) {
+        LOG_ERROR("Failed to initialize GPIO");
         return false;
     }
-    std::cout << "WiringPi initialized successfully" << std::endl;
+    LOG_INFO("GPIO backend: %s", GpioHal::typeName(GpioHal::getInstance()->type()));
 
     // Create ESC control thread instance
-    escControl = std::make_unique<ESCControlThread>();
-
-    // Initialize the ESC control thread (WiringPi already initialized)
+    escControl = std::make_unique<ESCControlThread>(pwmBackend);
+    escControl->setHardwarePwmRoot(hardwarePwmRoot);
+    escControl->setProtocol(escProtocol);
+    escControl->setDShotBidirectional(dshotBidirectional);
+    escControl->setDShot3DMode(dshot3dMode);
+    escControl->setAllSlewRate(slewRate);
+    escControl->setCommandTimeout(commandTimeoutMs, failsafeMode);
+    escControl->setTrajectoryDepth(trajectoryDepthMs);
+
+    // Initialize the ESC control thread (GPIO already initialized)
     if (!escControl->initialize()) {
-        std::cerr << "Failed to initialize ESC control" << std::endl;
+        LOG_ERROR("Failed to initialize ESC control");
         return false;
     }
 
-    std::cout << "ESC Control Thread initialized successfully" << std::endl;
-    std::cout << "ESC1 Pin: " << ESCControlThread::PIN_ESC_1 << std::endl;
-    std::cout << "ESC2 Pin: " << ESCControlThread::PIN_ESC_2 << std::endl;
+    LOG_INFO("ESC Control Thread initialized successfully");
+    LOG_INFO("ESC1 Pin: %d", ESCControlThread::PIN_ESC_1);
+    LOG_INFO("ESC2 Pin: %d", ESCControlThread::PIN_ESC_2);
 
-    // Initialize GATT server
-    gattServer = GattServer::getInstance();
-    if (!gattServer) {
-        std::cerr << "Failed to get GATT server instance" << std::endl;
+    if (!bleCapturePath.empty() && !bleCapture.open(bleCapturePath)) {
         return false;
     }
 
-    // Connect BLE data reception to our servo control handler
-    connect(gattServer, &GattServer::dataReceived, this, &ServoController::onBleDataReceived);
-    connect(gattServer, &GattServer::connectionState, this, &ServoController::onConnectionStateChanged);
+    if (bleEnabled) {
+        // Initialize GATT server
+        gattServer = GattServer::getInstance();
+        if (!gattServer) {
+            LOG_ERROR("Failed to get GATT server instance");
+            return false;
+        }
+
+        // Connect BLE data reception to our servo control handler
+        connect(gattServer, &GattServer::dataReceived, this, &ServoController::onBleDataReceived);
+        connect(gattServer, &GattServer::connectionState, this, &ServoController::onConnectionStateChanged);
 
-    // Start BLE service
-    gattServer->startBleService();
+        // Start BLE service
+        gattServer->startBleService();
+    }
 
     // Initialize message parser
     messageParser = std::make_unique<Message>();
 
     initialized = true;
-    std::cout << "ServoController initialized - ready for BLE commands" << std::endl;
+    LOG_INFO("ServoController initialized - ready for BLE commands");
     return true;
 }
 
@@ -76,7 +104,7 @@ void ServoController::stop()
         return;
     }
 
-    std::cout << "Stopping ServoController..." << std::endl;
+    LOG_INFO("Stopping ServoController...");
 
     // Disarm system and stop ESCs
     disarmSystem();
@@ -91,8 +119,19 @@ void ServoController::stop()
         escControl->stop();
     }
 
+    bleCapture.close();
+    const TrajectoryStats trajectory = escControl ? escControl->getTrajectoryStats() : TrajectoryStats();
+    if (trajectory.batches > 0) {
+        LOG_INFO("Trajectory playback: %llu batches, %llu points, %llu played, %llu late, %llu overruns, %llu underruns",
+                 (unsigned long long)trajectory.batches, (unsigned long long)trajectory.points,
+                 (unsigned long long)trajectory.played, (unsigned long long)trajectory.late,
+                 (unsigned long long)trajectory.overruns, (unsigned long long)trajectory.underruns);
+    }
+    if (messageDecoder.getCorruptFrames() > 0) {
+        LOG_WARNING("%llu BLE frames dropped for a CRC mismatch", (unsigned long long)messageDecoder.getCorruptFrames());
+    }
     initialized = false;
-    std::cout << "ServoController stopped" << std::endl;
+    LOG_INFO("ServoController stopped");
 }
 
 bool ServoController::isRunning() const
@@ -102,8 +141,10 @@ bool ServoController::isRunning() const
 
 void ServoController::emergencyStop()
 {
-    std::cout << "EMERGENCY STOP ACTIVATED!" << std::endl;
+    LOG_WARNING("EMERGENCY STOP ACTIVATED!");
     systemArmed = false;
+    FlightRecorder::getInstance()->setArmed(false);
+    std::fill(commandedPwm, commandedPwm + 4, PWM_NEUTRAL);
     if (escControl) {
         escControl->emergencyStop();
     }
@@ -112,13 +153,16 @@ void ServoController::emergencyStop()
 void ServoController::armSystem()
 {
     systemArmed = true;
-    std::cout << "System ARMED" << std::endl;
+    FlightRecorder::getInstance()->setArmed(true);
+    LOG_INFO("System ARMED");
 }
 
 void ServoController::disarmSystem()
 {
-    std::cout << "System DISARMED" << std::endl;
+    LOG_INFO("System DISARMED");
     systemArmed = false;
+    FlightRecorder::getInstance()->setArmed(false);
+    std::fill(commandedPwm, commandedPwm + 4, PWM_NEUTRAL);
     if (escControl) {
         escControl->emergencyStop();
     }
@@ -126,18 +170,40 @@ void ServoController::disarmSystem()
 
 void ServoController::onBleDataReceived(const QByteArray &data)
 {
-    // Parse the received message
-    MessagePack message;
-    uint8_t *rawData = (uint8_t*)data.data();
-
-    if (!messageParser->parse(rawData, data.size(), &message)) {
-        std::cerr << "Failed to parse BLE message" << std::endl;
-        return;
+    // A write may hold part of a frame or several frames, the decoder
+    // reassembles them; views point into data or the decoder buffer
+    const uint8_t *rawData = reinterpret_cast<const uint8_t*>(data.constData());
+    const int64_t receivedNs = Clock::getInstance()->nowNs();
+    bleCapture.write(BleEventType::Data, rawData, data.size());
+
+    const uint64_t skippedBefore = messageDecoder.getSkippedBytes();
+    const uint64_t corruptBefore = messageDecoder.getCorruptFrames();
+    messageDecoder.feed(rawData, data.size());
+
+    MessageView message;
+    const uint8_t *frame;
+    int frameSize;
+    while (messageDecoder.next(&message, &frame, &frameSize)) {
+        handleMessage(message);
+
+        // Black box: the frame and the widths commanded after it
+        FlightRecorder::getInstance()->recordCommand(receivedNs, frame, frameSize, commandedPwm);
     }
 
-    // std::cout << "Received BLE command: 0x" << std::hex << (int)message.command
-    //           << " with " << std::dec << (int)message.len << " bytes of data" << std::endl;
+    if (messageDecoder.getSkippedBytes() != skippedBefore) {
+        FlightRecorder::getInstance()->recordCommand(receivedNs, rawData, data.size(), nullptr, FlightRecord::ParseError);
+        if (messageDecoder.getCorruptFrames() != corruptBefore) {
+            LOG_ERROR_EVERY(1000, "BLE frame CRC mismatch, %llu corrupt frames so far",
+                            (unsigned long long)messageDecoder.getCorruptFrames());
+        } else {
+            LOG_ERROR_EVERY(1000, "Skipped %llu bytes of BLE data without a valid frame",
+                            (unsigned long long)(messageDecoder.getSkippedBytes() - skippedBefore));
+        }
+    }
+}
 
+void ServoController::handleMessage(const MessageView &message)
+{
     // Handle servo commands
     switch (message.command) {
     case mSERVO1: // ESC1 control
@@ -156,6 +222,26 @@ void ServoController::onBleDataReceived(const QByteArray &data)
         handleServoCommand(4, message);
         break;
 
+    case mSERVOFINE: // All ESCs, 1/16μs resolution
+        handleServoCommand(0, message, true);
+        break;
+
+    case mSERVOPACKED: // All ESCs, 12-bit packed
+        handlePackedCommand(message, false);
+        break;
+
+    case mSERVODELTA: // All ESCs, change from the last setpoints
+        handlePackedCommand(message, true);
+        break;
+
+    case mSERVOTRAJ: // All ESCs, timed setpoints
+        handleTrajectoryCommand(message);
+        break;
+
+    case mCAPS:
+        sendCapabilities();
+        break;
+
     case mArmed:
         armSystem();
         break;
@@ -165,7 +251,7 @@ void ServoController::onBleDataReceived(const QByteArray &data)
         break;
 
     default:
-        std::cout << "Unknown command: 0x" << std::hex << (int)message.command << std::endl;
+        LOG_WARNING_EVERY(1000, "Unknown command: 0x%x", (int)message.command);
         break;
     }
 }
@@ -173,26 +259,36 @@ void ServoController::onBleDataReceived(const QByteArray &data)
 void ServoController::onConnectionStateChanged(bool connected)
 {
     bleConnected = connected;
+    bleCapture.write(connected ? BleEventType::Connected : BleEventType::Disconnected);
+
+    // A frame cut off by the old connection must not swallow the first bytes of the new one
+    messageDecoder.reset();
+
+    // A new connection brings a new sender clock
+    trajectorySynced = false;
+    if (escControl) {
+        escControl->clearTrajectory();
+    }
 
     if (connected) {
-        std::cout << "BLE Client connected" << std::endl;
+        LOG_INFO("BLE Client connected");
     } else {
-        std::cout << "BLE Client disconnected - Emergency stop" << std::endl;
+        LOG_INFO("BLE Client disconnected - Emergency stop");
         emergencyStop();
     }
 }
 
-void ServoController::handleServoCommand(int servoChannel, const MessagePack &message)
+void ServoController::handleServoCommand(int servoChannel, const MessageView &message, bool fineResolution)
 {
     if (!systemArmed) {
-        std::cout << "System not armed - ignoring servo command for channel " << servoChannel << std::endl;
+        LOG_INFO_EVERY(1000, "System not armed - ignoring servo command for channel %d", servoChannel);
         return;
     }
 
     // Each servo command should contain 4 PWM values (8 bytes total: 2 bytes per PWM)
     if (message.len < 8) {
-        std::cerr << "Invalid PWM data length for servo command (need 8 bytes for 4 PWMs, got "
-                  << (int)message.len << ")" << std::endl;
+        LOG_ERROR_EVERY(1000, "Invalid PWM data length for servo command (need 8 bytes for 4 PWMs, got %d)",
+                        (int)message.len);
         return;
     }
 
@@ -203,97 +299,238 @@ void ServoController::handleServoCommand(int servoChannel, const MessagePack &me
     uint16_t rawPwm4 = extractPwmValue(message.data, 6);  // Bytes 6-7: ESC4 PWM
 
     // Validate all PWM values
-    int pwmValue1 = validatePwmValue(rawPwm1);
-    int pwmValue2 = validatePwmValue(rawPwm2);
-    int pwmValue3 = validatePwmValue(rawPwm3);
-    int pwmValue4 = validatePwmValue(rawPwm4);   
+    ESCCommandBatch batch;
+    batch.pulseWidth[0] = validatePwmValue(rawPwm1, fineResolution);
+    batch.pulseWidth[1] = validatePwmValue(rawPwm2, fineResolution);
+    batch.pulseWidth[2] = validatePwmValue(rawPwm3, fineResolution);
+    batch.pulseWidth[3] = validatePwmValue(rawPwm4, fineResolution);
 
-        // Apply PWM values to all 4 ESCs
     switch (servoChannel) {
-    case 1: // mSERVO1 - Set all 4 ESCs with received values
-        escControl->setESC1PulseWidth(pwmValue1);
-        escControl->setESC2PulseWidth(pwmValue2);
-        escControl->setESC3PulseWidth(pwmValue3);
-        escControl->setESC4PulseWidth(pwmValue4);
+    case 0: // mSERVOFINE
+    case 1: // mSERVO1
+    case 2: // mSERVO2
+    case 3: // mSERVO3
+    case 4: // mSERVO4
         break;
 
-    case 2: // mSERVO2 - Set all 4 ESCs with received values
-        escControl->setESC1PulseWidth(pwmValue1);
-        escControl->setESC2PulseWidth(pwmValue2);
-        escControl->setESC3PulseWidth(pwmValue3);
-        escControl->setESC4PulseWidth(pwmValue4);
-        break;
+    default:
+        LOG_ERROR("Invalid servo channel: %d", servoChannel);
+        return;
+    }
 
-    case 3: // mSERVO3 - Set all 4 ESCs with received values
-        escControl->setESC1PulseWidth(pwmValue1);
-        escControl->setESC2PulseWidth(pwmValue2);
-        escControl->setESC3PulseWidth(pwmValue3);
-        escControl->setESC4PulseWidth(pwmValue4);
-        break;
+    applyServoCommand(servoChannel, batch);
+}
 
-    case 4: // mSERVO4 - Set all 4 ESCs with received values
-        escControl->setESC1PulseWidth(pwmValue1);
-        escControl->setESC2PulseWidth(pwmValue2);
-        escControl->setESC3PulseWidth(pwmValue3);
-        escControl->setESC4PulseWidth(pwmValue4);
-        break;
+void ServoController::handlePackedCommand(const MessageView &message, bool delta)
+{
+    const int servoChannel = delta ? DELTA_CHANNEL : PACKED_CHANNEL;
+    if (!systemArmed) {
+        LOG_INFO_EVERY(1000, "System not armed - ignoring servo command for channel %d", servoChannel);
+        return;
+    }
 
-    default:
-        std::cerr << "Invalid servo channel: " << servoChannel << std::endl;
+    const int size = delta ? DeltaSize : PackedSize;
+    if (message.len < size) {
+        LOG_ERROR_EVERY(1000, "Invalid %s servo command length (need %d bytes, got %d)",
+                        delta ? "delta" : "packed", size, (int)message.len);
         return;
     }
 
-    std::cout << "Set Pwm to servo channel " << servoChannel << " - PWM Values: "
-              << "ESC1=" << pwmValue1 << "μs, "
-              << "ESC2=" << pwmValue2 << "μs, "
-              << "ESC3=" << pwmValue3 << "μs, "
-              << "ESC4=" << pwmValue4 << "μs" << std::endl;
+    uint16_t setpoints[4];
+    if (delta) {
+        // Relative to what the last command set; after a lost frame or a
+        // stop the client's base differs and it has to send a packed frame
+        uint16_t base[4];
+        for (int i = 0; i < 4; ++i) {
+            base[i] = toPackedSetpoint(commandedPwm[i]);
+        }
+        if (!Message::unpackDelta(base, message.data, setpoints)) {
+            LOG_WARNING_EVERY(1000, "Delta servo command does not match the current setpoints - ignored");
+            return;
+        }
+    } else {
+        Message::unpackSetpoints(message.data, setpoints);
+    }
+
+    ESCCommandBatch batch;
+    for (int i = 0; i < 4; ++i) {
+        batch.pulseWidth[i] = fromPackedSetpoint(setpoints[i]);
+    }
+    applyServoCommand(servoChannel, batch);
+}
+
+void ServoController::handleTrajectoryCommand(const MessageView &message)
+{
+    if (!systemArmed) {
+        LOG_INFO_EVERY(1000, "System not armed - ignoring trajectory command");
+        return;
+    }
+
+    const int pointCount = (message.len - TrajHeaderSize) / TrajPointSize;
+    if (pointCount < 1 || message.len != TrajHeaderSize + pointCount * TrajPointSize) {
+        LOG_ERROR_EVERY(1000, "Invalid trajectory command length %d (%d + n x %d bytes)",
+                        (int)message.len, TrajHeaderSize, TrajPointSize);
+        return;
+    }
+
+    // The 16-bit sender time wraps every 65.5s, batches come far more often
+    const uint16_t senderMs = uint16_t(message.data[0] | (message.data[1] << 8));
+    if (!trajectorySynced) {
+        trajectorySenderMs = senderMs;
+        trajectorySynced = true;
+    } else {
+        trajectorySenderMs += int16_t(uint16_t(senderMs - uint16_t(trajectorySenderMs)));
+    }
+
+    TrajectoryPoint points[TrajMaxPoints];
+    const uint8_t *point = message.data + TrajHeaderSize;
+    for (int i = 0; i < pointCount; ++i, point += TrajPointSize) {
+        if (i > 0 && point[0] < point[-TrajPointSize]) {
+            LOG_ERROR_EVERY(1000, "Trajectory points out of time order - command ignored");
+            return;
+        }
+        uint16_t setpoints[4];
+        Message::unpackSetpoints(point + 1, setpoints);
+        points[i].timeNs = (trajectorySenderMs + point[0]) * 1000000LL;
+        for (int channel = 0; channel < 4; ++channel) {
+            points[i].pulseWidth[channel] = fromPackedSetpoint(setpoints[channel]);
+        }
+    }
+
+    escControl->submitTrajectory(trajectorySenderMs * 1000000LL, points, pointCount);
+
+    // The outputs end up at the last point unless a newer batch replaces it
+    std::copy(points[pointCount - 1].pulseWidth, points[pointCount - 1].pulseWidth + 4, commandedPwm);
+
+    const TrajectoryStats stats = escControl->getTrajectoryStats();
+    if (stats.underruns != reportedTrajectoryStats.underruns) {
+        LOG_WARNING_EVERY(1000, "Trajectory underrun, batch arrived after the buffer ran dry (%llu so far, depth %dms)",
+                          (unsigned long long)stats.underruns, trajectoryDepthMs);
+    }
+    if (stats.overruns != reportedTrajectoryStats.overruns) {
+        LOG_WARNING_EVERY(1000, "Trajectory buffer full, %llu points dropped so far",
+                          (unsigned long long)stats.overruns);
+    }
+    reportedTrajectoryStats = stats;
+
+    LOG_INFO_EVERY(COMMAND_LOG_INTERVAL_MS, "Trajectory of %d points over %dms - ESC1=%gμs, ESC2=%gμs, ESC3=%gμs, ESC4=%gμs at the end",
+                   pointCount, message.data[TrajHeaderSize + (pointCount - 1) * TrajPointSize],
+                   commandedPwm[0].microseconds(), commandedPwm[1].microseconds(),
+                   commandedPwm[2].microseconds(), commandedPwm[3].microseconds());
+
+    // Acknowledge with the buffer state so the sender can pace itself
+    if (gattServer) {
+        int64_t leadNs = 0;
+        const int queued = escControl->getQueuedTrajectoryPoints(&leadNs);
+        const int leadMs = int(std::min<int64_t>(leadNs / 1000000, UINT16_MAX));
+        const uint8_t status[3] = { uint8_t(queued), uint8_t(leadMs & 0xFF), uint8_t(leadMs >> 8) };
+        uint8_t responseBuffer[MessageDecoder::MaxFrame];
+        int responseLen = messageParser->create_pack(mRead, mSERVOTRAJ, QByteArray((const char*)status, sizeof(status)), responseBuffer);
+        gattServer->writeValue(QByteArray((char*)responseBuffer, responseLen));
+    }
+}
+
+uint16_t ServoController::toPackedSetpoint(PulseWidth pwm)
+{
+    const int ticksPerStep = PulseWidth::TICKS_PER_US / PackedStepsUs;
+    const int steps = (pwm.ticks() + ticksPerStep / 2) / ticksPerStep - PackedBaseUs * PackedStepsUs;
+    return uint16_t(std::min(std::max(steps, 0), PackedMax));
+}
+
+PulseWidth ServoController::fromPackedSetpoint(uint16_t setpoint)
+{
+    return PulseWidth::fromTicks((PackedBaseUs * PackedStepsUs + setpoint) * (PulseWidth::TICKS_PER_US / PackedStepsUs))
+        .clamped(PWM_MIN, PWM_MAX);
+}
+
+void ServoController::applyServoCommand(int servoChannel, const ESCCommandBatch &batch)
+{
+    // Apply all 4 PWM values as one command so they switch in the same PWM frame,
+    // a packet repeating the current values is skipped. A direct command
+    // ends a trajectory that is still playing.
+    escControl->clearTrajectory();
+    escControl->submitCommand(batch);
+    std::copy(batch.pulseWidth, batch.pulseWidth + 4, commandedPwm);
+
+    // Commands arrive at 50Hz or more, log a sample of them
+    LOG_INFO_EVERY(COMMAND_LOG_INTERVAL_MS, "Set Pwm to servo channel %d - PWM Values: ESC1=%gμs, ESC2=%gμs, ESC3=%gμs, ESC4=%gμs",
+                   servoChannel, batch.pulseWidth[0].microseconds(), batch.pulseWidth[1].microseconds(),
+                   batch.pulseWidth[2].microseconds(), batch.pulseWidth[3].microseconds());
 
     // Send acknowledgment with all 4 PWM values
-    sendAcknowledgment(servoChannel, pwmValue1, pwmValue2, pwmValue3, pwmValue4);
+    sendAcknowledgment(servoChannel, batch.pulseWidth);
 }
 
-void ServoController::sendAcknowledgment(int channel, int pwm1, int pwm2, int pwm3, int pwm4)
+void ServoController::sendAcknowledgment(int channel, const PulseWidth pwm[4])
 {
     if (!gattServer) {
         return;
     }
 
+    uint8_t responseBuffer[MessageDecoder::MaxFrame];
+    int responseLen;
+
+    if (channel == PACKED_CHANNEL || channel == DELTA_CHANNEL) {
+        // Packed clients get the applied setpoints back packed
+        uint16_t setpoints[4];
+        for (int i = 0; i < 4; ++i) {
+            setpoints[i] = toPackedSetpoint(pwm[i]);
+        }
+        uint8_t packed[PackedSize];
+        Message::packSetpoints(setpoints, packed);
+        responseLen = messageParser->create_pack(mRead, mSERVOPACKED, QByteArray((char*)packed, PackedSize), responseBuffer);
+        gattServer->writeValue(QByteArray((char*)responseBuffer, responseLen));
+        return;
+    }
+
     // Create response message with all 4 PWM values (8 bytes) + channel info
     QByteArray responseData;
 
-    // Add PWM1 (2 bytes, little-endian)
-    responseData.append((uint8_t)(pwm1 & 0xFF));
-    responseData.append((uint8_t)((pwm1 >> 8) & 0xFF));
-
-    // Add PWM2 (2 bytes, little-endian)
-    responseData.append((uint8_t)(pwm2 & 0xFF));
-    responseData.append((uint8_t)((pwm2 >> 8) & 0xFF));
-
-    // Add PWM3 (2 bytes, little-endian)
-    responseData.append((uint8_t)(pwm3 & 0xFF));
-    responseData.append((uint8_t)((pwm3 >> 8) & 0xFF));
-
-    // Add PWM4 (2 bytes, little-endian)
-    responseData.append((uint8_t)(pwm4 & 0xFF));
-    responseData.append((uint8_t)((pwm4 >> 8) & 0xFF));
+    // Add PWM1-PWM4 (2 bytes each, little-endian, whole μs)
+    for (int i = 0; i < 4; ++i) {
+        int us = pwm[i].roundedUs();
+        responseData.append((uint8_t)(us & 0xFF));
+        responseData.append((uint8_t)((us >> 8) & 0xFF));
+    }
 
     // Add channel info
     responseData.append((uint8_t)channel);
 
-    uint8_t responseBuffer[256];
-    uint8_t responseLen = messageParser->create_pack(mRead, mData, responseData, responseBuffer);
+    // Add PWM1-PWM4 again in 1/16μs (2 bytes each, little-endian); older
+    // clients only read the first 9 bytes
+    for (int i = 0; i < 4; ++i) {
+        int ticks = pwm[i].ticks();
+        responseData.append((uint8_t)(ticks & 0xFF));
+        responseData.append((uint8_t)((ticks >> 8) & 0xFF));
+    }
+
+    responseLen = messageParser->create_pack(mRead, mData, responseData, responseBuffer);
 
     QByteArray response((char*)responseBuffer, responseLen);
     gattServer->writeValue(response);
 
     // std::cout << "Sent acknowledgment for channel " << channel
-    //           << " with PWMs: " << pwm1 << ", " << pwm2 << ", " << pwm3 << ", " << pwm4 << "μs" << std::endl;
+    //           << " with PWMs: " << pwm[0].microseconds() << ", " << pwm[1].microseconds() << ", "
+    //           << pwm[2].microseconds() << ", " << pwm[3].microseconds() << "μs" << std::endl;
 }
 
-int ServoController::validatePwmValue(uint16_t rawPwm) const
+PulseWidth ServoController::validatePwmValue(uint16_t rawPwm, bool fineResolution) const
 {
-    return std::max(PWM_MIN, std::min(PWM_MAX, (int)rawPwm));
+    PulseWidth value = fineResolution ? PulseWidth::fromTicks(rawPwm) : PulseWidth::fromUs(rawPwm);
+    return value.clamped(PWM_MIN, PWM_MAX);
+}
+
+void ServoController::sendCapabilities()
+{
+    if (!gattServer) {
+        return;
+    }
+
+    const uint8_t capabilities = mCapsPacked | mCapsTrajectory;
+    uint8_t responseBuffer[MessageDecoder::MaxFrame];
+    int responseLen = messageParser->create_pack(mRead, mCAPS, QByteArray((const char*)&capabilities, 1), responseBuffer);
+    gattServer->writeValue(QByteArray((char*)responseBuffer, responseLen));
+    LOG_INFO("Sent capabilities: packed servo commands, trajectories");
 }
 
 uint16_t ServoController::extractPwmValue(const uint8_t* data, int offset) const
@@ -4,9 +4,11 @@
 #include <QObject>
 #include <QByteArray>
 #include <memory>
+#include <string>
 #include "esccontrolthread.h"
 #include "gattserver.h"
 #include "message.h"
+#include "blecapture.h"
 
 class ServoController : public QObject
 {
@@ -16,6 +18,36 @@ public:
     explicit ServoController(QObject *parent = nullptr);
     ~ServoController();
 
+    // Select the PWM backend, must be called before initialize()
+    void setPwmBackend(PwmBackend backend) { pwmBackend = backend; }
+    void setHardwarePwmRoot(const std::string& sysfsRoot) { hardwarePwmRoot = sysfsRoot; }
+
+    // Select the ESC protocol, must be called before initialize()
+    void setEscProtocol(EscProtocol protocol) { escProtocol = protocol; }
+
+    // Read eRPM telemetry back from DShot ESCs, call before initialize()
+    void setDShotBidirectional(bool enabled) { dshotBidirectional = enabled; }
+
+    // DShot 3D mapping (1500μs = stop) for ESCs configured for 3D, call before initialize()
+    void setDShot3DMode(bool enabled) { dshot3dMode = enabled; }
+
+    // Slew limit in μs/s for all ESCs (0 = off), call before initialize()
+    void setSlewRate(int usPerSecond) { slewRate = usPerSecond; }
+
+    // Neutral after timeoutMs without commands (0 = off), call before initialize()
+    void setCommandTimeout(int timeoutMs, FailsafeMode mode) { commandTimeoutMs = timeoutMs; failsafeMode = mode; }
+
+    // Jitter buffer depth for mSERVOTRAJ playback, call before initialize()
+    void setTrajectoryDepth(int depthMs) { trajectoryDepthMs = depthMs; }
+
+    // Run without the GATT server, input comes from onBleDataReceived() calls
+    // (replay), call before initialize()
+    void setBleEnabled(bool enabled) { bleEnabled = enabled; }
+
+    // Record every BLE packet and connection change to a file for BleReplay,
+    // call before initialize()
+    void setBleCapture(const std::string& path) { bleCapturePath = path; }
+
     // Initialize the servo controller system
     bool initialize();
 
@@ -28,25 +60,47 @@ public:
     // Get system status
     bool isArmed() const { return systemArmed; }
     bool isBleConnected() const { return bleConnected; }
+    uint64_t getCorruptFrameCount() const { return messageDecoder.getCorruptFrames(); }
+    TrajectoryStats getTrajectoryStats() const { return escControl ? escControl->getTrajectoryStats() : TrajectoryStats(); }
 
     // Manual control methods (for testing or emergency)
     void emergencyStop();
     void armSystem();
     void disarmSystem();
 
-private slots:
+public slots:
+    // BLE input, connected to the GattServer signals (public for replay)
     void onBleDataReceived(const QByteArray &data);
     void onConnectionStateChanged(bool connected);
 
 private:
-    // Handle different servo commands
-    void handleServoCommand(int servoChannel, const MessagePack &message);
+    // Dispatch one decoded frame
+    void handleMessage(const MessageView &message);
+
+    // Handle different servo commands, fineResolution: fields are in 1/16μs
+    void handleServoCommand(int servoChannel, const MessageView &message, bool fineResolution = false);
+
+    // Packed or delta setpoint frame (mSERVOPACKED / mSERVODELTA)
+    void handlePackedCommand(const MessageView &message, bool delta);
+
+    // Timed setpoint batch (mSERVOTRAJ) for the playback buffer
+    void handleTrajectoryCommand(const MessageView &message);
+
+    // Submit validated setpoints, log them and acknowledge
+    void applyServoCommand(int servoChannel, const ESCCommandBatch &batch);
+
+    // Answer a capability request (mCAPS)
+    void sendCapabilities();
+
+    // Pulse width as a packed setpoint (1/4μs steps above PackedBaseUs)
+    static uint16_t toPackedSetpoint(PulseWidth pwm);
+    static PulseWidth fromPackedSetpoint(uint16_t setpoint);
 
     // Send acknowledgment back to BLE client
-    void sendAcknowledgment(int channel, int pwm1, int pwm2, int pwm3, int pwm4);
+    void sendAcknowledgment(int channel, const PulseWidth pwm[4]);
 
-    // Validate PWM value
-    int validatePwmValue(uint16_t rawPwm) const;
+    // Validate PWM value (raw field in μs or 1/16μs)
+    PulseWidth validatePwmValue(uint16_t rawPwm, bool fineResolution) const;
 
     // Extract PWM values from message data
     uint16_t extractPwmValue(const uint8_t* data, int offset = 0) const;
@@ -56,16 +110,38 @@ private:
     std::unique_ptr<ESCControlThread> escControl;
     GattServer *gattServer;
     std::unique_ptr<Message> messageParser;
+    MessageDecoder messageDecoder;
 
     // System state
+    PwmBackend pwmBackend;
+    std::string hardwarePwmRoot;
+    EscProtocol escProtocol;
+    bool dshotBidirectional;
+    bool dshot3dMode;
+    int slewRate;
+    int commandTimeoutMs;
+    FailsafeMode failsafeMode;
+    int trajectoryDepthMs;
     bool systemArmed;
+    PulseWidth commandedPwm[4];         // last servo command, neutral after a stop (flight recorder)
     bool bleConnected;
     bool initialized;
+    bool bleEnabled;
+    std::string bleCapturePath;
+    BleCaptureWriter bleCapture;
+
+    // mSERVOTRAJ sender clock, unwrapped from its 16-bit ms field
+    bool trajectorySynced;
+    int64_t trajectorySenderMs;
+    TrajectoryStats reportedTrajectoryStats;   // counters already logged
 
     // Constants
-    static constexpr int PWM_MIN = 1000;
-    static constexpr int PWM_MAX = 2000;
-    static constexpr int PWM_NEUTRAL = 1500;
+    static constexpr PulseWidth PWM_MIN = PulseWidth::fromUs(1000);
+    static constexpr PulseWidth PWM_MAX = PulseWidth::fromUs(2000);
+    static constexpr PulseWidth PWM_NEUTRAL = PulseWidth::fromUs(1500);
+    static constexpr int COMMAND_LOG_INTERVAL_MS = 250;     // servo command echo rate limit
+    static constexpr int PACKED_CHANNEL = 5;                // servo channel of mSERVOPACKED, in logs and acks
+    static constexpr int DELTA_CHANNEL = 6;                 // servo channel of mSERVODELTA
 };
 
 #endif // SERVOCONTROLLER_H
@@ -0,0 +1,70 @@
+#include "sleepestimator.h"
+#include <algorithm>
+
+SleepEstimator::SleepEstimator(int64_t initialOvershootNs)
+    : m_publishedMarginNs(0)
+    , m_spinTimeNs(0)
+    , m_spinTimeSavedNs(0)
+    , m_lateWakeups(0)
+{
+    reset(initialOvershootNs);
+}
+
+void SleepEstimator::reset(int64_t initialOvershootNs)
+{
+    initialOvershootNs = std::max<int64_t>(0, initialOvershootNs);
+
+    m_meanNs = initialOvershootNs;
+    m_deviationNs = initialOvershootNs / 2;
+    m_staticMarginNs = initialOvershootNs;
+    m_marginNs = std::clamp(m_meanNs + 4 * m_deviationNs, MIN_MARGIN_NS, MAX_MARGIN_NS);
+    m_publishedMarginNs.store(m_marginNs, std::memory_order_relaxed);
+}
+
+void SleepEstimator::resetMetrics()
+{
+    m_spinTimeNs.store(0, std::memory_order_relaxed);
+    m_spinTimeSavedNs.store(0, std::memory_order_relaxed);
+    m_lateWakeups.store(0, std::memory_order_relaxed);
+}
+
+void SleepEstimator::addSample(int64_t overshootNs)
+{
+    overshootNs = std::max<int64_t>(0, overshootNs);
+
+    // Woke up after the deadline itself: the margin was too small
+    bool late = overshootNs > m_marginNs;
+
+    // Anything past the maximum margin is preemption, not sleep latency
+    overshootNs = std::min(overshootNs, MAX_MARGIN_NS);
+
+    // mean += (x - mean) / 8, dev += (|x - mean| - dev) / 4
+    int64_t error = overshootNs - m_meanNs;
+    m_meanNs += error / 8;
+    m_deviationNs += ((error < 0 ? -error : error) - m_deviationNs) / 4;
+
+    int64_t margin = m_meanNs + 4 * m_deviationNs;
+    if (late) {
+        m_lateWakeups.fetch_add(1, std::memory_order_relaxed);
+        // Widen at once, but at most double so one preemption does not pin it at the maximum
+        margin = std::max(margin, std::min(overshootNs + m_deviationNs, 2 * m_marginNs));
+    }
+
+    m_marginNs = std::clamp(margin, MIN_MARGIN_NS, MAX_MARGIN_NS);
+    m_publishedMarginNs.store(m_marginNs, std::memory_order_relaxed);
+}
+
+void SleepEstimator::addSpinTime(int64_t spinNs, int64_t sleptMarginNs)
+{
+    spinNs = std::max<int64_t>(0, spinNs);
+    m_spinTimeNs.fetch_add(uint64_t(spinNs), std::memory_order_relaxed);
+
+    // A wait that found its wake-up time already past spun all the way
+    if (sleptMarginNs <= 0 || m_staticMarginNs <= sleptMarginNs) {
+        return;
+    }
+    const int64_t savedNs = std::min(m_staticMarginNs - sleptMarginNs, m_staticMarginNs - spinNs);
+    if (savedNs > 0) {
+        m_spinTimeSavedNs.fetch_add(uint64_t(savedNs), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef SLEEPESTIMATOR_H
+#define SLEEPESTIMATOR_H
+
+#include <atomic>
+#include <cstdint>
+
+// Online estimate of how late an absolute sleep wakes up. The PWM thread
+// sleeps until (deadline - spinMargin) and busy-waits the rest, so the margin
+// should be as small as possible without waking up after the deadline.
+// Mean and mean deviation are tracked with integer EWMAs (like TCP's RTT
+// estimator) and the margin is mean + 4 * deviation. A wake-up past the
+// deadline widens it immediately.
+class SleepEstimator
+{
+public:
+    static constexpr int64_t MIN_MARGIN_NS = 2000;
+    static constexpr int64_t MAX_MARGIN_NS = 500000;
+
+    explicit SleepEstimator(int64_t initialOvershootNs = 50000);
+
+    // Spin window to leave before a deadline
+    int64_t spinMarginNs() const { return m_marginNs; }
+
+    // Called by the PWM thread after each sleep with how late it woke up
+    void addSample(int64_t overshootNs);
+
+    // Called by the PWM thread with the time actually spent busy-waiting and
+    // the margin the sleep before it left (0 when the wait did not sleep).
+    // Only a wait that slept counts towards the spin time saved, and at most
+    // by how much less it spun than the static margin.
+    void addSpinTime(int64_t spinNs, int64_t sleptMarginNs);
+
+    // Metrics, readable from any thread
+    int64_t getMarginNs() const { return m_publishedMarginNs.load(std::memory_order_relaxed); }
+    uint64_t getSpinTimeNs() const { return m_spinTimeNs.load(std::memory_order_relaxed); }
+    uint64_t getSpinTimeSavedNs() const { return m_spinTimeSavedNs.load(std::memory_order_relaxed); }
+    uint64_t getLateWakeups() const { return m_lateWakeups.load(std::memory_order_relaxed); }
+
+    // Restart from a single calibration sample
+    void reset(int64_t initialOvershootNs);
+    void resetMetrics();
+
+private:
+    // Only touched by the PWM thread
+    int64_t m_meanNs;
+    int64_t m_deviationNs;
+    int64_t m_marginNs;
+    int64_t m_staticMarginNs;           // what the one-shot startup calibration would have used
+
+    std::atomic<int64_t> m_publishedMarginNs;
+    std::atomic<uint64_t> m_spinTimeNs;
+    std::atomic<uint64_t> m_spinTimeSavedNs;
+    std::atomic<uint64_t> m_lateWakeups;
+};
+
+#endif // SLEEPESTIMATOR_H
@@ -0,0 +1,68 @@
+#include "timinghistogram.h"
+#include <algorithm>
+
+TimingHistogram::TimingHistogram(int64_t bucketWidthNs)
+    : m_bucketWidthNs(bucketWidthNs)
+{
+    reset();
+}
+
+void TimingHistogram::record(int64_t errorNs)
+{
+    if (errorNs < 0) {
+        errorNs = -errorNs;
+    }
+
+    int bucket = int(std::min<int64_t>(errorNs / m_bucketWidthNs, BUCKET_COUNT - 1));
+    m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    // Single writer, no compare-exchange needed
+    if (errorNs > m_maxNs.load(std::memory_order_relaxed)) {
+        m_maxNs.store(errorNs, std::memory_order_relaxed);
+    }
+}
+
+TimingSummary TimingHistogram::summary() const
+{
+    uint32_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    TimingSummary result;
+    result.samples = total;
+    result.maxNs = m_maxNs.load(std::memory_order_relaxed);
+    result.p50Ns = percentile(counts, total, 50, result.maxNs);
+    result.p99Ns = percentile(counts, total, 99, result.maxNs);
+    return result;
+}
+
+void TimingHistogram::reset()
+{
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
+
+int64_t TimingHistogram::percentile(const uint32_t* counts, uint64_t total, int percent, int64_t maxNs) const
+{
+    if (total == 0) {
+        return 0;
+    }
+
+    // Upper edge of the bucket holding the requested rank, never above the real maximum
+    uint64_t rank = (total * percent + 99) / 100;
+    uint64_t seen = 0;
+
+    for (int i = 0; i < BUCKET_COUNT - 1; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min((i + 1) * m_bucketWidthNs, maxNs);
+        }
+    }
+    return maxNs;
+}
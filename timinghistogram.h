@@ -0,0 +1,38 @@
+#ifndef TIMINGHISTOGRAM_H
+#define TIMINGHISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+// Percentiles of a timing histogram, all values in nanoseconds
+struct TimingSummary {
+    uint64_t samples = 0;
+    int64_t p50Ns = 0;
+    int64_t p99Ns = 0;
+    int64_t maxNs = 0;
+};
+
+// Fixed-bucket histogram of absolute timing errors. Written by the PWM thread
+// without locks, read and reset from any other thread. A reset while the
+// writer is active may lose a few samples, which is fine for statistics.
+class TimingHistogram
+{
+public:
+    static constexpr int BUCKET_COUNT = 256;        // last bucket collects everything above
+    static constexpr int64_t DEFAULT_BUCKET_WIDTH_NS = 1000;
+
+    explicit TimingHistogram(int64_t bucketWidthNs = DEFAULT_BUCKET_WIDTH_NS);
+
+    void record(int64_t errorNs);
+    TimingSummary summary() const;
+    void reset();
+
+private:
+    int64_t percentile(const uint32_t* counts, uint64_t total, int percent, int64_t maxNs) const;
+
+    std::atomic<uint32_t> m_buckets[BUCKET_COUNT];
+    std::atomic<int64_t> m_maxNs;
+    int64_t m_bucketWidthNs;
+};
+
+#endif // TIMINGHISTOGRAM_H
@@ -0,0 +1,155 @@
+#include "trajectorybuffer.h"
+#include <algorithm>
+#include <cstdlib>
+
+TrajectoryBuffer::TrajectoryBuffer()
+    : m_head(0)
+    , m_count(0)
+    , m_drained(false)
+    , m_synced(false)
+    , m_offsetNs(0)
+    , m_windowMinNs(0)
+    , m_windowEndNs(0)
+    , m_depthNs(DEFAULT_DEPTH_NS)
+    , m_batches(0)
+    , m_pointsReceived(0)
+    , m_played(0)
+    , m_merged(0)
+    , m_replaced(0)
+    , m_late(0)
+    , m_overruns(0)
+    , m_underruns(0)
+{
+}
+
+void TrajectoryBuffer::setDepthNs(int64_t depthNs)
+{
+    m_depthNs.store(std::max<int64_t>(0, depthNs), std::memory_order_relaxed);
+}
+
+int TrajectoryBuffer::push(int64_t senderNowNs, int64_t arrivalNs, const TrajectoryPoint* points, int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_batches.fetch_add(1, std::memory_order_relaxed);
+    m_pointsReceived.fetch_add(count, std::memory_order_relaxed);
+
+    // Map the sender clock: the smallest transit seen is the jitter-free one
+    const int64_t sampleNs = arrivalNs - senderNowNs;
+    if (!m_synced || std::llabs(sampleNs - m_offsetNs) > RESYNC_NS) {
+        m_synced = true;
+        m_offsetNs = sampleNs;
+        m_windowMinNs = sampleNs;
+        m_windowEndNs = arrivalNs + OFFSET_WINDOW_NS;
+    } else {
+        m_offsetNs = std::min(m_offsetNs, sampleNs);
+        m_windowMinNs = std::min(m_windowMinNs, sampleNs);
+        if (arrivalNs >= m_windowEndNs) {
+            m_offsetNs = m_windowMinNs;
+            m_windowMinNs = sampleNs;
+            m_windowEndNs = arrivalNs + OFFSET_WINDOW_NS;
+        }
+    }
+    if (count <= 0) {
+        return 0;
+    }
+
+    const int64_t shiftNs = m_offsetNs + m_depthNs.load(std::memory_order_relaxed);
+    const int64_t firstNs = points[0].timeNs + shiftNs;
+
+    // The newer batch wins from its first point on
+    while (m_count > 0 && m_points[(m_head + m_count - 1) % CAPACITY].timeNs >= firstNs) {
+        --m_count;
+        m_replaced.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Nothing left to play in between: the stream did not keep up
+    if (m_drained && m_count == 0 && firstNs < arrivalNs) {
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_drained = false;
+
+    int queued = 0;
+    for (int i = 0; i < count; ++i) {
+        if (m_count == CAPACITY) {
+            m_overruns.fetch_add(count - i, std::memory_order_relaxed);
+            break;
+        }
+        TrajectoryPoint& point = m_points[(m_head + m_count) % CAPACITY];
+        point = points[i];
+        point.timeNs += shiftNs;
+        if (point.timeNs < arrivalNs) {
+            m_late.fetch_add(1, std::memory_order_relaxed);
+        }
+        ++m_count;
+        ++queued;
+    }
+    return queued;
+}
+
+const TrajectoryPoint* TrajectoryBuffer::dueLocked(int64_t nowNs, int* due) const
+{
+    if (m_count == 0 || m_points[m_head].timeNs > nowNs) {
+        return nullptr;
+    }
+
+    // Latest due point, the ones before it fell into the same frame
+    *due = 1;
+    while (*due < m_count && m_points[(m_head + *due) % CAPACITY].timeNs <= nowNs) {
+        ++*due;
+    }
+    return &m_points[(m_head + *due - 1) % CAPACITY];
+}
+
+void TrajectoryBuffer::popLocked(int due)
+{
+    m_head = (m_head + due) % CAPACITY;
+    m_count -= due;
+    m_drained = m_count == 0;
+    m_played.fetch_add(1, std::memory_order_relaxed);
+    m_merged.fetch_add(due - 1, std::memory_order_relaxed);
+}
+
+void TrajectoryBuffer::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_head = 0;
+    m_count = 0;
+    m_drained = false;
+    m_synced = false;
+}
+
+int TrajectoryBuffer::getQueuedPoints(int64_t nowNs, int64_t* leadNs) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (leadNs) {
+        *leadNs = m_count ? std::max<int64_t>(0, m_points[(m_head + m_count - 1) % CAPACITY].timeNs - nowNs) : 0;
+    }
+    return m_count;
+}
+
+TrajectoryStats TrajectoryBuffer::getStats() const
+{
+    TrajectoryStats stats;
+    stats.batches = m_batches.load(std::memory_order_relaxed);
+    stats.points = m_pointsReceived.load(std::memory_order_relaxed);
+    stats.played = m_played.load(std::memory_order_relaxed);
+    stats.merged = m_merged.load(std::memory_order_relaxed);
+    stats.replaced = m_replaced.load(std::memory_order_relaxed);
+    stats.late = m_late.load(std::memory_order_relaxed);
+    stats.overruns = m_overruns.load(std::memory_order_relaxed);
+    stats.underruns = m_underruns.load(std::memory_order_relaxed);
+    stats.depthNs = m_depthNs.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TrajectoryBuffer::resetStats()
+{
+    m_batches.store(0, std::memory_order_relaxed);
+    m_pointsReceived.store(0, std::memory_order_relaxed);
+    m_played.store(0, std::memory_order_relaxed);
+    m_merged.store(0, std::memory_order_relaxed);
+    m_replaced.store(0, std::memory_order_relaxed);
+    m_late.store(0, std::memory_order_relaxed);
+    m_overruns.store(0, std::memory_order_relaxed);
+    m_underruns.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,132 @@
+#ifndef TRAJECTORYBUFFER_H
+#define TRAJECTORYBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include "pulsewidth.h"
+
+// One timed setpoint of a trajectory
+struct TrajectoryPoint {
+    int64_t timeNs = 0;                 // sender timeline in push(), Clock timeline once queued
+    PulseWidth pulseWidth[4];           // ESC1-ESC4
+};
+
+// Trajectory counters, cumulative since the last reset
+struct TrajectoryStats {
+    uint64_t batches = 0;               // push() calls
+    uint64_t points = 0;                // points received
+    uint64_t played = 0;                // points output by a frame
+    uint64_t merged = 0;                // points superseded by a later one due in the same frame
+    uint64_t replaced = 0;              // queued points overwritten by a newer batch
+    uint64_t late = 0;                  // points already due when they arrived
+    uint64_t overruns = 0;              // points dropped because the buffer was full
+    uint64_t underruns = 0;             // batches that came after the buffer ran dry, already late
+    int64_t depthNs = 0;
+};
+
+// Jitter buffer for timestamped setpoints. The sender stamps each batch with
+// its own clock; a point is played at
+//
+//   sender time + (smallest arrival - sender time offset seen) + depth
+//
+// so a batch that is delayed by less than the depth still plays at the
+// sender's spacing. The smallest offset is taken over a window and re-based
+// at the end of each window so sender clock drift is followed; a jump of the
+// sender clock (reconnect) re-anchors immediately.
+//
+// A batch later than the depth is an underrun: the outputs held the last
+// point meanwhile (the command-timeout failsafe still applies) and playback
+// skips to the latest due point instead of replaying the backlog. A full
+// buffer (overrun) drops the points furthest in the future.
+//
+// push() and clear() come from the BLE thread and take a mutex; take() runs
+// on the PWM thread and only try-locks it, so a frame that meets a push in
+// progress plays its point one frame later instead of blocking.
+class TrajectoryBuffer
+{
+public:
+    static constexpr int CAPACITY = 64;                         // 1.28s of 20ms points
+    static constexpr int64_t DEFAULT_DEPTH_NS = 40000000;       // 40ms
+    static constexpr int64_t OFFSET_WINDOW_NS = 2000000000LL;   // re-base the offset every 2s
+    static constexpr int64_t RESYNC_NS = 1000000000LL;          // offset jump that re-anchors
+
+    TrajectoryBuffer();
+
+    // Jitter buffer depth, the added latency that absorbs late batches
+    void setDepthNs(int64_t depthNs);
+    int64_t getDepthNs() const { return m_depthNs.load(std::memory_order_relaxed); }
+
+    // Queue a batch sent at senderNowNs (sender timeline) that arrived at
+    // arrivalNs (Clock timeline). Points must be in time order; queued points
+    // from the first point's time on are replaced. Returns the points queued.
+    int push(int64_t senderNowNs, int64_t arrivalNs, const TrajectoryPoint* points, int count);
+
+    // Called every frame: hands the latest point due at nowNs to
+    // bool apply(const PulseWidth[4]), false when nothing new is due (the
+    // outputs hold the last point). The point is only consumed if apply()
+    // returns true, otherwise the next frame offers it again. apply() runs
+    // under the buffer lock, so once clear() returns no point taken before it
+    // can override a later command.
+    template <typename Apply>
+    bool take(int64_t nowNs, Apply apply);
+
+    // Drop the queued points and the clock mapping
+    void clear();
+
+    // Queued points and how far ahead of nowNs the last one is, for the acknowledgment
+    int getQueuedPoints(int64_t nowNs, int64_t* leadNs) const;
+
+    TrajectoryStats getStats() const;
+    void resetStats();
+
+private:
+    // Latest point due at nowNs and the queued points it covers, m_mutex held
+    const TrajectoryPoint* dueLocked(int64_t nowNs, int* due) const;
+
+    // Advance past the first due points, m_mutex held
+    void popLocked(int due);
+
+    mutable std::mutex m_mutex;
+
+    // Ring of queued points in Clock time, guarded by m_mutex
+    TrajectoryPoint m_points[CAPACITY];
+    int m_head;
+    int m_count;
+    bool m_drained;                     // last queued point played, the next batch should continue it
+
+    // Sender to Clock time mapping, guarded by m_mutex
+    bool m_synced;
+    int64_t m_offsetNs;                 // smallest arrival - sender time, the mapping in use
+    int64_t m_windowMinNs;              // smallest offset of the current window
+    int64_t m_windowEndNs;
+
+    std::atomic<int64_t> m_depthNs;
+
+    std::atomic<uint64_t> m_batches;
+    std::atomic<uint64_t> m_pointsReceived;
+    std::atomic<uint64_t> m_played;
+    std::atomic<uint64_t> m_merged;
+    std::atomic<uint64_t> m_replaced;
+    std::atomic<uint64_t> m_late;
+    std::atomic<uint64_t> m_overruns;
+    std::atomic<uint64_t> m_underruns;
+};
+
+template <typename Apply>
+bool TrajectoryBuffer::take(int64_t nowNs, Apply apply)
+{
+    std::unique_lock<std::mutex> lock(m_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+    int due = 0;
+    const TrajectoryPoint* point = dueLocked(nowNs, &due);
+    if (!point || !apply(point->pulseWidth)) {
+        return false;
+    }
+    popLocked(due);
+    return true;
+}
+
+#endif // TRAJECTORYBUFFER_H
@@ -0,0 +1,94 @@
+#include "virtualclock.h"
+#include <algorithm>
+#include <chrono>
+
+// Attachment is per thread; one virtual clock is installed at a time
+static thread_local bool t_attached = false;
+
+VirtualClock::VirtualClock(bool autoAdvance, int64_t startNs, int64_t graceNs)
+    : m_nowNs(startNs)
+    , m_attached(0)
+    , m_autoAdvance(autoAdvance)
+    , m_graceNs(graceNs)
+    , m_warpCount(0)
+    , m_forcedWarpCount(0)
+{
+}
+
+void VirtualClock::attachThread()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!t_attached) {
+        t_attached = true;
+        ++m_attached;
+    }
+}
+
+void VirtualClock::detachThread()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (t_attached) {
+        t_attached = false;
+        --m_attached;
+        // The remaining threads may all be asleep now
+        m_wakeup.notify_all();
+    }
+}
+
+void VirtualClock::sleepUntilNs(int64_t deadlineNs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (deadlineNs <= m_nowNs.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    // warpLocked() removes the entry when it wakes this thread. A thread that
+    // is not attached waits without holding time back.
+    const bool attached = t_attached;
+    if (attached) {
+        m_deadlines.insert(deadlineNs);
+    }
+
+    while (m_nowNs.load(std::memory_order_relaxed) < deadlineNs) {
+        if (!m_autoAdvance) {
+            m_wakeup.wait(lock);
+            continue;
+        }
+        if (attached && int(m_deadlines.size()) >= m_attached) {
+            warpLocked(*m_deadlines.begin());
+            continue;
+        }
+
+        const bool timedOut = m_wakeup.wait_for(lock, std::chrono::nanoseconds(m_graceNs)) == std::cv_status::timeout;
+        if (timedOut && m_nowNs.load(std::memory_order_relaxed) < deadlineNs) {
+            // Someone attached is blocked outside the clock
+            m_forcedWarpCount.fetch_add(1, std::memory_order_relaxed);
+            warpLocked(m_deadlines.empty() ? deadlineNs : *m_deadlines.begin());
+        }
+    }
+}
+
+void VirtualClock::advanceTo(int64_t timeNs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_nowNs.load(std::memory_order_relaxed) < timeNs) {
+        // One deadline at a time, so each woken thread runs at its own time
+        int64_t nextNs = m_deadlines.empty() ? timeNs : std::min(timeNs, *m_deadlines.begin());
+        warpLocked(nextNs);
+
+        // Let the woken threads run until they sleep again
+        m_wakeup.wait_for(lock, std::chrono::nanoseconds(m_graceNs), [this] {
+            return int(m_deadlines.size()) >= m_attached;
+        });
+    }
+}
+
+void VirtualClock::warpLocked(int64_t timeNs)
+{
+    if (timeNs > m_nowNs.load(std::memory_order_relaxed)) {
+        m_nowNs.store(timeNs, std::memory_order_release);
+        m_warpCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    m_deadlines.erase(m_deadlines.begin(), m_deadlines.upper_bound(timeNs));
+    m_wakeup.notify_all();
+}
@@ -0,0 +1,60 @@
+#ifndef VIRTUALCLOCK_H
+#define VIRTUALCLOCK_H
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include "clock.h"
+
+// Simulated time for deterministic, time-warped runs of the PWM engine.
+// Spins are sleeps here and edge timestamps are exact.
+//
+// Auto-advance: time stands still while any attached thread is running and
+// jumps to the earliest sleep deadline once all of them sleep, so a 20ms
+// frame costs only the work done in it. Attach the thread driving the test
+// as well, otherwise time also moves while it is between two calls. A
+// thread blocked outside the clock (join, mutex) looks busy forever; after
+// the real-time grace period the clock advances anyway.
+//
+// Manual: only advanceTo() moves time, called from a thread that does not
+// sleep on the clock itself.
+class VirtualClock : public Clock
+{
+public:
+    static constexpr int64_t DEFAULT_GRACE_NS = 20000000;
+
+    explicit VirtualClock(bool autoAdvance = true, int64_t startNs = 0, int64_t graceNs = DEFAULT_GRACE_NS);
+
+    int64_t nowNs() override { return m_nowNs.load(std::memory_order_acquire); }
+    void sleepUntilNs(int64_t deadlineNs) override;
+    void spinUntilNs(int64_t deadlineNs) override { sleepUntilNs(deadlineNs); }
+
+    void attachThread() override;
+    void detachThread() override;
+
+    // Move time forward from a thread that is not attached, waking sleepers
+    // in deadline order and letting each run until it sleeps again
+    void advanceTo(int64_t timeNs);
+    void advanceBy(int64_t durationNs) { advanceTo(nowNs() + durationNs); }
+
+    // Number of jumps, and how many of them the grace period forced
+    uint64_t getWarpCount() const { return m_warpCount.load(std::memory_order_relaxed); }
+    uint64_t getForcedWarpCount() const { return m_forcedWarpCount.load(std::memory_order_relaxed); }
+
+private:
+    // Mutex held: move to timeNs and wake everyone whose deadline passed
+    void warpLocked(int64_t timeNs);
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::atomic<int64_t> m_nowNs;
+    std::multiset<int64_t> m_deadlines;     // sleeping attached threads
+    int m_attached;
+    bool m_autoAdvance;
+    int64_t m_graceNs;
+    std::atomic<uint64_t> m_warpCount;
+    std::atomic<uint64_t> m_forcedWarpCount;
+};
+
+#endif // VIRTUALCLOCK_H
@@ -0,0 +1,92 @@
+#include "virtualgpio.h"
+#include "clock.h"
+
+VirtualGpio::VirtualGpio(size_t edgeCapacity)
+    : m_edgeCapacity(edgeCapacity)
+    , m_droppedEdges(0)
+{
+    for (int pin = 0; pin < MAX_PINS; ++pin) {
+        m_levels[pin].store(false, std::memory_order_relaxed);
+        m_outputs[pin].store(false, std::memory_order_relaxed);
+        m_edgeCounts[pin].store(0, std::memory_order_relaxed);
+    }
+    m_edges.reserve(m_edgeCapacity);
+}
+
+bool VirtualGpio::configureOutput(int pin)
+{
+    if (pin < 0 || pin >= MAX_PINS) {
+        return false;
+    }
+    m_outputs[pin].store(true, std::memory_order_relaxed);
+    write(pin, false);
+    return true;
+}
+
+void VirtualGpio::releasePin(int pin)
+{
+    if (pin >= 0 && pin < MAX_PINS) {
+        m_outputs[pin].store(false, std::memory_order_relaxed);
+    }
+}
+
+void VirtualGpio::write(int pin, bool high)
+{
+    if (pin < 0 || pin >= MAX_PINS) {
+        return;
+    }
+    if (m_levels[pin].exchange(high, std::memory_order_relaxed) != high) {
+        recordEdge(pin, high, Clock::getInstance()->nowNs());
+    }
+}
+
+void VirtualGpio::writeMany(const int* pins, const bool* levels, int count)
+{
+    // Same timestamp for every pin, like a single register write
+    const int64_t nowNs = Clock::getInstance()->nowNs();
+    for (int i = 0; i < count; ++i) {
+        if (pins[i] < 0 || pins[i] >= MAX_PINS) {
+            continue;
+        }
+        if (m_levels[pins[i]].exchange(levels[i], std::memory_order_relaxed) != levels[i]) {
+            recordEdge(pins[i], levels[i], nowNs);
+        }
+    }
+}
+
+bool VirtualGpio::getLevel(int pin) const
+{
+    return pin >= 0 && pin < MAX_PINS && m_levels[pin].load(std::memory_order_relaxed);
+}
+
+bool VirtualGpio::isOutput(int pin) const
+{
+    return pin >= 0 && pin < MAX_PINS && m_outputs[pin].load(std::memory_order_relaxed);
+}
+
+uint64_t VirtualGpio::getEdgeCount(int pin) const
+{
+    return (pin >= 0 && pin < MAX_PINS) ? m_edgeCounts[pin].load(std::memory_order_relaxed) : 0;
+}
+
+std::vector<GpioEdge> VirtualGpio::takeEdges()
+{
+    std::vector<GpioEdge> edges;
+    edges.reserve(m_edgeCapacity);
+
+    std::lock_guard<std::mutex> lock(m_edgeMutex);
+    edges.swap(m_edges);
+    return edges;
+}
+
+void VirtualGpio::recordEdge(int pin, bool high, int64_t timeNs)
+{
+    m_edgeCounts[pin].fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_edgeMutex);
+    if (m_edges.size() >= m_edgeCapacity) {
+        m_droppedEdges.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    m_edges.push_back(GpioEdge{pin, high, timeNs});
+}
@@ -0,0 +1,57 @@
+#ifndef VIRTUALGPIO_H
+#define VIRTUALGPIO_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "gpiohal.h"
+
+struct GpioEdge {
+    int pin;
+    bool level;
+    int64_t timeNs;     // Clock::getInstance() timeline
+};
+
+// In-memory GPIO backend. Every level change is timestamped and kept in a
+// bounded edge log so tests and benchmarks can check the generated waveform
+// on a machine without GPIO hardware. With a VirtualClock installed the
+// timestamps are simulated time and the trace is exact.
+class VirtualGpio : public GpioHal
+{
+public:
+    static constexpr int MAX_PINS = 64;
+    static constexpr size_t DEFAULT_EDGE_CAPACITY = 65536;
+
+    explicit VirtualGpio(size_t edgeCapacity = DEFAULT_EDGE_CAPACITY);
+
+    GpioBackendType type() const override { return GpioBackendType::Virtual; }
+    bool setup() override { return true; }
+    bool configureOutput(int pin) override;
+    void releasePin(int pin) override;
+    void write(int pin, bool high) override;
+    void writeMany(const int* pins, const bool* levels, int count) override;
+
+    // Inspection, any thread
+    bool getLevel(int pin) const;
+    bool isOutput(int pin) const;
+    uint64_t getEdgeCount(int pin) const;
+
+    // Move the logged edges out, oldest first. Edges beyond the capacity are
+    // dropped and counted.
+    std::vector<GpioEdge> takeEdges();
+    uint64_t getDroppedEdgeCount() const { return m_droppedEdges.load(std::memory_order_relaxed); }
+
+private:
+    void recordEdge(int pin, bool high, int64_t timeNs);
+
+    std::atomic<bool> m_levels[MAX_PINS];
+    std::atomic<bool> m_outputs[MAX_PINS];
+    std::atomic<uint64_t> m_edgeCounts[MAX_PINS];
+
+    std::mutex m_edgeMutex;
+    std::vector<GpioEdge> m_edges;
+    size_t m_edgeCapacity;
+    std::atomic<uint64_t> m_droppedEdges;
+};
+
+#endif // VIRTUALGPIO_H
@@ -0,0 +1,41 @@
+#include "wiringpigpio.h"
+#include "logger.h"
+#include <wiringPi.h>
+
+WiringPiGpio::WiringPiGpio()
+    : m_setupDone(false)
+{
+}
+
+bool WiringPiGpio::setup()
+{
+    if (m_setupDone) {
+        return true;
+    }
+
+    if (wiringPiSetupGpio() == -1) {
+        LOG_ERROR("Failed to initialize WiringPi");
+        return false;
+    }
+
+    LOG_INFO("WiringPi initialized successfully");
+    m_setupDone = true;
+    return true;
+}
+
+bool WiringPiGpio::configureOutput(int pin)
+{
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, LOW);
+    return true;
+}
+
+void WiringPiGpio::releasePin(int pin)
+{
+    digitalWrite(pin, LOW);
+}
+
+void WiringPiGpio::write(int pin, bool high)
+{
+    digitalWrite(pin, high ? HIGH : LOW);
+}
@@ -0,0 +1,22 @@
+#ifndef WIRINGPIGPIO_H
+#define WIRINGPIGPIO_H
+
+#include "gpiohal.h"
+
+// wiringPi backend (BCM numbering via wiringPiSetupGpio)
+class WiringPiGpio : public GpioHal
+{
+public:
+    WiringPiGpio();
+
+    GpioBackendType type() const override { return GpioBackendType::WiringPi; }
+    bool setup() override;
+    bool configureOutput(int pin) override;
+    void releasePin(int pin) override;
+    void write(int pin, bool high) override;
+
+private:
+    bool m_setupDone;
+};
+
+#endif // WIRINGPIGPIO_H